@@ -0,0 +1,109 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+// Compares parsing of plain (ASCII) PPM images with the library against a
+// naive parser based on formatted stream extraction.
+//
+// Usage: thinks_pnm_io_ascii_bench [width height [runs]]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+
+namespace {
+
+std::string PlainPpmText(std::size_t const width, std::size_t const height) {
+  auto oss = std::ostringstream{};
+  oss << "P3\n" << width << " " << height << "\n255\n";
+  auto state = std::uint32_t{12345};
+  for (auto i = std::size_t{0}; i < width * height * 3; ++i) {
+    state = state * 1664525u + 1013904223u;
+    oss << (state >> 24) << ((i + 1) % 15 == 0 ? '\n' : ' ');
+  }
+  return oss.str();
+}
+
+void ReadNaivePlainPpmImage(std::istream& is, std::size_t* const width,
+                            std::size_t* const height,
+                            std::vector<std::uint8_t>* const pixel_data) {
+  auto magic_number = std::string{};
+  auto max_value = std::uint32_t{0};
+  is >> magic_number >> *width >> *height >> max_value;
+  pixel_data->resize((*width) * (*height) * 3);
+  for (auto& sample : *pixel_data) {
+    auto value = std::uint32_t{0};
+    is >> value;
+    sample = static_cast<std::uint8_t>(value);
+  }
+  if (!is) {
+    throw std::runtime_error("naive parser failed");
+  }
+}
+
+template <typename ReadT>
+double BestSeconds(std::string const& text, std::size_t const runs,
+                   std::vector<std::uint8_t>* const pixel_data, ReadT read) {
+  auto best = 0.0;
+  for (auto run = std::size_t{0}; run < runs; ++run) {
+    auto iss = std::istringstream(text);
+    auto width = std::size_t{0};
+    auto height = std::size_t{0};
+    auto const begin = std::chrono::steady_clock::now();
+    read(iss, &width, &height, pixel_data);
+    auto const seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+    best = run == 0 || seconds < best ? seconds : best;
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  auto width = std::size_t{2048};
+  auto height = std::size_t{2048};
+  auto runs = std::size_t{3};
+  if (argc >= 3) {
+    width = std::strtoul(argv[1], nullptr, 10);
+    height = std::strtoul(argv[2], nullptr, 10);
+  }
+  if (argc >= 4) {
+    runs = std::strtoul(argv[3], nullptr, 10);
+  }
+
+  auto const text = PlainPpmText(width, height);
+  auto const megabytes = text.size() / (1024.0 * 1024.0);
+
+  auto naive_pixels = std::vector<std::uint8_t>{};
+  auto const naive_seconds =
+      BestSeconds(text, runs, &naive_pixels, ReadNaivePlainPpmImage);
+
+  auto pixels = std::vector<std::uint8_t>{};
+  auto const seconds = BestSeconds(
+      text, runs, &pixels,
+      [](std::istream& is, std::size_t* const w, std::size_t* const h,
+         std::vector<std::uint8_t>* const p) {
+        thinks::ReadPlainPpmImage(is, w, h, p);
+      });
+
+  if (pixels != naive_pixels) {
+    std::cerr << "pixel data mismatch" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "plain PPM " << width << "x" << height << ", " << megabytes
+            << " MB of text, best of " << runs << " runs\n"
+            << "  istream >>   : " << megabytes / naive_seconds << " MB/s\n"
+            << "  thinks       : " << megabytes / seconds << " MB/s\n"
+            << "  speedup      : " << naive_seconds / seconds << "x"
+            << std::endl;
+  return EXIT_SUCCESS;
+}
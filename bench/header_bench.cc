@@ -0,0 +1,141 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+// Compares header parsing with the library, from a stream and from a
+// buffer, against formatted stream extraction. Headers are parsed
+// repeatedly from memory so that only the parsing itself is measured.
+//
+// Usage: thinks_pnm_io_header_bench [iterations [runs]]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+
+namespace {
+
+// Stream buffer over a string that can be rewound without reallocating.
+class RewindableBuf : public std::streambuf {
+ public:
+  void Reset(std::string const& text) {
+    auto const begin = const_cast<char*>(text.data());
+    setg(begin, begin, begin + text.size());
+  }
+};
+
+std::vector<std::string> Headers() {
+  auto headers = std::vector<std::string>{};
+  auto state = std::uint32_t{12345};
+  for (auto i = 0; i < 64; ++i) {
+    state = state * 1664525u + 1013904223u;
+    auto const width = 16 + (state >> 24);
+    auto const height = 16 + ((state >> 16) & 0xff);
+    auto oss = std::ostringstream{};
+    oss << (i % 2 == 0 ? "P5" : "P6") << "\n"
+        << width << " " << height << "\n"
+        << (i % 4 < 2 ? 255 : 65535) << "\n";
+    headers.push_back(oss.str());
+  }
+  return headers;
+}
+
+std::size_t ReadExtractionHeader(std::istream& is) {
+  auto magic_number = std::string{};
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto max_value = std::uint32_t{0};
+  is >> magic_number >> width >> height >> max_value;
+  is.ignore(256, '\n');
+  return width + height + max_value;
+}
+
+std::size_t ReadStreamHeader(std::istream& is) {
+  auto const header = thinks::detail::ReadHeader(is);
+  return header.width + header.height + header.max_value;
+}
+
+template <typename ReadT>
+double BestNanoseconds(std::vector<std::string> const& headers,
+                       std::size_t const iterations, std::size_t const runs,
+                       std::size_t* const checksum, ReadT read) {
+  auto best = 0.0;
+  for (auto run = std::size_t{0}; run < runs; ++run) {
+    auto sum = std::size_t{0};
+    auto const begin = std::chrono::steady_clock::now();
+    for (auto i = std::size_t{0}; i < iterations; ++i) {
+      sum += read(headers[i % headers.size()]);
+    }
+    auto const seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+    auto const nanoseconds = 1e9 * seconds / iterations;
+    best = run == 0 || nanoseconds < best ? nanoseconds : best;
+    *checksum = sum;
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  auto iterations = std::size_t{1000000};
+  auto runs = std::size_t{3};
+  if (argc >= 2) {
+    iterations = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc >= 3) {
+    runs = std::strtoul(argv[2], nullptr, 10);
+  }
+
+  auto const headers = Headers();
+  auto buf = RewindableBuf{};
+  std::istream is(&buf);
+
+  auto extraction_checksum = std::size_t{0};
+  auto const extraction_ns = BestNanoseconds(
+      headers, iterations, runs, &extraction_checksum,
+      [&](std::string const& header) {
+        buf.Reset(header);
+        is.clear();
+        return ReadExtractionHeader(is);
+      });
+
+  auto stream_checksum = std::size_t{0};
+  auto const stream_ns = BestNanoseconds(headers, iterations, runs,
+                                         &stream_checksum,
+                                         [&](std::string const& header) {
+                                           buf.Reset(header);
+                                           is.clear();
+                                           return ReadStreamHeader(is);
+                                         });
+
+  auto buffer_checksum = std::size_t{0};
+  auto const buffer_ns = BestNanoseconds(
+      headers, iterations, runs, &buffer_checksum,
+      [](std::string const& header) {
+        auto header_size = std::size_t{0};
+        auto const h = thinks::detail::ReadHeader(header.data(), header.size(),
+                                                  &header_size);
+        return h.width + h.height + h.max_value;
+      });
+
+  if (stream_checksum != extraction_checksum ||
+      buffer_checksum != extraction_checksum) {
+    std::cerr << "header mismatch" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "header parsing, " << iterations << " headers, best of "
+            << runs << " runs\n"
+            << "  istream >>   : " << extraction_ns << " ns/header\n"
+            << "  thinks stream: " << stream_ns << " ns/header\n"
+            << "  thinks buffer: " << buffer_ns << " ns/header" << std::endl;
+  return EXIT_SUCCESS;
+}
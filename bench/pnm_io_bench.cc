@@ -0,0 +1,419 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+// Read and write throughput of binary PGM and PPM images, from thumbnails
+// to (optionally) gigapixel images, through std::stringstream, through
+// file streams opened by the caller and through the filename overloads,
+// plus the cost of reading only the header. Each case reports the best
+// time of several runs, throughput and heap allocations per operation.
+//
+// Output is a table, or CSV with --format=csv, which can be stored as a
+// baseline. With --baseline=FILE each case found in the baseline is
+// compared against it, and the exit status is non-zero if a case is
+// slower by more than the tolerance or allocates more. Gigapixel images
+// need several times their size in memory, up to 16 GB for PPM.
+//
+// Usage: thinks_pnm_io_bench [--quick] [--gigapixel] [--runs=N]
+//                            [--filter=TEXT] [--format=text|csv]
+//                            [--baseline=FILE] [--tolerance=FRACTION]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_probe.h"
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocation_count(0);
+std::atomic<std::uint64_t> g_allocation_bytes(0);
+
+}  // namespace
+
+void* operator new(std::size_t const size) {
+  ++g_allocation_count;
+  g_allocation_bytes += size;
+  if (auto* const p = std::malloc(size > 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* const p) noexcept { std::free(p); }
+
+void operator delete(void* const p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+struct Options {
+  bool quick = false;
+  bool gigapixel = false;
+  std::size_t runs = 3;
+  std::string filter;
+  bool csv = false;
+  std::string baseline;
+  double tolerance = 0.5;
+};
+
+struct Result {
+  std::string name;
+  std::uint64_t bytes = 0;  // Image file size, zero for header cases.
+  double ns_per_op = 0;
+  double allocations_per_op = 0;
+  double allocated_bytes_per_op = 0;
+
+  double megabytes_per_second() const {
+    return bytes > 0 ? bytes * 1e3 / ns_per_op : 0;
+  }
+};
+
+struct Image {
+  thinks::PnmFormat format;
+  std::size_t width;
+  std::size_t height;
+  std::vector<std::uint8_t> pixel_data;
+  std::string encoded;   // Complete file contents.
+  std::string filename;  // Written once, read by the file cases.
+};
+
+std::vector<std::uint8_t> NoisePixelData(std::size_t const size) {
+  auto pixel_data = std::vector<std::uint8_t>(size);
+  auto state = std::uint32_t{12345};
+  for (auto& sample : pixel_data) {
+    state = state * 1664525u + 1013904223u;
+    sample = static_cast<std::uint8_t>(state >> 24);
+  }
+  return pixel_data;
+}
+
+Image MakeImage(thinks::PnmFormat const format, std::size_t const width,
+                std::size_t const height) {
+  auto image = Image{format, width, height, {}, {}, {}};
+  auto const is_ppm = format == thinks::PnmFormat::kPpm;
+  image.pixel_data = NoisePixelData(width * height * (is_ppm ? 3 : 1));
+  auto oss = std::ostringstream{};
+  if (is_ppm) {
+    thinks::WritePpmImage(oss, width, height, image.pixel_data.data());
+  } else {
+    thinks::WritePgmImage(oss, width, height, image.pixel_data.data());
+  }
+  image.encoded = oss.str();
+
+  auto name = std::ostringstream{};
+  name << "thinks_pnm_io_bench_" << width << "x" << height
+       << (is_ppm ? ".ppm" : ".pgm");
+  image.filename = name.str();
+  auto ofs = std::ofstream(image.filename, std::ios::binary);
+  ofs.write(image.encoded.data(),
+            static_cast<std::streamsize>(image.encoded.size()));
+  return image;
+}
+
+double ElapsedNanoseconds(std::size_t const reps,
+                          std::function<void()> const& op) {
+  auto const begin = std::chrono::steady_clock::now();
+  for (auto rep = std::size_t{0}; rep < reps; ++rep) {
+    op();
+  }
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+}
+
+// Run @p op enough times per run to take at least 50 ms, doubling the
+// count while calibrating, which also warms up caches. Keeps the best
+// run, allocations are counted over the last run.
+Result Measure(std::string const& name, std::uint64_t const bytes,
+               std::size_t const runs, std::function<void()> const& op) {
+  constexpr auto kMinRunNanoseconds = 50e6;
+  auto reps = std::size_t{1};
+  while (ElapsedNanoseconds(reps, op) < kMinRunNanoseconds) {
+    reps *= 2;
+  }
+
+  auto result = Result{};
+  result.name = name;
+  result.bytes = bytes;
+  for (auto run = std::size_t{0}; run < runs; ++run) {
+    auto const count_before = g_allocation_count.load();
+    auto const bytes_before = g_allocation_bytes.load();
+    auto const ns = ElapsedNanoseconds(reps, op) / reps;
+    if (run == 0 || ns < result.ns_per_op) {
+      result.ns_per_op = ns;
+    }
+    result.allocations_per_op =
+        static_cast<double>(g_allocation_count - count_before) / reps;
+    result.allocated_bytes_per_op =
+        static_cast<double>(g_allocation_bytes - bytes_before) / reps;
+  }
+  return result;
+}
+
+void Read(Image const& image, std::istream& is,
+          std::vector<std::uint8_t>* const pixel_data) {
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  if (image.format == thinks::PnmFormat::kPpm) {
+    thinks::ReadPpmImage(is, &width, &height, pixel_data);
+  } else {
+    thinks::ReadPgmImage(is, &width, &height, pixel_data);
+  }
+}
+
+void Write(Image const& image, std::ostream& os) {
+  if (image.format == thinks::PnmFormat::kPpm) {
+    thinks::WritePpmImage(os, image.width, image.height,
+                          image.pixel_data.data());
+  } else {
+    thinks::WritePgmImage(os, image.width, image.height,
+                          image.pixel_data.data());
+  }
+}
+
+std::vector<Result> RunCases(Image const& image, Options const& options) {
+  auto const is_ppm = image.format == thinks::PnmFormat::kPpm;
+  auto prefix = std::ostringstream{};
+  prefix << (is_ppm ? "ppm/" : "pgm/") << image.width << "x" << image.height
+         << "/";
+  auto const bytes = static_cast<std::uint64_t>(image.encoded.size());
+  auto const out_filename = "out_" + image.filename;
+
+  // The pixel data vector is reused between operations, as a loader
+  // would, so that allocations reflect the library rather than the
+  // vector growing.
+  auto pixel_data = std::vector<std::uint8_t>{};
+  auto cases = std::vector<std::pair<std::string, std::function<void()>>>{
+      {"read/stringstream",
+       [&]() {
+         auto iss = std::istringstream(image.encoded);
+         Read(image, iss, &pixel_data);
+       }},
+      {"read/fstream",
+       [&]() {
+         auto ifs = std::ifstream(image.filename, std::ios::binary);
+         Read(image, ifs, &pixel_data);
+       }},
+      {"read/filename",
+       [&]() {
+         auto width = std::size_t{0};
+         auto height = std::size_t{0};
+         if (is_ppm) {
+           thinks::ReadPpmImage(image.filename, &width, &height, &pixel_data);
+         } else {
+           thinks::ReadPgmImage(image.filename, &width, &height, &pixel_data);
+         }
+       }},
+      {"write/stringstream",
+       [&]() {
+         auto oss = std::ostringstream{};
+         Write(image, oss);
+       }},
+      {"write/fstream",
+       [&]() {
+         auto ofs = std::ofstream(out_filename, std::ios::binary);
+         Write(image, ofs);
+       }},
+      {"write/filename",
+       [&]() {
+         if (is_ppm) {
+           thinks::WritePpmImage(out_filename, image.width, image.height,
+                                 image.pixel_data.data());
+         } else {
+           thinks::WritePgmImage(out_filename, image.width, image.height,
+                                 image.pixel_data.data());
+         }
+       }},
+  };
+
+  auto results = std::vector<Result>{};
+  for (auto const& c : cases) {
+    auto const name = prefix.str() + c.first;
+    if (name.find(options.filter) != std::string::npos) {
+      results.push_back(Measure(name, bytes, options.runs, c.second));
+    }
+  }
+  std::remove(out_filename.c_str());
+  return results;
+}
+
+std::vector<Result> RunHeaderCases(Image const& image,
+                                   Options const& options) {
+  auto cases = std::vector<std::pair<std::string, std::function<void()>>>{
+      {"header/stringstream",
+       [&]() {
+         auto iss = std::istringstream(image.encoded);
+         thinks::detail::ReadHeader(iss);
+       }},
+      {"header/probe", [&]() { thinks::ProbePnm(image.filename); }},
+  };
+  auto results = std::vector<Result>{};
+  for (auto const& c : cases) {
+    if (c.first.find(options.filter) != std::string::npos) {
+      results.push_back(Measure(c.first, 0, options.runs, c.second));
+    }
+  }
+  return results;
+}
+
+void PrintText(std::ostream& os, std::vector<Result> const& results) {
+  os << std::left << std::setw(36) << "case" << std::right << std::setw(14)
+     << "ns/op" << std::setw(12) << "MB/s" << std::setw(12) << "allocs/op"
+     << std::setw(16) << "alloc bytes/op" << "\n";
+  for (auto const& r : results) {
+    os << std::left << std::setw(36) << r.name << std::right << std::fixed
+       << std::setprecision(0) << std::setw(14) << r.ns_per_op
+       << std::setw(12) << r.megabytes_per_second() << std::setprecision(1)
+       << std::setw(12) << r.allocations_per_op << std::setprecision(0)
+       << std::setw(16) << r.allocated_bytes_per_op << "\n";
+  }
+}
+
+void PrintCsv(std::ostream& os, std::vector<Result> const& results) {
+  os << "case,bytes,ns_per_op,mb_per_s,allocs_per_op,alloc_bytes_per_op\n";
+  for (auto const& r : results) {
+    os << r.name << "," << r.bytes << "," << r.ns_per_op << ","
+       << r.megabytes_per_second() << "," << r.allocations_per_op << ","
+       << r.allocated_bytes_per_op << "\n";
+  }
+}
+
+// Returns the number of cases that regressed against the baseline.
+std::size_t CompareBaseline(std::vector<Result> const& results,
+                            Options const& options) {
+  auto ifs = std::ifstream(options.baseline);
+  if (!ifs) {
+    std::cerr << "cannot open baseline '" << options.baseline << "'\n";
+    return 1;
+  }
+  auto baseline = std::map<std::string, Result>{};
+  auto line = std::string{};
+  std::getline(ifs, line);  // Column names.
+  while (std::getline(ifs, line)) {
+    auto iss = std::istringstream(line);
+    auto r = Result{};
+    auto mb_per_s = 0.0;
+    auto comma = char{0};
+    std::getline(iss, r.name, ',');
+    iss >> r.bytes >> comma >> r.ns_per_op >> comma >> mb_per_s >> comma >>
+        r.allocations_per_op;
+    if (iss) {
+      baseline[r.name] = r;
+    }
+  }
+
+  auto regressions = std::size_t{0};
+  for (auto const& r : results) {
+    auto const iter = baseline.find(r.name);
+    if (iter == baseline.end()) {
+      continue;
+    }
+    auto const& b = iter->second;
+    auto const slower = r.ns_per_op > b.ns_per_op * (1 + options.tolerance);
+    auto const allocates_more =
+        r.allocations_per_op > b.allocations_per_op + 0.5;
+    if (slower || allocates_more) {
+      ++regressions;
+      std::cerr << "regression: " << r.name << ", " << r.ns_per_op
+                << " ns/op (baseline " << b.ns_per_op << "), "
+                << r.allocations_per_op << " allocs/op (baseline "
+                << b.allocations_per_op << ")\n";
+    }
+  }
+  return regressions;
+}
+
+bool ParseOption(std::string const& arg, char const* const name,
+                 std::string* const value) {
+  auto const prefix = std::string(name) + "=";
+  if (arg.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  *value = arg.substr(prefix.size());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  auto options = Options{};
+  for (auto i = 1; i < argc; ++i) {
+    auto const arg = std::string(argv[i]);
+    auto value = std::string{};
+    if (arg == "--quick") {
+      options.quick = true;
+    } else if (arg == "--gigapixel") {
+      options.gigapixel = true;
+    } else if (ParseOption(arg, "--runs", &value)) {
+      options.runs = std::strtoul(value.c_str(), nullptr, 10);
+    } else if (ParseOption(arg, "--filter", &value)) {
+      options.filter = value;
+    } else if (ParseOption(arg, "--format", &value)) {
+      options.csv = value == "csv";
+    } else if (ParseOption(arg, "--baseline", &value)) {
+      options.baseline = value;
+    } else if (ParseOption(arg, "--tolerance", &value)) {
+      options.tolerance = std::strtod(value.c_str(), nullptr);
+    } else {
+      std::cerr << "unknown argument '" << arg << "'\n";
+      return EXIT_FAILURE;
+    }
+  }
+  if (options.runs == 0) {
+    options.runs = 1;
+  }
+
+  auto sizes = std::vector<std::size_t>{64, 512, 2048};
+  if (!options.quick) {
+    sizes.push_back(8192);
+  }
+  if (options.gigapixel) {
+    sizes.push_back(32768);
+  }
+
+  auto results = std::vector<Result>{};
+  try {
+    for (auto const format :
+         {thinks::PnmFormat::kPgm, thinks::PnmFormat::kPpm}) {
+      for (auto const size : sizes) {
+        auto const image = MakeImage(format, size, size);
+        auto const image_results = RunCases(image, options);
+        results.insert(results.end(), image_results.begin(),
+                       image_results.end());
+        if (format == thinks::PnmFormat::kPpm && size == sizes.front()) {
+          auto const header_results = RunHeaderCases(image, options);
+          results.insert(results.end(), header_results.begin(),
+                         header_results.end());
+        }
+        std::remove(image.filename.c_str());
+      }
+    }
+  } catch (std::exception const& e) {
+    std::cerr << "benchmark failed: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  if (options.csv) {
+    PrintCsv(std::cout, results);
+  } else {
+    PrintText(std::cout, results);
+  }
+  if (!options.baseline.empty() && CompareBaseline(results, options) > 0) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
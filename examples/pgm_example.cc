@@ -4,6 +4,7 @@
 
 #include "pgm_example.h"
 
+#include <cmath>
 #include <limits>
 #include <vector>
 
@@ -4,20 +4,240 @@
 
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <exception>
 #include <fstream>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <sstream>
+#include <streambuf>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "thinks/pnm_io/pnm_io_simd.h"
+
 namespace thinks {
+
+/*!
+Image formats supported by this library.
+*/
+enum class PnmFormat {
+  kPgm,  //!< Greyscale, magic number 'P5'.
+  kPpm,  //!< RGB, magic number 'P6'.
+};
+
+/*!
+How samples are scaled when reading into 16-bit pixel data.
+*/
+enum class SampleScaling {
+  kNone,       //!< Samples are in the range [0, max value].
+  kFullRange,  //!< Samples are rescaled to the range [0, 65535].
+};
+
+/*!
+How PBM (bitmap) pixel data is laid out in memory.
+*/
+enum class PbmLayout {
+  kPacked,    //!< One bit per pixel as stored, set bits are black.
+  kExpanded,  //!< One byte per pixel, 0 for black and 255 for white.
+};
+
+/*!
+Phases of reading or writing an image, reported to an IoObserver.
+*/
+enum class IoPhase {
+  kOpen,      //!< Opening the file.
+  kHeader,    //!< Parsing or writing the header.
+  kAllocate,  //!< Resizing the pixel data vector.
+  kRaster,    //!< Reading or writing the pixel data.
+  kConvert,   //!< Converting samples after they were read.
+  kClose,     //!< Closing the file, which flushes written pixel data.
+};
+
+/*!
+Timing of a single phase, see IoObserver.
+*/
+struct IoEvent {
+  IoPhase phase = IoPhase::kOpen;
+  bool write = false;  //!< True if the phase is part of writing an image.
+  std::chrono::nanoseconds duration = std::chrono::nanoseconds::zero();
+
+  //! Bytes allocated, read, written or converted. Zero for the open, header
+  //! and close phases.
+  std::uint64_t bytes = 0;
+};
+
+/*!
+Receives the timings of the phases of the ReadPgmImage, ReadPpmImage,
+WritePgmImage and WritePpmImage family of functions, e.g. to export them
+to a metrics system. Installed globally with SetIoObserver.
+
+Phases are reported in the order they complete. The std::istream and
+std::ostream overloads report the header, allocate (std::vector
+overloads only), raster and convert (16-bit reads with two bytes per
+sample only) phases, the filename overloads add the open and close
+phases. Conversions that are fused with raster I/O, such as widening
+one-byte samples, layout conversion or byte swapping on write, are part
+of the raster phase.
+
+OnPhase is called on the thread doing the I/O, so it must be thread-safe
+if images are read or written concurrently, and should be cheap. It must
+not throw.
+*/
+class IoObserver {
+ public:
+  virtual ~IoObserver() = default;
+  virtual void OnPhase(IoEvent const& event) = 0;
+};
+
+namespace detail {
+
+inline std::atomic<IoObserver*>& IoObserverSlot() {
+  static std::atomic<IoObserver*> observer(nullptr);
+  return observer;
+}
+
+}  // namespace detail
+
+/*!
+Install @p observer to receive the phase timings of all subsequent reads
+and writes, or remove the current observer if @p observer is null. The
+observer must outlive any read or write that may use it. Returns the
+previous observer.
+
+When no observer is installed the cost is a null check per read or
+write, no clock is read. Defining THINKS_PNM_IO_NO_OBSERVER removes
+even that, observers are then never called.
+
+Example, forwarding timings to a metrics system:
+
+  class MetricsObserver : public thinks::IoObserver {
+   public:
+    void OnPhase(thinks::IoEvent const& event) override {
+      metrics::Record(event.phase, event.duration, event.bytes);
+    }
+  };
+
+  MetricsObserver observer;
+  thinks::SetIoObserver(&observer);
+*/
+inline IoObserver* SetIoObserver(IoObserver* const observer) {
+  return detail::IoObserverSlot().exchange(observer,
+                                           std::memory_order_acq_rel);
+}
+
+//! The observer installed with SetIoObserver, null if none.
+inline IoObserver* GetIoObserver() {
+#if defined(THINKS_PNM_IO_NO_OBSERVER)
+  return nullptr;
+#else
+  return detail::IoObserverSlot().load(std::memory_order_acquire);
+#endif
+}
+
+/*!
+Allocator that default-initializes elements instead of value-initializing
+them. Resizing a vector of samples using this allocator leaves the new
+samples uninitialized rather than zero-filling them.
+*/
+template <typename T>
+class DefaultInitAllocator : public std::allocator<T> {
+ public:
+  template <typename U>
+  struct rebind {
+    using other = DefaultInitAllocator<U>;
+  };
+
+  DefaultInitAllocator() = default;
+
+  template <typename U>
+  DefaultInitAllocator(DefaultInitAllocator<U> const&) noexcept {}
+
+  template <typename U>
+  void construct(U* const p) {
+    ::new (static_cast<void*>(p)) U;
+  }
+
+  template <typename U, typename... ArgsT>
+  void construct(U* const p, ArgsT&&... args) {
+    ::new (static_cast<void*>(p)) U(std::forward<ArgsT>(args)...);
+  }
+};
+
+/*!
+Vector that is not zero-filled when resized, for pixel data that is
+about to be overwritten. For instance:
+
+  auto pixel_data = thinks::UninitializedVector<std::uint8_t>{};
+  for (auto const& filename : filenames) {
+    // Memory is only allocated when an image is larger than all
+    // previous images, and is never zero-filled.
+    thinks::ReadPpmImage(filename, &width, &height, &pixel_data);
+    // ...
+  }
+*/
+template <typename T>
+using UninitializedVector = std::vector<T, DefaultInitAllocator<T>>;
+
 namespace detail {
 
+// Reports the phases of a single read or write to the observer installed
+// when the timer was created. Each phase lasts from the previous mark, or
+// restart, to its own mark. Does nothing if there is no observer.
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(bool const write)
+      : observer_(GetIoObserver()), write_(write) {
+    Restart();
+  }
+
+  void Restart() {
+    if (observer_ != nullptr) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  void Mark(IoPhase const phase, std::uint64_t const bytes = 0) {
+    if (observer_ == nullptr) {
+      return;
+    }
+    auto const now = std::chrono::steady_clock::now();
+    auto event = IoEvent{};
+    event.phase = phase;
+    event.write = write_;
+    event.duration =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_);
+    event.bytes = bytes;
+    observer_->OnPhase(event);
+    start_ = now;
+  }
+
+ private:
+  IoObserver* observer_;
+  bool write_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+inline std::string ErrorMessage(int const error_number) {
+#if defined(_MSC_VER)
+  constexpr auto kErrMsgLen = std::size_t{1024};
+  char err_msg[kErrMsgLen];
+  strerror_s(err_msg, kErrMsgLen, error_number);
+  return std::string(err_msg);
+#else
+  return std::string(std::strerror(error_number));
+#endif
+}
+
 template <typename FileStreamT>
 void OpenFileStream(FileStreamT* const file_stream, std::string const& filename,
                     std::ios_base::openmode const mode = std::ios::binary) {
@@ -25,12 +245,9 @@ void OpenFileStream(FileStreamT* const file_stream, std::string const& filename,
 
   file_stream->open(filename, mode);
   if (!(*file_stream)) {
-    constexpr auto kErrMsgLen = std::size_t{1024};
-    char err_msg[kErrMsgLen];
-    strerror_s(err_msg, kErrMsgLen, errno);
     auto oss = std::ostringstream{};
     oss << "cannot open file '" << filename << "', "
-        << "error: '" << err_msg << "'";
+        << "error: '" << ErrorMessage(errno) << "'";
     throw std::runtime_error(oss.str());
   }
 }
@@ -62,15 +279,34 @@ void ThrowIfInvalidHeight(std::size_t const height) {
 
 template <typename ExceptionT>
 void ThrowIfInvalidMaxValue(std::uint32_t const max_value) {
-  constexpr auto expected_max_value =
+  constexpr auto max_max_value =
+      std::uint32_t{std::numeric_limits<std::uint16_t>::max()};
+  if (max_value == 0 || max_value > max_max_value) {
+    auto oss = std::ostringstream{};
+    oss << "max value must be in range [1, " << max_max_value << "], was "
+        << max_value;
+    throw ExceptionT(oss.str());
+  }
+}
+
+template <typename ExceptionT>
+void ThrowIfMaxValueExceeds8Bit(std::uint32_t const max_value) {
+  constexpr auto max_8bit_value =
       std::uint32_t{std::numeric_limits<std::uint8_t>::max()};
-  if (max_value != expected_max_value) {
+  if (max_value > max_8bit_value) {
     auto oss = std::ostringstream{};
-    oss << "max value must be " << expected_max_value << ", was " << max_value;
+    oss << "max value must be at most " << max_8bit_value
+        << " for 8-bit pixel data, was " << max_value;
     throw ExceptionT(oss.str());
   }
 }
 
+// Samples are stored as one byte if the max value is less than 256,
+// otherwise as two bytes, most significant byte first.
+inline std::size_t BytesPerSample(std::uint32_t const max_value) {
+  return max_value > std::numeric_limits<std::uint8_t>::max() ? 2 : 1;
+}
+
 template <typename ExceptionT>
 void ThrowIfInvalidPixelData(std::vector<std::uint8_t> const& pixel_data,
                              std::size_t const expected_size) {
@@ -81,147 +317,1867 @@ void ThrowIfInvalidPixelData(std::vector<std::uint8_t> const& pixel_data,
 
 inline constexpr const char* PgmMagicNumber() { return "P5"; }
 inline constexpr const char* PpmMagicNumber() { return "P6"; }
+inline constexpr const char* PlainPgmMagicNumber() { return "P2"; }
+inline constexpr const char* PlainPpmMagicNumber() { return "P3"; }
+inline constexpr const char* PbmMagicNumber() { return "P4"; }
+inline constexpr const char* PlainPbmMagicNumber() { return "P1"; }
+inline constexpr const char* PamMagicNumber() { return "P7"; }
+
+// Bitmap headers have no max value.
+inline bool IsBitmapMagicNumber(std::string const& magic_number) {
+  return magic_number == PbmMagicNumber() ||
+         magic_number == PlainPbmMagicNumber();
+}
+
+inline PnmFormat FormatFromMagicNumber(std::string const& magic_number) {
+  if (magic_number == PgmMagicNumber()) {
+    return PnmFormat::kPgm;
+  }
+  if (magic_number == PpmMagicNumber()) {
+    return PnmFormat::kPpm;
+  }
+  auto oss = std::ostringstream{};
+  oss << "unsupported magic number '" << magic_number << "'";
+  throw std::runtime_error(oss.str());
+}
+
+inline char const* MagicNumber(PnmFormat const format) {
+  return format == PnmFormat::kPpm ? PpmMagicNumber() : PgmMagicNumber();
+}
+
+inline std::size_t ChannelCount(PnmFormat const format) {
+  return format == PnmFormat::kPpm ? 3 : 1;
+}
+
+template <typename ExceptionT>
+void ThrowIfInvalidDepth(std::size_t const depth) {
+  if (depth == 0) {
+    throw ExceptionT("depth must be non-zero");
+  }
+}
 
 struct Header {
   std::string magic_number = "";
   std::size_t width = 0;
   std::size_t height = 0;
   std::uint32_t max_value = 255;
+
+  // Only stored in PAM headers, the other formats have fixed depths.
+  std::size_t depth = 1;
+  std::string tuple_type;
 };
 
-inline Header ReadHeader(std::istream& is) {
+// Headers are scanned one byte at a time from a byte source, so that the
+// same (locale independent) scanner runs on streams and in-memory buffers.
+// Get and Peek return the next byte as an unsigned char value, or -1 at
+// the end of the data.
+
+// Reads through the stream buffer of an input stream, consuming only the
+// bytes of the header.
+class StreamByteSource {
+ public:
+  explicit StreamByteSource(std::istream& is) : buf_(is.rdbuf()) {}
+
+  int Peek() { return buf_ == nullptr ? -1 : ToByte(buf_->sgetc()); }
+  int Get() { return buf_ == nullptr ? -1 : ToByte(buf_->sbumpc()); }
+
+ private:
+  static int ToByte(std::streambuf::int_type const c) {
+    using Traits = std::streambuf::traits_type;
+    if (Traits::eq_int_type(c, Traits::eof())) {
+      return -1;
+    }
+    return static_cast<unsigned char>(Traits::to_char_type(c));
+  }
+
+  std::streambuf* buf_;
+};
+
+class BufferByteSource {
+ public:
+  BufferByteSource(char const* const data, std::size_t const size)
+      : begin_(data), pos_(data), end_(data + size) {}
+
+  int Peek() const {
+    return pos_ < end_ ? static_cast<unsigned char>(*pos_) : -1;
+  }
+  int Get() { return pos_ < end_ ? static_cast<unsigned char>(*pos_++) : -1; }
+
+  //! Number of bytes consumed so far.
+  std::size_t offset() const { return static_cast<std::size_t>(pos_ - begin_); }
+
+ private:
+  char const* begin_;
+  char const* pos_;
+  char const* end_;
+};
+
+// Reads through a buffer of its own from a stream buffer. Reads that do
+// not fit in the buffer go straight to the destination, so large pixel
+// data is never copied twice. Fills take only the bytes the stream buffer
+// has available, at least one, so that reading from a pipe never waits
+// for bytes beyond those requested.
+class StreamReadBuffer {
+ public:
+  StreamReadBuffer(std::streambuf* const buf, std::size_t const capacity)
+      : buf_(buf), data_(capacity) {}
+
+  int Peek() {
+    if (pos_ == end_ && !Fill()) {
+      return -1;
+    }
+    return static_cast<unsigned char>(data_[pos_]);
+  }
+
+  int Get() {
+    auto const c = Peek();
+    if (c >= 0) {
+      ++pos_;
+    }
+    return c;
+  }
+
+  // Read up to @p size bytes into @p dst, returns the number of bytes read,
+  // which is less than @p size only at the end of the stream.
+  std::size_t Read(char* const dst, std::size_t const size) {
+    auto const buffered_size = end_ - pos_;
+    auto const copy_size = size < buffered_size ? size : buffered_size;
+    std::memcpy(dst, data_.data() + pos_, copy_size);
+    pos_ += copy_size;
+    auto read_size = copy_size;
+    if (read_size < size && buf_ != nullptr) {
+      read_size += static_cast<std::size_t>(buf_->sgetn(
+          dst + read_size, static_cast<std::streamsize>(size - read_size)));
+    }
+    return read_size;
+  }
+
+ private:
+  bool Fill() {
+    pos_ = 0;
+    end_ = 0;
+    if (buf_ != nullptr) {
+      auto const available = buf_->in_avail();
+      auto fill_size = std::streamsize{1};
+      if (available > 1) {
+        fill_size = static_cast<std::size_t>(available) < data_.size()
+                        ? available
+                        : static_cast<std::streamsize>(data_.size());
+      }
+      end_ = static_cast<std::size_t>(buf_->sgetn(data_.data(), fill_size));
+    }
+    return end_ > 0;
+  }
+
+  std::streambuf* buf_;
+  std::vector<char> data_;
+  std::size_t pos_ = 0;
+  std::size_t end_ = 0;
+};
+
+inline bool IsSpaceByte(int const c) {
+  return c >= 0 && IsSpace(static_cast<char>(c));
+}
+
+inline bool IsDigitByte(int const c) { return c >= '0' && c <= '9'; }
+
+[[noreturn]] inline void ThrowUnexpectedHeaderByte(int const c) {
+  if (c < 0) {
+    throw std::runtime_error("unexpected end of header");
+  }
+  auto oss = std::ostringstream{};
+  oss << "unexpected character in header: '" << static_cast<char>(c) << "'";
+  throw std::runtime_error(oss.str());
+}
+
+// Skip whitespace and comments, which run from '#' to the end of the line.
+template <typename ByteSourceT>
+void SkipHeaderSpace(ByteSourceT* const source) {
+  for (;;) {
+    auto const c = source->Peek();
+    if (c == '#') {
+      for (auto d = source->Peek(); d >= 0 && d != '\n' && d != '\r';
+           d = source->Peek()) {
+        source->Get();
+      }
+    } else if (IsSpaceByte(c)) {
+      source->Get();
+    } else {
+      return;
+    }
+  }
+}
+
+// Skip blanks within a line, not including the line break.
+template <typename ByteSourceT>
+void SkipLineSpace(ByteSourceT* const source) {
+  while (source->Peek() == ' ' || source->Peek() == '\t' ||
+         source->Peek() == '\r') {
+    source->Get();
+  }
+}
+
+// Read an unsigned decimal value no larger than @p max_value.
+template <typename ByteSourceT>
+std::uint64_t ReadHeaderValue(ByteSourceT* const source, char const* const name,
+                              std::uint64_t const max_value) {
+  auto c = source->Peek();
+  if (!IsDigitByte(c)) {
+    ThrowUnexpectedHeaderByte(c);
+  }
+  auto const max_tens = max_value / 10;
+  auto const max_ones = max_value % 10;
+  auto value = std::uint64_t{0};
+  for (; IsDigitByte(c); c = source->Peek()) {
+    source->Get();
+    auto const digit = static_cast<std::uint64_t>(c - '0');
+    if (value > max_tens || (value == max_tens && digit > max_ones)) {
+      auto oss = std::ostringstream{};
+      oss << name << " is too large";
+      throw std::runtime_error(oss.str());
+    }
+    value = value * 10 + digit;
+  }
+  return value;
+}
+
+template <typename ByteSourceT>
+std::string ReadHeaderToken(ByteSourceT* const source) {
+  auto token = std::string{};
+  while (source->Peek() >= 0 && !IsSpaceByte(source->Peek())) {
+    token += static_cast<char>(source->Get());
+  }
+  return token;
+}
+
+// PAM headers consist of lines with a keyword followed by a value, ending
+// with a line containing only ENDHDR. The pixel data follows the newline
+// after ENDHDR.
+template <typename ByteSourceT>
+void ReadPamHeader(ByteSourceT* const source, Header* const header) {
+  assert(header != nullptr && "null header");
+  header->max_value = 0;
+  header->depth = 0;
+
+  for (;;) {
+    SkipHeaderSpace(source);
+    auto const keyword = ReadHeaderToken(source);
+    if (keyword.empty()) {
+      throw std::runtime_error("PAM header must end with ENDHDR");
+    }
+    if (keyword == "ENDHDR") {
+      SkipLineSpace(source);
+      if (source->Peek() != '\n') {
+        ThrowUnexpectedHeaderByte(source->Peek());
+      }
+      source->Get();
+      return;
+    }
+
+    SkipLineSpace(source);
+    if (keyword == "WIDTH") {
+      header->width = static_cast<std::size_t>(ReadHeaderValue(
+          source, "width", std::numeric_limits<std::size_t>::max()));
+    } else if (keyword == "HEIGHT") {
+      header->height = static_cast<std::size_t>(ReadHeaderValue(
+          source, "height", std::numeric_limits<std::size_t>::max()));
+    } else if (keyword == "DEPTH") {
+      header->depth = static_cast<std::size_t>(ReadHeaderValue(
+          source, "depth", std::numeric_limits<std::size_t>::max()));
+    } else if (keyword == "MAXVAL") {
+      header->max_value = static_cast<std::uint32_t>(ReadHeaderValue(
+          source, "max value", std::numeric_limits<std::uint32_t>::max()));
+    } else if (keyword == "TUPLTYPE") {
+      // Multiple TUPLTYPE lines are concatenated, separated by a space.
+      auto tuple_type = std::string{};
+      while (source->Peek() >= 0 && source->Peek() != '\n') {
+        tuple_type += static_cast<char>(source->Get());
+      }
+      while (!tuple_type.empty() && IsSpace(tuple_type.back())) {
+        tuple_type.pop_back();
+      }
+      if (!header->tuple_type.empty()) {
+        header->tuple_type += ' ';
+      }
+      header->tuple_type += tuple_type;
+    } else {
+      auto oss = std::ostringstream{};
+      oss << "unknown PAM header keyword '" << keyword << "'";
+      throw std::runtime_error(oss.str());
+    }
+
+    SkipLineSpace(source);
+    if (source->Peek() >= 0 && source->Peek() != '\n') {
+      ThrowUnexpectedHeaderByte(source->Peek());
+    }
+  }
+}
+
+// Reject images whose pixel data size in bytes, or in 16-bit samples,
+// cannot be represented.
+inline void ThrowIfImageTooLarge(Header const& header) {
+  // Common image sizes cannot overflow, avoid the divisions for these.
+  constexpr auto small_bits = std::numeric_limits<std::size_t>::digits / 3 - 1;
+  constexpr auto small_size = std::size_t{1} << small_bits;
+  if (header.width < small_size && header.height < small_size &&
+      header.depth < small_size) {
+    return;
+  }
+
+  auto const channels = header.magic_number == PpmMagicNumber() ||
+                                header.magic_number == PlainPpmMagicNumber()
+                            ? std::size_t{3}
+                            : std::size_t{1};
+  std::size_t const factors[] = {header.height, header.depth, channels, 2};
+  auto sample_count = header.width;
+  for (auto const factor : factors) {
+    if (sample_count > std::numeric_limits<std::size_t>::max() / factor) {
+      throw std::runtime_error("image is too large");
+    }
+    sample_count *= factor;
+  }
+}
+
+// Scan a header following the Netpbm grammar: a magic number followed by
+// whitespace separated decimal values, with comments allowed wherever
+// whitespace is, and a single whitespace character before the pixel data.
+// The max value is omitted for bitmaps, PAM headers are keyword based.
+template <typename ByteSourceT>
+Header ScanHeader(ByteSourceT* const source) {
   auto header = Header{};
-  is >> header.magic_number >> header.width >> header.height >>
-      header.max_value;
+  auto const p = source->Get();
+  auto const n = source->Get();
+  if (p < 0 || n < 0) {
+    ThrowUnexpectedHeaderByte(-1);
+  }
+  header.magic_number.assign({static_cast<char>(p), static_cast<char>(n)});
+  if (p != 'P' || n < '1' || n > '7') {
+    auto oss = std::ostringstream{};
+    oss << "unsupported magic number '" << header.magic_number << "'";
+    throw std::runtime_error(oss.str());
+  }
+
+  // Compare bytes rather than strings, this is on the hot path for small
+  // images.
+  if (p == 'P' && n == '7') {
+    ReadPamHeader(source, &header);
+    ThrowIfInvalidDepth<std::runtime_error>(header.depth);
+  } else {
+    SkipHeaderSpace(source);
+    header.width = static_cast<std::size_t>(ReadHeaderValue(
+        source, "width", std::numeric_limits<std::size_t>::max()));
+    SkipHeaderSpace(source);
+    header.height = static_cast<std::size_t>(ReadHeaderValue(
+        source, "height", std::numeric_limits<std::size_t>::max()));
+    if (p == 'P' && (n == '1' || n == '4')) {
+      header.max_value = 1;
+    } else {
+      SkipHeaderSpace(source);
+      header.max_value = static_cast<std::uint32_t>(ReadHeaderValue(
+          source, "max value", std::numeric_limits<std::uint32_t>::max()));
+    }
+
+    // Exactly one whitespace character, usually a newline, separates the
+    // header from the pixel data.
+    if (!IsSpaceByte(source->Peek())) {
+      ThrowUnexpectedHeaderByte(source->Peek());
+    }
+    source->Get();
+  }
 
   ThrowIfInvalidWidth<std::runtime_error>(header.width);
   ThrowIfInvalidHeight<std::runtime_error>(header.height);
   ThrowIfInvalidMaxValue<std::runtime_error>(header.max_value);
+  ThrowIfImageTooLarge(header);
+
+  return header;
+}
 
-  // Skip ahead (an arbitrary number!) to the pixel data.
-  is.ignore(256, '\n');
+// Read a header from @p is, leaving the stream at the first byte of the
+// pixel data.
+inline Header ReadHeader(std::istream& is) {
+  auto source = StreamByteSource(is);
+  return ScanHeader(&source);
+}
 
+// Read a header from the start of a buffer of @p size bytes. The size of
+// the header in bytes, i.e. the offset of the pixel data, is stored in
+// @p header_size.
+inline Header ReadHeader(char const* const data, std::size_t const size,
+                         std::size_t* const header_size) {
+  assert(header_size != nullptr && "null header size");
+  auto source = BufferByteSource(data, size);
+  auto header = ScanHeader(&source);
+  *header_size = source.offset();
   return header;
 }
 
+// Number of samples per pixel of an image with @p header.
+inline std::size_t HeaderDepth(Header const& header) {
+  auto const n = header.magic_number.size() == 2 ? header.magic_number[1] : 0;
+  switch (n) {
+    case '7':
+      return header.depth;
+    case '3':
+    case '6':
+      return 3;
+    default:
+      return 1;
+  }
+}
+
+// Number of bytes of binary pixel data of an image with @p header. Zero
+// for plain (ASCII) formats, where the size depends on the sample values.
+inline std::uint64_t RasterSize(Header const& header) {
+  auto const& magic_number = header.magic_number;
+  if (magic_number == PbmMagicNumber()) {
+    return std::uint64_t{PackedRowSize(header.width)} * header.height;
+  }
+  if (magic_number != PgmMagicNumber() && magic_number != PpmMagicNumber() &&
+      magic_number != PamMagicNumber()) {
+    return 0;
+  }
+  return std::uint64_t{header.width} * header.height * HeaderDepth(header) *
+         BytesPerSample(header.max_value);
+}
+
 inline void WriteHeader(std::ostream& os, Header const& header) {
   ThrowIfInvalidWidth<std::invalid_argument>(header.width);
   ThrowIfInvalidHeight<std::invalid_argument>(header.height);
   ThrowIfInvalidMaxValue<std::invalid_argument>(header.max_value);
 
+  if (header.magic_number == PamMagicNumber()) {
+    ThrowIfInvalidDepth<std::invalid_argument>(header.depth);
+    os << header.magic_number << "\n"
+       << "WIDTH " << header.width << "\n"
+       << "HEIGHT " << header.height << "\n"
+       << "DEPTH " << header.depth << "\n"
+       << "MAXVAL " << header.max_value << "\n";
+    if (!header.tuple_type.empty()) {
+      os << "TUPLTYPE " << header.tuple_type << "\n";
+    }
+    os << "ENDHDR\n";  // Marks beginning of pixel data.
+    return;
+  }
+
   os << header.magic_number << "\n"
      << header.width << "\n"
-     << header.height << "\n"
-     << header.max_value << "\n";  // Marks beginning of pixel data.
+     << header.height << "\n";
+  if (!IsBitmapMagicNumber(header.magic_number)) {
+    os << header.max_value << "\n";
+  }
+  // Marks beginning of pixel data.
 }
 
-inline void ReadPixelData(std::istream& is,
-                          std::vector<std::uint8_t>* const pixel_data) {
-  is.read(reinterpret_cast<char*>(pixel_data->data()), pixel_data->size());
+inline void ReadPixelData(std::istream& is, std::uint8_t* const pixel_data,
+                          std::size_t const size) {
+  is.read(reinterpret_cast<char*>(pixel_data), size);
 
   if (!is) {
     auto oss = std::ostringstream();
-    oss << "failed reading " << pixel_data->size() << " bytes";
+    oss << "failed reading " << size << " bytes";
     throw std::runtime_error(oss.str());
   }
 }
 
+inline void ReadPixelData(std::istream& is,
+                          std::vector<std::uint8_t>* const pixel_data) {
+  ReadPixelData(is, pixel_data->data(), pixel_data->size());
+}
+
 inline void WritePixelData(std::ostream& os,
                            std::uint8_t const* const pixel_data,
                            std::size_t const size) {
   os.write(reinterpret_cast<char const*>(pixel_data), size);
 }
 
-}  // namespace detail
+// Read @p count samples stored with the width implied by @p max_value into
+// native 16-bit samples. Two-byte samples are read straight into the
+// destination and converted in place, one-byte samples are read through a
+// small staging block. Rescaling is applied to each block while it is
+// still in cache.
+inline void ReadSamples16(std::istream& is, std::uint32_t const max_value,
+                          SampleScaling const scaling,
+                          std::uint16_t* const pixel_data,
+                          std::size_t const count,
+                          PhaseTimer* const timer = nullptr) {
+  auto const rescale = scaling == SampleScaling::kFullRange &&
+                       max_value != std::numeric_limits<std::uint16_t>::max();
+  if (BytesPerSample(max_value) == 2) {
+    auto const bytes = reinterpret_cast<std::uint8_t*>(pixel_data);
+    ReadPixelData(is, bytes, 2 * count);
+    if (timer != nullptr) {
+      timer->Mark(IoPhase::kRaster, 2 * count);
+    }
+    for (auto i = std::size_t{0}; i < count; i += kSampleBlockSize) {
+      auto const n =
+          count - i < kSampleBlockSize ? count - i : kSampleBlockSize;
+      LoadBigEndian16(bytes + 2 * i, pixel_data + i, n);
+      if (rescale) {
+        RescaleToFullRange16(pixel_data + i, n, max_value);
+      }
+    }
+    if (timer != nullptr) {
+      timer->Mark(IoPhase::kConvert, 2 * count);
+    }
+  } else {
+    std::uint8_t block[kSampleBlockSize];
+    for (auto i = std::size_t{0}; i < count; i += kSampleBlockSize) {
+      auto const n =
+          count - i < kSampleBlockSize ? count - i : kSampleBlockSize;
+      if (!is.read(reinterpret_cast<char*>(block), n)) {
+        auto oss = std::ostringstream();
+        oss << "failed reading " << count << " bytes";
+        throw std::runtime_error(oss.str());
+      }
+      Widen8To16(block, pixel_data + i, n);
+      if (rescale) {
+        RescaleToFullRange16(pixel_data + i, n, max_value);
+      }
+    }
+    if (timer != nullptr) {
+      timer->Mark(IoPhase::kRaster, count);
+    }
+  }
+}
 
-/*!
-Read a PGM (greyscale) image from an input stream.
+// Write @p count native 16-bit samples with the width implied by
+// @p max_value, converting one cache-sized block at a time.
+inline void WriteSamples16(std::ostream& os, std::uint32_t const max_value,
+                           std::uint16_t const* const pixel_data,
+                           std::size_t const count) {
+  auto const bytes_per_sample = BytesPerSample(max_value);
+  std::uint8_t block[2 * kSampleBlockSize];
+  for (auto i = std::size_t{0}; i < count; i += kSampleBlockSize) {
+    auto const n =
+        count - i < kSampleBlockSize ? count - i : kSampleBlockSize;
+    if (bytes_per_sample == 2) {
+      StoreBigEndian16(pixel_data + i, block, n);
+    } else {
+      Narrow16To8(pixel_data + i, block, n);
+    }
+    WritePixelData(os, block, n * bytes_per_sample);
+  }
+}
 
-Pre-conditions:
-  - the PGM header does not contain any comments.
-  - the output pointers are non-null.
+inline std::size_t DefaultThreadCount() {
+  auto const thread_count = std::thread::hardware_concurrency();
+  return thread_count > 0 ? thread_count : 1;
+}
 
-Pixel data is read as RGB triplets in row major order. For instance,
-the pixel data for a 2x2 image is represented as follows:
+// Invoke fn(i) for each i in [0, count), spreading the calls over at most
+// @p thread_count threads, the calling thread included. If any call throws,
+// remaining calls are skipped and the first exception is rethrown on the
+// calling thread once all threads have finished.
+template <typename FunctionT>
+void ParallelFor(std::size_t const count, std::size_t const thread_count,
+                 FunctionT fn) {
+  auto const threads = thread_count < count ? thread_count : count;
+  if (threads <= 1) {
+    for (auto i = std::size_t{0}; i < count; ++i) {
+      fn(i);
+    }
+    return;
+  }
 
-        Column 0      Column 1
-      +-------------+-------------+
-      |             |             |
-Row 0 | I: data[0]  | I: data[1]  |
-      |             |             |
-      +-------------+-------------+
-      |             |             |
-Row 1 | I: data[2]  | I: data[3]  |
-      |             |             |
-      +-------------+-------------+
+  std::atomic<std::size_t> next(0);
+  auto error = std::exception_ptr{};
+  std::mutex error_mutex;
+  auto const worker = [&]() {
+    for (auto i = next++; i < count; i = next++) {
+      try {
+        fn(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        next = count;
+      }
+    }
+  };
 
-An std::runtime_error is thrown if:
-  - the magic number is not 'P5'.
-  - width or height is zero.
-  - the max value is not '255'.
-  - the pixel data cannot be read.
-*/
-inline void ReadPgmImage(std::istream& is, std::size_t* const width,
-                         std::size_t* const height,
-                         std::vector<std::uint8_t>* const pixel_data) {
-  auto header = detail::ReadHeader(is);
-  detail::ThrowIfInvalidMagicNumber<std::runtime_error>(
-      header.magic_number, detail::PgmMagicNumber());
+  auto pool = std::vector<std::thread>{};
+  pool.reserve(threads - 1);
+  for (auto i = std::size_t{1}; i < threads; ++i) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
 
-  assert(width != nullptr && "null width");
-  assert(height != nullptr && "null height");
-  *width = header.width;
-  *height = header.height;
+// Read everything that remains in the stream.
+inline std::vector<char> ReadRemaining(std::istream& is) {
+  auto text = std::vector<char>{};
 
-  assert(pixel_data != nullptr && "null pixel data");
-  pixel_data->resize((*width) * (*height));
-  detail::ReadPixelData(is, pixel_data);
+  // Avoid repeated reallocation when the stream can tell its size.
+  auto const begin = is.tellg();
+  if (begin != std::istream::pos_type(-1)) {
+    is.seekg(0, std::ios::end);
+    auto const end = is.tellg();
+    if (end != std::istream::pos_type(-1) && end > begin) {
+      text.reserve(static_cast<std::size_t>(end - begin));
+    }
+    is.seekg(begin);
+  }
+
+  constexpr auto kBlockSize = std::size_t{1} << 20;
+  while (is) {
+    auto const size = text.size();
+    text.resize(size + kBlockSize);
+    is.read(text.data() + size, kBlockSize);
+    text.resize(size + static_cast<std::size_t>(is.gcount()));
+  }
+  return text;
 }
 
-/*!
-See std::istream overload version.
+// Plain (ASCII) rasters are parsed 64 bytes at a time. Each block is
+// classified into digit and whitespace masks with vector compares, token
+// starts are the digits not preceded by a digit. Tokens never span the
+// text chunks that are handed to different threads, since chunks are split
+// at whitespace.
+[[noreturn]] inline void ThrowInvalidPlainCharacter(char const c) {
+  auto oss = std::ostringstream{};
+  oss << "invalid character in pixel data: '" << c << "'";
+  throw std::runtime_error(oss.str());
+}
 
-Throws an std::runtime_error if file cannot be opened.
-*/
-inline void ReadPgmImage(std::string const& filename, std::size_t* const width,
-                         std::size_t* const height,
-                         std::vector<std::uint8_t>* const pixel_data) {
-  auto ifs = std::ifstream{};
-  detail::OpenFileStream(&ifs, filename);
-  ReadPgmImage(ifs, width, height, pixel_data);
-  ifs.close();
+inline std::size_t CountPlainSamples(char const* const text,
+                                     std::size_t const size) {
+  auto sample_count = std::size_t{0};
+  auto carry = std::uint64_t{0};
+  for (auto i = std::size_t{0}; i < size; i += 64) {
+    auto const n = size - i < 64 ? size - i : 64;
+    auto const masks = ClassifyText64(text + i, n);
+    if (masks.invalid != 0) {
+      ThrowInvalidPlainCharacter(text[i + CountTrailingZeros64(masks.invalid)]);
+    }
+    auto const starts = masks.digits & ~((masks.digits << 1) | carry);
+    sample_count += PopCount64(starts);
+    carry = masks.digits >> 63;
+  }
+  return sample_count;
 }
 
-/*!
-Write a PGM (greyscale) image to an output stream.
+[[noreturn]] inline void ThrowSampleValueExceeds(
+    char const* const token, std::size_t const length,
+    std::uint32_t const max_value) {
+  auto oss = std::ostringstream{};
+  oss << "sample value " << std::string(token, length)
+      << " exceeds max value " << max_value;
+  throw std::runtime_error(oss.str());
+}
 
-Pixel data is given a intensities in row major order. For instance,
-the pixel data for a 2x2 image is represented as follows:
+template <typename SampleT>
+void ParsePlainSamples(char const* const text, std::size_t const size,
+                       std::uint32_t const max_value,
+                       SampleT* const samples) {
+  auto sample = samples;
+  auto carry = std::uint64_t{0};
+  for (auto i = std::size_t{0}; i < size; i += 64) {
+    auto const n = size - i < 64 ? size - i : 64;
+    auto const masks = ClassifyText64(text + i, n);
+    auto starts = masks.digits & ~((masks.digits << 1) | carry);
+    carry = masks.digits >> 63;
+    while (starts != 0) {
+      auto const offset =
+          static_cast<std::size_t>(CountTrailingZeros64(starts));
+      starts &= starts - 1;
+      auto const token = text + i + offset;
 
-        Column 0      Column 1
-      +-------------+-------------+
-      |             |             |
-Row 0 | I: data[0]  | I: data[1]  |
-      |             |             |
-      +-------------+-------------+
-      |             |             |
-Row 1 | I: data[2]  | I: data[3]  |
-      |             |             |
-      +-------------+-------------+
+      // The token length follows from the digit mask, unless the token
+      // runs to the end of the block and may continue in the next one.
+      auto const non_digits = ~(masks.digits >> offset);
+      auto const length =
+          non_digits != 0
+              ? static_cast<std::size_t>(CountTrailingZeros64(non_digits))
+              : std::size_t{64};
+      auto value = std::uint32_t{0};
+#if defined(THINKS_PNM_IO_LITTLE_ENDIAN)
+      if (offset + length < 64 && length <= 8 && i + offset + 8 <= size) {
+        value = ParseDigits8(token, length);
+        if (value > max_value) {
+          ThrowSampleValueExceeds(token, length, max_value);
+        }
+        *sample++ = static_cast<SampleT>(value);
+        continue;
+      }
+#endif
+      auto const token_end = text + size;
+      auto digit = token;
+      do {
+        value = value * 10 + static_cast<std::uint32_t>(*digit - '0');
+        ++digit;
+        if (value > max_value) {
+          while (digit < token_end && IsDigit(*digit)) {
+            ++digit;
+          }
+          ThrowSampleValueExceeds(token, digit - token, max_value);
+        }
+      } while (digit < token_end && IsDigit(*digit));
+      *sample++ = static_cast<SampleT>(value);
+    }
+  }
+}
 
-An std::invalid_argument is thrown if:
-  - width or height is zero.
-  - the size of the pixel data does not match the width and height.
-*/
-inline void WritePgmImage(std::ostream& os, std::size_t const width,
-                          std::size_t const height,
-                          std::uint8_t const* const pixel_data) {
+// Parse exactly @p count whitespace separated samples from @p text.
+// Texts larger than @p min_chunk_size are split into (at most
+// @p thread_count) chunks that are parsed concurrently, after first
+// counting the samples in each chunk to find where its output goes.
+template <typename SampleT>
+void ReadPlainSamples(std::vector<char> const& text,
+                      std::uint32_t const max_value, SampleT* const samples,
+                      std::size_t const count,
+                      std::size_t const thread_count = DefaultThreadCount(),
+                      std::size_t const min_chunk_size = 1 << 20) {
+  auto const size = text.size();
+  auto const chunk_count = size / min_chunk_size < thread_count
+                               ? size / min_chunk_size + 1
+                               : thread_count;
+
+  auto bounds = std::vector<std::size_t>(chunk_count + 1, size);
+  bounds[0] = 0;
+  for (auto i = std::size_t{1}; i < chunk_count; ++i) {
+    auto bound = size / chunk_count * i;
+    bound = bound < bounds[i - 1] ? bounds[i - 1] : bound;
+    while (bound < size && !IsSpace(text[bound])) {
+      ++bound;
+    }
+    bounds[i] = bound;
+  }
+
+  auto offsets = std::vector<std::size_t>(chunk_count + 1, 0);
+  ParallelFor(chunk_count, chunk_count, [&](std::size_t const i) {
+    offsets[i + 1] =
+        CountPlainSamples(text.data() + bounds[i], bounds[i + 1] - bounds[i]);
+  });
+  for (auto i = std::size_t{0}; i < chunk_count; ++i) {
+    offsets[i + 1] += offsets[i];
+  }
+  if (offsets[chunk_count] != count) {
+    auto oss = std::ostringstream{};
+    oss << "expected " << count << " samples, found " << offsets[chunk_count];
+    throw std::runtime_error(oss.str());
+  }
+
+  ParallelFor(chunk_count, chunk_count, [&](std::size_t const i) {
+    ParsePlainSamples(text.data() + bounds[i], bounds[i + 1] - bounds[i],
+                      max_value, samples + offsets[i]);
+  });
+}
+
+// Read the header of an image with the given magic number and check that
+// its samples fit in SampleT. Width, height and (optionally) max value are
+// set from the header.
+template <typename SampleT>
+Header ReadImageHeader(std::istream& is,
+                       char const* const expected_magic_number,
+                       std::size_t* const width, std::size_t* const height,
+                       std::uint32_t* const max_value) {
+  auto header = ReadHeader(is);
+  ThrowIfInvalidMagicNumber<std::runtime_error>(header.magic_number,
+                                                expected_magic_number);
+  if (sizeof(SampleT) == 1) {
+    ThrowIfMaxValueExceeds8Bit<std::runtime_error>(header.max_value);
+  }
+
+  assert(width != nullptr && "null width");
+  assert(height != nullptr && "null height");
+  *width = header.width;
+  *height = header.height;
+  if (max_value != nullptr) {
+    *max_value = header.max_value;
+  }
+  return header;
+}
+
+inline void ThrowIfCapacityExceeded(std::size_t const sample_count,
+                                    std::size_t const capacity) {
+  if (capacity < sample_count) {
+    auto oss = std::ostringstream{};
+    oss << "pixel data requires " << sample_count
+        << " samples, capacity is " << capacity;
+    throw std::runtime_error(oss.str());
+  }
+}
+
+template <typename SampleT>
+void ReadPlainImage(std::istream& is, char const* const expected_magic_number,
+                    std::size_t const channels, std::size_t* const width,
+                    std::size_t* const height,
+                    std::vector<SampleT>* const pixel_data,
+                    std::uint32_t* const max_value) {
+  auto const header = ReadImageHeader<SampleT>(is, expected_magic_number,
+                                               width, height, max_value);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  pixel_data->resize(header.width * header.height * channels);
+  ReadPlainSamples(ReadRemaining(is), header.max_value, pixel_data->data(),
+                   pixel_data->size());
+}
+
+// Bitmap rows are converted through a staging block of whole packed rows,
+// so that each block is expanded or packed while it is still in cache.
+inline std::size_t PbmBlockRows(std::size_t const width,
+                                std::size_t const height) {
+  auto const rows = kSampleBlockSize / PackedRowSize(width);
+  return rows == 0 ? 1 : (rows < height ? rows : height);
+}
+
+inline void ReadPbmPixelData(std::istream& is, std::size_t const width,
+                             std::size_t const height,
+                             std::uint8_t* const pixel_data) {
+  auto const packed_row_size = PackedRowSize(width);
+  auto const block_rows = PbmBlockRows(width, height);
+  auto block = std::vector<std::uint8_t>(block_rows * packed_row_size);
+  for (auto row = std::size_t{0}; row < height; row += block_rows) {
+    auto const rows = height - row < block_rows ? height - row : block_rows;
+    ReadPixelData(is, block.data(), rows * packed_row_size);
+    for (auto i = std::size_t{0}; i < rows; ++i) {
+      UnpackBits(block.data() + i * packed_row_size,
+                 pixel_data + (row + i) * width, width);
+    }
+  }
+}
+
+inline void WritePbmPixelData(std::ostream& os, std::size_t const width,
+                              std::size_t const height,
+                              std::uint8_t const* const pixel_data) {
+  auto const packed_row_size = PackedRowSize(width);
+  auto const block_rows = PbmBlockRows(width, height);
+  auto block = std::vector<std::uint8_t>(block_rows * packed_row_size);
+  for (auto row = std::size_t{0}; row < height; row += block_rows) {
+    auto const rows = height - row < block_rows ? height - row : block_rows;
+    for (auto i = std::size_t{0}; i < rows; ++i) {
+      PackBits(pixel_data + (row + i) * width,
+               block.data() + i * packed_row_size, width);
+    }
+    WritePixelData(os, block.data(), rows * packed_row_size);
+  }
+}
+
+// Parse plain bitmap text, where each pixel is a '0' (white) or '1'
+// (black) character and whitespace between pixels is optional, into one
+// byte per pixel.
+inline void ReadPlainBits(std::vector<char> const& text,
+                          std::uint8_t* const pixel_data,
+                          std::size_t const count) {
+  auto found = std::size_t{0};
+  for (auto const c : text) {
+    if (c == '0' || c == '1') {
+      if (found < count) {
+        pixel_data[found] = c == '0' ? 255 : 0;
+      }
+      ++found;
+    } else if (!IsSpace(c)) {
+      ThrowInvalidPlainCharacter(c);
+    }
+  }
+  if (found != count) {
+    auto oss = std::ostringstream{};
+    oss << "expected " << count << " samples, found " << found;
+    throw std::runtime_error(oss.str());
+  }
+}
+
+inline void ReadSamples(std::istream& is, std::uint32_t const /*max_value*/,
+                        std::uint8_t* const samples, std::size_t const count) {
+  ReadPixelData(is, samples, count);
+}
+
+inline void ReadSamples(std::istream& is, std::uint32_t const max_value,
+                        std::uint16_t* const samples, std::size_t const count) {
+  ReadSamples16(is, max_value, SampleScaling::kNone, samples, count);
+}
+
+// Read PAM pixel data into pixels with channel_map.size() channels, where
+// output channel c is taken from stored channel channel_map[c], or set to
+// the max value if channel_map[c] is negative. Rows are read a block at a
+// time and rearranged while the block is still in cache.
+template <typename SampleT>
+void ReadPamPixelData(std::istream& is, Header const& header,
+                      std::vector<int> const& channel_map,
+                      SampleT* const pixel_data) {
+  if (channel_map.empty()) {
+    throw std::invalid_argument("channel map must be non-empty");
+  }
+  for (auto const channel : channel_map) {
+    if (channel >= 0 && static_cast<std::size_t>(channel) >= header.depth) {
+      auto oss = std::ostringstream{};
+      oss << "channel map index " << channel << " out of range for depth "
+          << header.depth;
+      throw std::runtime_error(oss.str());
+    }
+  }
+
+  auto const depth = header.depth;
+  auto const channels = channel_map.size();
+  auto const row_samples = header.width * depth;
+  auto const fill = static_cast<SampleT>(header.max_value);
+  auto block_rows = kSampleBlockSize / row_samples;
+  block_rows = block_rows == 0 ? 1 : block_rows;
+  block_rows = block_rows < header.height ? block_rows : header.height;
+  auto block = std::vector<SampleT>(block_rows * row_samples);
+  auto* dst = pixel_data;
+  for (auto row = std::size_t{0}; row < header.height; row += block_rows) {
+    auto const rows =
+        header.height - row < block_rows ? header.height - row : block_rows;
+    ReadSamples(is, header.max_value, block.data(), rows * row_samples);
+    auto const* src = block.data();
+    for (auto i = std::size_t{0}; i < rows * header.width; ++i) {
+      for (auto c = std::size_t{0}; c < channels; ++c) {
+        auto const channel = channel_map[c];
+        dst[c] = channel < 0 ? fill : src[channel];
+      }
+      src += depth;
+      dst += channels;
+    }
+  }
+}
+
+template <typename SampleT>
+void ReadPamImage(std::istream& is, std::size_t* const width,
+                  std::size_t* const height, std::size_t* const depth,
+                  std::vector<int> const* const channel_map,
+                  std::vector<SampleT>* const pixel_data,
+                  std::string* const tuple_type,
+                  std::uint32_t* const max_value) {
+  auto header = ReadHeader(is);
+  ThrowIfInvalidMagicNumber<std::runtime_error>(header.magic_number,
+                                                PamMagicNumber());
+  if (sizeof(SampleT) == 1) {
+    ThrowIfMaxValueExceeds8Bit<std::runtime_error>(header.max_value);
+  }
+
+  assert(width != nullptr && "null width");
+  assert(height != nullptr && "null height");
+  *width = header.width;
+  *height = header.height;
+  if (depth != nullptr) {
+    *depth = header.depth;
+  }
+  if (tuple_type != nullptr) {
+    *tuple_type = header.tuple_type;
+  }
+  if (max_value != nullptr) {
+    *max_value = header.max_value;
+  }
+
+  assert(pixel_data != nullptr && "null pixel data");
+  if (channel_map == nullptr) {
+    // Stored layout, read straight into the pixel data.
+    pixel_data->resize(header.width * header.height * header.depth);
+    ReadSamples(is, header.max_value, pixel_data->data(), pixel_data->size());
+  } else {
+    pixel_data->resize(header.width * header.height * channel_map->size());
+    ReadPamPixelData(is, header, *channel_map, pixel_data->data());
+  }
+}
+
+}  // namespace detail
+
+/*!
+Read a PGM (greyscale) image from an input stream.
+
+Pre-conditions:
+  - the output pointers are non-null.
+
+Pixel data is read as RGB triplets in row major order. For instance,
+the pixel data for a 2x2 image is represented as follows:
+
+        Column 0      Column 1
+      +-------------+-------------+
+      |             |             |
+Row 0 | I: data[0]  | I: data[1]  |
+      |             |             |
+      +-------------+-------------+
+      |             |             |
+Row 1 | I: data[2]  | I: data[3]  |
+      |             |             |
+      +-------------+-------------+
+
+If @p max_value is non-null it is set to the max value of the image.
+Samples are in the range [0, max value].
+
+The pixel data vector is resized to fit the image. Use an
+UninitializedVector to avoid zero-filling memory that is about to be
+overwritten, or the pointer overload to read into an existing buffer.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P5'.
+  - width or height is zero.
+  - the max value is not in the range [1, 255], see the std::uint16_t
+    overload for images with larger max values.
+  - the pixel data cannot be read.
+*/
+template <typename AllocatorT>
+void ReadPgmImage(std::istream& is, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                  std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto const header = detail::ReadImageHeader<std::uint8_t>(
+      is, detail::PgmMagicNumber(), width, height, max_value);
+  timer.Mark(IoPhase::kHeader);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  pixel_data->resize(header.width * header.height);
+  timer.Mark(IoPhase::kAllocate, pixel_data->size());
+  detail::ReadPixelData(is, pixel_data->data(), pixel_data->size());
+  timer.Mark(IoPhase::kRaster, pixel_data->size());
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+template <typename AllocatorT>
+void ReadPgmImage(std::string const& filename, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                  std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPgmImage(ifs, width, height, pixel_data, max_value);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+As the std::vector overload, but pixel data is read into @p pixel_data,
+which has room for @p capacity samples. No memory is allocated, so the
+same buffer can be reused for any number of images. Width, height and
+max value are set before the capacity is checked, so that the required
+capacity, width * height, is known if the check fails.
+
+An std::runtime_error is thrown if:
+  - @p capacity is less than the number of samples in the image.
+  - any of the conditions for the std::vector overload apply.
+*/
+inline void ReadPgmImage(std::istream& is, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint8_t* const pixel_data,
+                         std::size_t const capacity,
+                         std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto const header = detail::ReadImageHeader<std::uint8_t>(
+      is, detail::PgmMagicNumber(), width, height, max_value);
+  timer.Mark(IoPhase::kHeader);
+  auto const sample_count = header.width * header.height;
+  detail::ThrowIfCapacityExceeded(sample_count, capacity);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  detail::ReadPixelData(is, pixel_data, sample_count);
+  timer.Mark(IoPhase::kRaster, sample_count);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPgmImage(std::string const& filename, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint8_t* const pixel_data,
+                         std::size_t const capacity,
+                         std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPgmImage(ifs, width, height, pixel_data, capacity, max_value);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Read a PGM (greyscale) image with any max value in the range [1, 65535] from an
+input stream into 16-bit pixel data.
+
+Pixel data is laid out as for the std::uint8_t overload, with samples in
+native byte order. Images with a max value less than 256 store one byte
+per sample, these are widened to 16 bits.
+
+If @p max_value is non-null it is set to the max value of the image. If
+@p scaling is SampleScaling::kFullRange samples are rescaled from
+[0, max value] to [0, 65535], otherwise samples are returned as stored.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P5'.
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+  - the pixel data cannot be read.
+*/
+template <typename AllocatorT>
+void ReadPgmImage(std::istream& is, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint16_t, AllocatorT>* const pixel_data,
+                  std::uint32_t* const max_value = nullptr,
+                  SampleScaling const scaling = SampleScaling::kNone) {
+  auto timer = detail::PhaseTimer(false);
+  auto const header = detail::ReadImageHeader<std::uint16_t>(
+      is, detail::PgmMagicNumber(), width, height, max_value);
+  timer.Mark(IoPhase::kHeader);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  pixel_data->resize(header.width * header.height);
+  timer.Mark(IoPhase::kAllocate, pixel_data->size() * sizeof(std::uint16_t));
+  detail::ReadSamples16(is, header.max_value, scaling, pixel_data->data(),
+                        pixel_data->size(), &timer);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+template <typename AllocatorT>
+void ReadPgmImage(std::string const& filename, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint16_t, AllocatorT>* const pixel_data,
+                  std::uint32_t* const max_value = nullptr,
+                  SampleScaling const scaling = SampleScaling::kNone) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPgmImage(ifs, width, height, pixel_data, max_value, scaling);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+As the std::vector overload, but pixel data is read into @p pixel_data,
+which has room for @p capacity samples. See the std::uint8_t pointer
+overload.
+*/
+inline void ReadPgmImage(std::istream& is, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint16_t* const pixel_data,
+                         std::size_t const capacity,
+                         std::uint32_t* const max_value = nullptr,
+                         SampleScaling const scaling = SampleScaling::kNone) {
+  auto timer = detail::PhaseTimer(false);
+  auto const header = detail::ReadImageHeader<std::uint16_t>(
+      is, detail::PgmMagicNumber(), width, height, max_value);
+  timer.Mark(IoPhase::kHeader);
+  auto const sample_count = header.width * header.height;
+  detail::ThrowIfCapacityExceeded(sample_count, capacity);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  detail::ReadSamples16(is, header.max_value, scaling, pixel_data,
+                        sample_count, &timer);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPgmImage(std::string const& filename, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint16_t* const pixel_data,
+                         std::size_t const capacity,
+                         std::uint32_t* const max_value = nullptr,
+                         SampleScaling const scaling = SampleScaling::kNone) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPgmImage(ifs, width, height, pixel_data, capacity, max_value, scaling);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Write a PGM (greyscale) image to an output stream.
+
+Pixel data is given a intensities in row major order. For instance,
+the pixel data for a 2x2 image is represented as follows:
+
+        Column 0      Column 1
+      +-------------+-------------+
+      |             |             |
+Row 0 | I: data[0]  | I: data[1]  |
+      |             |             |
+      +-------------+-------------+
+      |             |             |
+Row 1 | I: data[2]  | I: data[3]  |
+      |             |             |
+      +-------------+-------------+
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+  - the size of the pixel data does not match the width and height.
+*/
+inline void WritePgmImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height,
+                          std::uint8_t const* const pixel_data) {
+  auto timer = detail::PhaseTimer(true);
+  auto header = detail::Header{};
+  header.magic_number = detail::PgmMagicNumber();
+  header.width = width;
+  header.height = height;
+  detail::WriteHeader(os, header);
+  timer.Mark(IoPhase::kHeader);
+  detail::WritePixelData(os, pixel_data, header.width * header.height);
+  timer.Mark(IoPhase::kRaster, header.width * header.height);
+}
+
+/*!
+See std::ostream overload version above.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void WritePgmImage(std::string const& filename, std::size_t const width,
+                          std::size_t const height,
+                          std::uint8_t const* const pixel_data) {
+  auto timer = detail::PhaseTimer(true);
+  auto ofs = std::ofstream{};
+  detail::OpenFileStream(&ofs, filename);
+  timer.Mark(IoPhase::kOpen);
+  WritePgmImage(ofs, width, height, pixel_data);
+  timer.Restart();
+  ofs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Write a PGM (greyscale) image with 16-bit pixel data to an output stream.
+
+Pixel data is laid out as for the std::uint8_t overload, with samples in
+native byte order. Samples must be in the range [0, max_value]. If
+@p max_value is less than 256 samples are stored as one byte, otherwise
+as two bytes.
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+*/
+inline void WritePgmImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height,
+                          std::uint16_t const* const pixel_data,
+                          std::uint32_t const max_value = 65535) {
+  auto timer = detail::PhaseTimer(true);
+  auto header = detail::Header{};
+  header.magic_number = detail::PgmMagicNumber();
+  header.width = width;
+  header.height = height;
+  header.max_value = max_value;
+  detail::WriteHeader(os, header);
+  timer.Mark(IoPhase::kHeader);
+  // Not taken from the header, which escapes into WriteHeader, so that the
+  // compiler can bound the sample loops (avoids spurious -Warray-bounds).
+  auto const sample_count = width * height;
+  detail::WriteSamples16(os, max_value, pixel_data, sample_count);
+  timer.Mark(IoPhase::kRaster,
+             sample_count * detail::BytesPerSample(header.max_value));
+}
+
+/*!
+See std::ostream overload version above.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void WritePgmImage(std::string const& filename, std::size_t const width,
+                          std::size_t const height,
+                          std::uint16_t const* const pixel_data,
+                          std::uint32_t const max_value = 65535) {
+  auto timer = detail::PhaseTimer(true);
+  auto ofs = std::ofstream{};
+  detail::OpenFileStream(&ofs, filename);
+  timer.Mark(IoPhase::kOpen);
+  WritePgmImage(ofs, width, height, pixel_data, max_value);
+  timer.Restart();
+  ofs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Read a PPM (RGB) image from an input stream.
+
+Pre-conditions:
+  - the output pointers are non-null.
+
+Pixel data is read as RGB triplets in row major order. For instance,
+the pixel data for a 2x2 image is represented as follows:
+
+        Column 0                           Column 1
+      +----------------------------------+------------------------------------+
+      |                                  |                                    |
+Row 0 | RGB: {data[0], data[1], data[2]} | RGB: {data[3], data[4], data[5]}   |
+      |                                  |                                    |
+      +----------------------------------+------------------------------------+
+      |                                  |                                    |
+Row 1 | RGB: {data[6], data[7], data[8]} | RGB: {data[9], data[10], data[11]} |
+      |                                  |                                    |
+      +----------------------------------+------------------------------------+
+
+If @p max_value is non-null it is set to the max value of the image.
+Samples are in the range [0, max value].
+
+The pixel data vector is resized to fit the image. Use an
+UninitializedVector to avoid zero-filling memory that is about to be
+overwritten, or the pointer overload to read into an existing buffer.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P6'.
+  - width or height is zero.
+  - the max value is not in the range [1, 255], see the std::uint16_t
+    overload for images with larger max values.
+  - the pixel data cannot be read.
+*/
+template <typename AllocatorT>
+void ReadPpmImage(std::istream& is, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                  std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto const header = detail::ReadImageHeader<std::uint8_t>(
+      is, detail::PpmMagicNumber(), width, height, max_value);
+  timer.Mark(IoPhase::kHeader);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  pixel_data->resize(header.width * header.height * 3);
+  timer.Mark(IoPhase::kAllocate, pixel_data->size());
+  detail::ReadPixelData(is, pixel_data->data(), pixel_data->size());
+  timer.Mark(IoPhase::kRaster, pixel_data->size());
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+template <typename AllocatorT>
+void ReadPpmImage(std::string const& filename, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                  std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPpmImage(ifs, width, height, pixel_data, max_value);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+As the std::vector overload, but pixel data is read into @p pixel_data,
+which has room for @p capacity samples. No memory is allocated, so the
+same buffer can be reused for any number of images. Width, height and
+max value are set before the capacity is checked, so that the required
+capacity, width * height * 3, is known if the check fails.
+
+An std::runtime_error is thrown if:
+  - @p capacity is less than the number of samples in the image.
+  - any of the conditions for the std::vector overload apply.
+*/
+inline void ReadPpmImage(std::istream& is, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint8_t* const pixel_data,
+                         std::size_t const capacity,
+                         std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto const header = detail::ReadImageHeader<std::uint8_t>(
+      is, detail::PpmMagicNumber(), width, height, max_value);
+  timer.Mark(IoPhase::kHeader);
+  auto const sample_count = header.width * header.height * 3;
+  detail::ThrowIfCapacityExceeded(sample_count, capacity);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  detail::ReadPixelData(is, pixel_data, sample_count);
+  timer.Mark(IoPhase::kRaster, sample_count);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPpmImage(std::string const& filename, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint8_t* const pixel_data,
+                         std::size_t const capacity,
+                         std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPpmImage(ifs, width, height, pixel_data, capacity, max_value);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Read a PPM (RGB) image with any max value in the range [1, 65535] from an
+input stream into 16-bit pixel data.
+
+Pixel data is laid out as for the std::uint8_t overload, with samples in
+native byte order. Images with a max value less than 256 store one byte
+per sample, these are widened to 16 bits.
+
+If @p max_value is non-null it is set to the max value of the image. If
+@p scaling is SampleScaling::kFullRange samples are rescaled from
+[0, max value] to [0, 65535], otherwise samples are returned as stored.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P6'.
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+  - the pixel data cannot be read.
+*/
+template <typename AllocatorT>
+void ReadPpmImage(std::istream& is, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint16_t, AllocatorT>* const pixel_data,
+                  std::uint32_t* const max_value = nullptr,
+                  SampleScaling const scaling = SampleScaling::kNone) {
+  auto timer = detail::PhaseTimer(false);
+  auto const header = detail::ReadImageHeader<std::uint16_t>(
+      is, detail::PpmMagicNumber(), width, height, max_value);
+  timer.Mark(IoPhase::kHeader);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  pixel_data->resize(header.width * header.height * 3);
+  timer.Mark(IoPhase::kAllocate, pixel_data->size() * sizeof(std::uint16_t));
+  detail::ReadSamples16(is, header.max_value, scaling, pixel_data->data(),
+                        pixel_data->size(), &timer);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+template <typename AllocatorT>
+void ReadPpmImage(std::string const& filename, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint16_t, AllocatorT>* const pixel_data,
+                  std::uint32_t* const max_value = nullptr,
+                  SampleScaling const scaling = SampleScaling::kNone) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPpmImage(ifs, width, height, pixel_data, max_value, scaling);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+As the std::vector overload, but pixel data is read into @p pixel_data,
+which has room for @p capacity samples. See the std::uint8_t pointer
+overload.
+*/
+inline void ReadPpmImage(std::istream& is, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint16_t* const pixel_data,
+                         std::size_t const capacity,
+                         std::uint32_t* const max_value = nullptr,
+                         SampleScaling const scaling = SampleScaling::kNone) {
+  auto timer = detail::PhaseTimer(false);
+  auto const header = detail::ReadImageHeader<std::uint16_t>(
+      is, detail::PpmMagicNumber(), width, height, max_value);
+  timer.Mark(IoPhase::kHeader);
+  auto const sample_count = header.width * header.height * 3;
+  detail::ThrowIfCapacityExceeded(sample_count, capacity);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  detail::ReadSamples16(is, header.max_value, scaling, pixel_data,
+                        sample_count, &timer);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPpmImage(std::string const& filename, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint16_t* const pixel_data,
+                         std::size_t const capacity,
+                         std::uint32_t* const max_value = nullptr,
+                         SampleScaling const scaling = SampleScaling::kNone) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPpmImage(ifs, width, height, pixel_data, capacity, max_value, scaling);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Write a PPM (RGB) image to an output stream.
+
+Pixel data is given as RGB triplets in row major order. For instance,
+the pixel data for a 2x2 image is represented as follows:
+
+        Column 0                           Column 1
+      +----------------------------------+------------------------------------+
+      |                                  |                                    |
+Row 0 | RGB: {data[0], data[1], data[2]} | RGB: {data[3], data[4], data[5]}   |
+      |                                  |                                    |
+      +----------------------------------+------------------------------------+
+      |                                  |                                    |
+Row 1 | RGB: {data[6], data[7], data[8]} | RGB: {data[9], data[10], data[11]} |
+      |                                  |                                    |
+      +----------------------------------+------------------------------------+
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+  - the size of the pixel data does not match the width and height.
+*/
+inline void WritePpmImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height,
+                          std::uint8_t const* const pixel_data) {
+  auto timer = detail::PhaseTimer(true);
+  auto header = detail::Header{};
+  header.magic_number = detail::PpmMagicNumber();
+  header.width = width;
+  header.height = height;
+  detail::WriteHeader(os, header);
+  timer.Mark(IoPhase::kHeader);
+  detail::WritePixelData(os, pixel_data, header.width * header.height * 3);
+  timer.Mark(IoPhase::kRaster, header.width * header.height * 3);
+}
+
+/*!
+See std::ostream overload version above.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void WritePpmImage(std::string const& filename, std::size_t const width,
+                          std::size_t const height,
+                          std::uint8_t const* const pixel_data) {
+  auto timer = detail::PhaseTimer(true);
+  auto ofs = std::ofstream{};
+  detail::OpenFileStream(&ofs, filename);
+  timer.Mark(IoPhase::kOpen);
+  WritePpmImage(ofs, width, height, pixel_data);
+  timer.Restart();
+  ofs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Write a PPM (RGB) image with 16-bit pixel data to an output stream.
+
+Pixel data is laid out as for the std::uint8_t overload, with samples in
+native byte order. Samples must be in the range [0, max_value]. If
+@p max_value is less than 256 samples are stored as one byte, otherwise
+as two bytes.
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+*/
+inline void WritePpmImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height,
+                          std::uint16_t const* const pixel_data,
+                          std::uint32_t const max_value = 65535) {
+  auto timer = detail::PhaseTimer(true);
+  auto header = detail::Header{};
+  header.magic_number = detail::PpmMagicNumber();
+  header.width = width;
+  header.height = height;
+  header.max_value = max_value;
+  detail::WriteHeader(os, header);
+  timer.Mark(IoPhase::kHeader);
+  auto const sample_count = width * height * 3;
+  detail::WriteSamples16(os, max_value, pixel_data, sample_count);
+  timer.Mark(IoPhase::kRaster,
+             sample_count * detail::BytesPerSample(header.max_value));
+}
+
+/*!
+See std::ostream overload version above.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void WritePpmImage(std::string const& filename, std::size_t const width,
+                          std::size_t const height,
+                          std::uint16_t const* const pixel_data,
+                          std::uint32_t const max_value = 65535) {
+  auto timer = detail::PhaseTimer(true);
+  auto ofs = std::ofstream{};
+  detail::OpenFileStream(&ofs, filename);
+  timer.Mark(IoPhase::kOpen);
+  WritePpmImage(ofs, width, height, pixel_data, max_value);
+  timer.Restart();
+  ofs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Read a plain (ASCII) PGM (greyscale) image, magic number 'P2', from an input
+stream.
+
+The pixel data is read until the end of the stream, which must hold a
+single image. Samples are parsed without formatted stream extraction,
+large images are parsed concurrently. Pixel data is laid out as for
+ReadPgmImage. If @p max_value is non-null it is set to the max value of
+the image.
+
+Pre-conditions:
+  - the output pointers are non-null.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P2'.
+  - width or height is zero.
+  - the max value is not in the range [1, 255], see the std::uint16_t
+    overload for images with larger max values.
+  - the pixel data contains anything but samples and whitespace.
+  - a sample is larger than the max value.
+  - the number of samples does not match width and height.
+*/
+inline void ReadPlainPgmImage(std::istream& is, std::size_t* const width,
+                              std::size_t* const height,
+                              std::vector<std::uint8_t>* const pixel_data,
+                              std::uint32_t* const max_value = nullptr) {
+  detail::ReadPlainImage(is, detail::PlainPgmMagicNumber(), 1, width, height,
+                         pixel_data, max_value);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPlainPgmImage(std::string const& filename,
+                              std::size_t* const width,
+                              std::size_t* const height,
+                              std::vector<std::uint8_t>* const pixel_data,
+                              std::uint32_t* const max_value = nullptr) {
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  ReadPlainPgmImage(ifs, width, height, pixel_data, max_value);
+  ifs.close();
+}
+
+/*!
+As the std::uint8_t overload, but accepts any max value in the range
+[1, 65535]. If @p scaling is SampleScaling::kFullRange samples are
+rescaled from [0, max value] to [0, 65535].
+*/
+inline void ReadPlainPgmImage(
+    std::istream& is, std::size_t* const width, std::size_t* const height,
+    std::vector<std::uint16_t>* const pixel_data,
+    std::uint32_t* const max_value = nullptr,
+    SampleScaling const scaling = SampleScaling::kNone) {
+  auto image_max_value = std::uint32_t{0};
+  detail::ReadPlainImage(is, detail::PlainPgmMagicNumber(), 1, width, height,
+                         pixel_data, &image_max_value);
+  if (max_value != nullptr) {
+    *max_value = image_max_value;
+  }
+  if (scaling == SampleScaling::kFullRange) {
+    detail::RescaleToFullRange16(pixel_data->data(), pixel_data->size(),
+                                 image_max_value);
+  }
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPlainPgmImage(
+    std::string const& filename, std::size_t* const width,
+    std::size_t* const height, std::vector<std::uint16_t>* const pixel_data,
+    std::uint32_t* const max_value = nullptr,
+    SampleScaling const scaling = SampleScaling::kNone) {
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  ReadPlainPgmImage(ifs, width, height, pixel_data, max_value, scaling);
+  ifs.close();
+}
+
+/*!
+Read a plain (ASCII) PPM (RGB) image, magic number 'P3', from an input
+stream.
+
+The pixel data is read until the end of the stream, which must hold a
+single image. Samples are parsed without formatted stream extraction,
+large images are parsed concurrently. Pixel data is laid out as for
+ReadPpmImage. If @p max_value is non-null it is set to the max value of
+the image.
+
+Pre-conditions:
+  - the output pointers are non-null.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P3'.
+  - width or height is zero.
+  - the max value is not in the range [1, 255], see the std::uint16_t
+    overload for images with larger max values.
+  - the pixel data contains anything but samples and whitespace.
+  - a sample is larger than the max value.
+  - the number of samples does not match width and height.
+*/
+inline void ReadPlainPpmImage(std::istream& is, std::size_t* const width,
+                              std::size_t* const height,
+                              std::vector<std::uint8_t>* const pixel_data,
+                              std::uint32_t* const max_value = nullptr) {
+  detail::ReadPlainImage(is, detail::PlainPpmMagicNumber(), 3, width, height,
+                         pixel_data, max_value);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPlainPpmImage(std::string const& filename,
+                              std::size_t* const width,
+                              std::size_t* const height,
+                              std::vector<std::uint8_t>* const pixel_data,
+                              std::uint32_t* const max_value = nullptr) {
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  ReadPlainPpmImage(ifs, width, height, pixel_data, max_value);
+  ifs.close();
+}
+
+/*!
+As the std::uint8_t overload, but accepts any max value in the range
+[1, 65535]. If @p scaling is SampleScaling::kFullRange samples are
+rescaled from [0, max value] to [0, 65535].
+*/
+inline void ReadPlainPpmImage(
+    std::istream& is, std::size_t* const width, std::size_t* const height,
+    std::vector<std::uint16_t>* const pixel_data,
+    std::uint32_t* const max_value = nullptr,
+    SampleScaling const scaling = SampleScaling::kNone) {
+  auto image_max_value = std::uint32_t{0};
+  detail::ReadPlainImage(is, detail::PlainPpmMagicNumber(), 3, width, height,
+                         pixel_data, &image_max_value);
+  if (max_value != nullptr) {
+    *max_value = image_max_value;
+  }
+  if (scaling == SampleScaling::kFullRange) {
+    detail::RescaleToFullRange16(pixel_data->data(), pixel_data->size(),
+                                 image_max_value);
+  }
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPlainPpmImage(
+    std::string const& filename, std::size_t* const width,
+    std::size_t* const height, std::vector<std::uint16_t>* const pixel_data,
+    std::uint32_t* const max_value = nullptr,
+    SampleScaling const scaling = SampleScaling::kNone) {
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  ReadPlainPpmImage(ifs, width, height, pixel_data, max_value, scaling);
+  ifs.close();
+}
+
+/*!
+Read a PBM (bitmap) image, magic number 'P4', from an input stream.
+
+If @p layout is PbmLayout::kExpanded (the default) pixel data is read as
+one byte per pixel in row major order, as for ReadPgmImage, with the
+value 0 for black pixels and 255 for white pixels. If @p layout is
+PbmLayout::kPacked pixel data is returned as stored, with each row
+occupying (width + 7) / 8 bytes. Pixels are stored one bit per pixel,
+the first pixel in the most significant bit, and set bits are black.
+The values of the padding bits at the end of each row are unspecified.
+
+Pre-conditions:
+  - the output pointers are non-null.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P4'.
+  - width or height is zero.
+  - the pixel data cannot be read.
+*/
+inline void ReadPbmImage(std::istream& is, std::size_t* const width,
+                         std::size_t* const height,
+                         std::vector<std::uint8_t>* const pixel_data,
+                         PbmLayout const layout = PbmLayout::kExpanded) {
+  auto header = detail::ReadHeader(is);
+  detail::ThrowIfInvalidMagicNumber<std::runtime_error>(
+      header.magic_number, detail::PbmMagicNumber());
+
+  assert(width != nullptr && "null width");
+  assert(height != nullptr && "null height");
+  *width = header.width;
+  *height = header.height;
+
+  assert(pixel_data != nullptr && "null pixel data");
+  if (layout == PbmLayout::kPacked) {
+    pixel_data->resize(detail::PackedRowSize(*width) * (*height));
+    detail::ReadPixelData(is, pixel_data);
+  } else {
+    pixel_data->resize((*width) * (*height));
+    detail::ReadPbmPixelData(is, *width, *height, pixel_data->data());
+  }
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPbmImage(std::string const& filename, std::size_t* const width,
+                         std::size_t* const height,
+                         std::vector<std::uint8_t>* const pixel_data,
+                         PbmLayout const layout = PbmLayout::kExpanded) {
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  ReadPbmImage(ifs, width, height, pixel_data, layout);
+  ifs.close();
+}
+
+/*!
+Write a PBM (bitmap) image, magic number 'P4', to an output stream.
+
+Pixel data is laid out as described for ReadPbmImage. With
+PbmLayout::kExpanded pixels with the value 0 are written as black and
+any other value as white, rows are packed to one bit per pixel on the
+fly. With PbmLayout::kPacked rows are written as given.
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+*/
+inline void WritePbmImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height,
+                          std::uint8_t const* const pixel_data,
+                          PbmLayout const layout = PbmLayout::kExpanded) {
   auto header = detail::Header{};
-  header.magic_number = detail::PgmMagicNumber();
+  header.magic_number = detail::PbmMagicNumber();
   header.width = width;
   header.height = height;
   detail::WriteHeader(os, header);
-  detail::WritePixelData(os, pixel_data, header.width * header.height);
+  if (layout == PbmLayout::kPacked) {
+    detail::WritePixelData(os, pixel_data,
+                           detail::PackedRowSize(width) * height);
+  } else {
+    detail::WritePbmPixelData(os, width, height, pixel_data);
+  }
 }
 
 /*!
@@ -229,48 +2185,41 @@ See std::ostream overload version above.
 
 Throws an std::runtime_error if file cannot be opened.
 */
-inline void WritePgmImage(std::string const& filename, std::size_t const width,
+inline void WritePbmImage(std::string const& filename, std::size_t const width,
                           std::size_t const height,
-                          std::uint8_t const* const pixel_data) {
+                          std::uint8_t const* const pixel_data,
+                          PbmLayout const layout = PbmLayout::kExpanded) {
   auto ofs = std::ofstream{};
   detail::OpenFileStream(&ofs, filename);
-  WritePgmImage(ofs, width, height, pixel_data);
+  WritePbmImage(ofs, width, height, pixel_data, layout);
   ofs.close();
 }
 
 /*!
-Read a PPM (RGB) image from an input stream.
+Read a plain (ASCII) PBM (bitmap) image, magic number 'P1', from an input
+stream.
+
+The pixel data is read until the end of the stream, which must hold a
+single image. Each pixel is a '1' (black) or '0' (white) character,
+whitespace between pixels is optional. Pixel data is laid out as for
+ReadPbmImage.
 
 Pre-conditions:
-  - the PPM header does not contain any comments.
   - the output pointers are non-null.
 
-Pixel data is read as RGB triplets in row major order. For instance,
-the pixel data for a 2x2 image is represented as follows:
-
-        Column 0                           Column 1
-      +----------------------------------+------------------------------------+
-      |                                  |                                    |
-Row 0 | RGB: {data[0], data[1], data[2]} | RGB: {data[3], data[4], data[5]}   |
-      |                                  |                                    |
-      +----------------------------------+------------------------------------+
-      |                                  |                                    |
-Row 1 | RGB: {data[6], data[7], data[8]} | RGB: {data[9], data[10], data[11]} |
-      |                                  |                                    |
-      +----------------------------------+------------------------------------+
-
 An std::runtime_error is thrown if:
-  - the magic number is not 'P6'.
+  - the magic number is not 'P1'.
   - width or height is zero.
-  - the max value is not '255'.
-  - the pixel data cannot be read.
+  - the pixel data contains anything but '0', '1' and whitespace.
+  - the number of pixels does not match width and height.
 */
-inline void ReadPpmImage(std::istream& is, std::size_t* const width,
-                         std::size_t* const height,
-                         std::vector<std::uint8_t>* const pixel_data) {
+inline void ReadPlainPbmImage(std::istream& is, std::size_t* const width,
+                              std::size_t* const height,
+                              std::vector<std::uint8_t>* const pixel_data,
+                              PbmLayout const layout = PbmLayout::kExpanded) {
   auto header = detail::ReadHeader(is);
   detail::ThrowIfInvalidMagicNumber<std::runtime_error>(
-      header.magic_number, detail::PpmMagicNumber());
+      header.magic_number, detail::PlainPbmMagicNumber());
 
   assert(width != nullptr && "null width");
   assert(height != nullptr && "null height");
@@ -278,8 +2227,18 @@ inline void ReadPpmImage(std::istream& is, std::size_t* const width,
   *height = header.height;
 
   assert(pixel_data != nullptr && "null pixel data");
-  pixel_data->resize((*width) * (*height) * 3);
-  detail::ReadPixelData(is, pixel_data);
+  pixel_data->resize((*width) * (*height));
+  detail::ReadPlainBits(detail::ReadRemaining(is), pixel_data->data(),
+                        pixel_data->size());
+  if (layout == PbmLayout::kPacked) {
+    // Pack in place, packed rows never overtake the expanded rows.
+    auto const packed_row_size = detail::PackedRowSize(*width);
+    for (auto row = std::size_t{0}; row < *height; ++row) {
+      detail::PackBits(pixel_data->data() + row * (*width),
+                       pixel_data->data() + row * packed_row_size, *width);
+    }
+    pixel_data->resize(packed_row_size * (*height));
+  }
 }
 
 /*!
@@ -287,45 +2246,221 @@ See std::istream overload version.
 
 Throws an std::runtime_error if file cannot be opened.
 */
-inline void ReadPpmImage(std::string const& filename, std::size_t* const width,
+inline void ReadPlainPbmImage(std::string const& filename,
+                              std::size_t* const width,
+                              std::size_t* const height,
+                              std::vector<std::uint8_t>* const pixel_data,
+                              PbmLayout const layout = PbmLayout::kExpanded) {
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  ReadPlainPbmImage(ifs, width, height, pixel_data, layout);
+  ifs.close();
+}
+
+/*!
+Read a PAM image, magic number 'P7', from an input stream.
+
+Pixel data is read as stored, with @p depth samples per pixel interleaved
+in row major order, for instance RGBA quadruplets for the tuple type
+'RGB_ALPHA'. If @p tuple_type is non-null it is set to the tuple type of
+the image, or the empty string if the header has none. If @p max_value
+is non-null it is set to the max value of the image.
+
+Pre-conditions:
+  - the output pointers for width, height, depth and pixel data are
+    non-null.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P7'.
+  - the header contains an unknown keyword or does not end with ENDHDR.
+  - width, height or depth is zero.
+  - the max value is not in the range [1, 255], see the std::uint16_t
+    overload for images with larger max values.
+  - the pixel data cannot be read.
+*/
+inline void ReadPamImage(std::istream& is, std::size_t* const width,
+                         std::size_t* const height, std::size_t* const depth,
+                         std::vector<std::uint8_t>* const pixel_data,
+                         std::string* const tuple_type = nullptr,
+                         std::uint32_t* const max_value = nullptr) {
+  assert(depth != nullptr && "null depth");
+  detail::ReadPamImage(is, width, height, depth, nullptr, pixel_data,
+                       tuple_type, max_value);
+}
+
+/*!
+Read a PAM image, magic number 'P7', from an input stream into pixels
+with a caller-chosen interleaved layout.
+
+Each pixel has channel_map.size() samples, sample c is taken from stored
+channel channel_map[c] or, if channel_map[c] is negative, set to the max
+value of the image. For instance, {0, 0, 0, 1} reads a 'GRAYSCALE_ALPHA'
+image as RGBA, {0, 1, 2, -1} reads an 'RGB' image as opaque RGBA and
+{2, 1, 0} reads an 'RGB_ALPHA' image as BGR. Samples are rearranged as
+they are read, without a separate pass over the image.
+
+An std::invalid_argument is thrown if @p channel_map is empty.
+
+An std::runtime_error is thrown if:
+  - a channel map index is not less than the depth of the image.
+  - any of the conditions for the stored layout overload apply.
+*/
+inline void ReadPamImage(std::istream& is, std::size_t* const width,
+                         std::size_t* const height,
+                         std::vector<int> const& channel_map,
+                         std::vector<std::uint8_t>* const pixel_data,
+                         std::string* const tuple_type = nullptr,
+                         std::uint32_t* const max_value = nullptr) {
+  detail::ReadPamImage(is, width, height, nullptr, &channel_map, pixel_data,
+                       tuple_type, max_value);
+}
+
+/*!
+As the std::uint8_t overload, but accepts any max value in the range
+[1, 65535]. Samples are in native byte order.
+*/
+inline void ReadPamImage(std::istream& is, std::size_t* const width,
+                         std::size_t* const height, std::size_t* const depth,
+                         std::vector<std::uint16_t>* const pixel_data,
+                         std::string* const tuple_type = nullptr,
+                         std::uint32_t* const max_value = nullptr) {
+  assert(depth != nullptr && "null depth");
+  detail::ReadPamImage(is, width, height, depth, nullptr, pixel_data,
+                       tuple_type, max_value);
+}
+
+/*!
+As the std::uint8_t overload, but accepts any max value in the range
+[1, 65535]. Samples are in native byte order.
+*/
+inline void ReadPamImage(std::istream& is, std::size_t* const width,
                          std::size_t* const height,
-                         std::vector<std::uint8_t>* const pixel_data) {
+                         std::vector<int> const& channel_map,
+                         std::vector<std::uint16_t>* const pixel_data,
+                         std::string* const tuple_type = nullptr,
+                         std::uint32_t* const max_value = nullptr) {
+  detail::ReadPamImage(is, width, height, nullptr, &channel_map, pixel_data,
+                       tuple_type, max_value);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPamImage(std::string const& filename, std::size_t* const width,
+                         std::size_t* const height, std::size_t* const depth,
+                         std::vector<std::uint8_t>* const pixel_data,
+                         std::string* const tuple_type = nullptr,
+                         std::uint32_t* const max_value = nullptr) {
   auto ifs = std::ifstream{};
   detail::OpenFileStream(&ifs, filename);
-  ReadPpmImage(ifs, width, height, pixel_data);
+  ReadPamImage(ifs, width, height, depth, pixel_data, tuple_type,
+               max_value);
   ifs.close();
 }
 
 /*!
-Write a PPM (RGB) image to an output stream.
+See std::istream overload version.
 
-Pixel data is given as RGB triplets in row major order. For instance,
-the pixel data for a 2x2 image is represented as follows:
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPamImage(std::string const& filename, std::size_t* const width,
+                         std::size_t* const height,
+                         std::vector<int> const& channel_map,
+                         std::vector<std::uint8_t>* const pixel_data,
+                         std::string* const tuple_type = nullptr,
+                         std::uint32_t* const max_value = nullptr) {
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  ReadPamImage(ifs, width, height, channel_map, pixel_data, tuple_type,
+               max_value);
+  ifs.close();
+}
 
-        Column 0                           Column 1
-      +----------------------------------+------------------------------------+
-      |                                  |                                    |
-Row 0 | RGB: {data[0], data[1], data[2]} | RGB: {data[3], data[4], data[5]}   |
-      |                                  |                                    |
-      +----------------------------------+------------------------------------+
-      |                                  |                                    |
-Row 1 | RGB: {data[6], data[7], data[8]} | RGB: {data[9], data[10], data[11]} |
-      |                                  |                                    |
-      +----------------------------------+------------------------------------+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPamImage(std::string const& filename, std::size_t* const width,
+                         std::size_t* const height, std::size_t* const depth,
+                         std::vector<std::uint16_t>* const pixel_data,
+                         std::string* const tuple_type = nullptr,
+                         std::uint32_t* const max_value = nullptr) {
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  ReadPamImage(ifs, width, height, depth, pixel_data, tuple_type,
+               max_value);
+  ifs.close();
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPamImage(std::string const& filename, std::size_t* const width,
+                         std::size_t* const height,
+                         std::vector<int> const& channel_map,
+                         std::vector<std::uint16_t>* const pixel_data,
+                         std::string* const tuple_type = nullptr,
+                         std::uint32_t* const max_value = nullptr) {
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  ReadPamImage(ifs, width, height, channel_map, pixel_data, tuple_type,
+               max_value);
+  ifs.close();
+}
+
+/*!
+Write a PAM image, magic number 'P7', to an output stream.
+
+Pixel data is given as @p depth interleaved samples per pixel in row major
+order. The @p tuple_type, for instance 'GRAYSCALE_ALPHA' or 'RGB_ALPHA',
+is written to the header unless it is empty. The max value is 255.
 
 An std::invalid_argument is thrown if:
-  - width or height is zero.
-  - the size of the pixel data does not match the width and height.
+  - width, height or depth is zero.
 */
-inline void WritePpmImage(std::ostream& os, std::size_t const width,
-                          std::size_t const height,
+inline void WritePamImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height, std::size_t const depth,
+                          std::string const& tuple_type,
                           std::uint8_t const* const pixel_data) {
   auto header = detail::Header{};
-  header.magic_number = detail::PpmMagicNumber();
+  header.magic_number = detail::PamMagicNumber();
   header.width = width;
   header.height = height;
+  header.depth = depth;
+  header.tuple_type = tuple_type;
   detail::WriteHeader(os, header);
-  detail::WritePixelData(os, pixel_data, header.width * header.height * 3);
+  detail::WritePixelData(os, pixel_data, width * height * depth);
+}
+
+/*!
+As the std::uint8_t overload, but @p pixel_data holds native 16-bit
+samples in the range [0, max_value]. If @p max_value is less than 256
+samples are stored as one byte, otherwise as two bytes.
+
+An std::invalid_argument is thrown if:
+  - width, height or depth is zero.
+  - the max value is not in the range [1, 65535].
+*/
+inline void WritePamImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height, std::size_t const depth,
+                          std::string const& tuple_type,
+                          std::uint16_t const* const pixel_data,
+                          std::uint32_t const max_value = 65535) {
+  auto header = detail::Header{};
+  header.magic_number = detail::PamMagicNumber();
+  header.width = width;
+  header.height = height;
+  header.depth = depth;
+  header.tuple_type = tuple_type;
+  header.max_value = max_value;
+  detail::WriteHeader(os, header);
+  detail::WriteSamples16(os, header.max_value, pixel_data,
+                         width * height * depth);
 }
 
 /*!
@@ -333,13 +2468,453 @@ See std::ostream overload version above.
 
 Throws an std::runtime_error if file cannot be opened.
 */
-inline void WritePpmImage(std::string const& filename, std::size_t const width,
-                          std::size_t const height,
+inline void WritePamImage(std::string const& filename, std::size_t const width,
+                          std::size_t const height, std::size_t const depth,
+                          std::string const& tuple_type,
                           std::uint8_t const* const pixel_data) {
   auto ofs = std::ofstream{};
   detail::OpenFileStream(&ofs, filename);
-  WritePpmImage(ofs, width, height, pixel_data);
+  WritePamImage(ofs, width, height, depth, tuple_type, pixel_data);
+  ofs.close();
+}
+
+/*!
+See std::ostream overload version above.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void WritePamImage(std::string const& filename, std::size_t const width,
+                          std::size_t const height, std::size_t const depth,
+                          std::string const& tuple_type,
+                          std::uint16_t const* const pixel_data,
+                          std::uint32_t const max_value = 65535) {
+  auto ofs = std::ofstream{};
+  detail::OpenFileStream(&ofs, filename);
+  WritePamImage(ofs, width, height, depth, tuple_type, pixel_data, max_value);
   ofs.close();
 }
 
+/*!
+Incremental reader for PGM (greyscale) and PPM (RGB) images.
+
+The header is read and validated on construction, pixel data is then read
+one strip of rows at a time. Rows are read from the stream only when they
+are requested, so memory use is bounded by the strip size rather than the
+image size. Any input stream can be used, including non-seekable streams
+such as pipes. Pixel data is laid out as described for ReadPgmImage and
+ReadPpmImage, one row after the other. Images with a max value larger than
+255 store samples as two bytes, most significant byte first, these can be
+read as native 16-bit samples using the std::uint16_t overload of ReadRows.
+
+The reader holds a reference to the stream, which must outlive the reader.
+
+Example, processing an image 64 rows at a time:
+
+  auto reader = thinks::PnmReader(is);
+  reader.ForEachStrip(64, [](std::size_t const first_row,
+                             std::size_t const row_count,
+                             std::uint8_t const* const pixel_data) {
+    // ...
+  });
+
+An std::runtime_error is thrown on construction if:
+  - the magic number is not 'P5' or 'P6'.
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+*/
+class PnmReader {
+ public:
+  explicit PnmReader(std::istream& is)
+      : is_(&is), header_(detail::ReadHeader(is)) {
+    format_ = detail::FormatFromMagicNumber(header_.magic_number);
+  }
+
+  PnmFormat format() const { return format_; }
+  std::size_t width() const { return header_.width; }
+  std::size_t height() const { return header_.height; }
+  std::size_t channels() const { return detail::ChannelCount(format_); }
+  std::uint32_t max_value() const { return header_.max_value; }
+
+  //! Number of bytes used to store each sample, one or two.
+  std::size_t bytes_per_sample() const {
+    return detail::BytesPerSample(header_.max_value);
+  }
+
+  //! Number of bytes per row of pixels, as stored.
+  std::size_t row_size() const {
+    return width() * channels() * bytes_per_sample();
+  }
+
+  //! Number of rows read so far.
+  std::size_t rows_read() const { return rows_read_; }
+
+  //! Number of rows not yet read.
+  std::size_t rows_remaining() const { return height() - rows_read_; }
+
+  /*!
+  Read the next (at most) @p row_count rows into @p pixel_data, which must
+  have room for row_count * row_size() bytes. Returns the number of rows
+  read, which is less than @p row_count only when the end of the image is
+  reached.
+
+  An std::runtime_error is thrown if the pixel data cannot be read.
+  */
+  std::size_t ReadRows(std::uint8_t* const pixel_data,
+                       std::size_t const row_count) {
+    assert(pixel_data != nullptr && "null pixel data");
+    auto const rows =
+        row_count < rows_remaining() ? row_count : rows_remaining();
+    if (rows > 0) {
+      detail::ReadPixelData(*is_, pixel_data, rows * row_size());
+      rows_read_ += rows;
+    }
+    return rows;
+  }
+
+  /*!
+  As the std::uint8_t overload, but samples are converted to native 16-bit
+  samples and @p pixel_data must have room for
+  row_count * width() * channels() samples.
+  */
+  std::size_t ReadRows(std::uint16_t* const pixel_data,
+                       std::size_t const row_count,
+                       SampleScaling const scaling = SampleScaling::kNone) {
+    assert(pixel_data != nullptr && "null pixel data");
+    auto const rows =
+        row_count < rows_remaining() ? row_count : rows_remaining();
+    if (rows > 0) {
+      detail::ReadSamples16(*is_, header_.max_value, scaling, pixel_data,
+                            rows * width() * channels());
+      rows_read_ += rows;
+    }
+    return rows;
+  }
+
+  /*!
+  Read all remaining rows in strips of (at most) @p strip_rows rows and
+  invoke @p callback for each strip as
+
+    callback(first_row, row_count, pixel_data)
+
+  where @p pixel_data holds row_count * row_size() bytes. The pixel data
+  buffer is reused between strips and is only valid during the callback.
+
+  An std::invalid_argument is thrown if @p strip_rows is zero.
+  An std::runtime_error is thrown if the pixel data cannot be read.
+  */
+  template <typename StripCallbackT>
+  void ForEachStrip(std::size_t const strip_rows, StripCallbackT callback) {
+    if (strip_rows == 0) {
+      throw std::invalid_argument("strip rows must be non-zero");
+    }
+    auto const buffer_rows =
+        strip_rows < rows_remaining() ? strip_rows : rows_remaining();
+    auto strip = std::vector<std::uint8_t>(buffer_rows * row_size());
+    while (rows_remaining() > 0) {
+      auto const first_row = rows_read_;
+      auto const row_count = ReadRows(strip.data(), strip_rows);
+      callback(first_row, row_count,
+               static_cast<std::uint8_t const*>(strip.data()));
+    }
+  }
+
+ private:
+  std::istream* is_;
+  detail::Header header_;
+  PnmFormat format_;
+  std::size_t rows_read_ = 0;
+};
+
+/*!
+Reader for streams of concatenated images, such as the frames written to
+a pipe by video tools. Each call to Next reads one frame, header and pixel
+data, into a frame buffer that is reused between frames. Frames may be in
+any of the binary formats (magic numbers 'P4' to 'P7') and may change size
+and format mid-stream. Pixel data is stored exactly as in the stream, i.e.
+packed for PBM and with two-byte samples (most significant byte first)
+when the max value is larger than 255.
+
+Headers are read through an internal buffer of @p buffer_size bytes,
+which only takes bytes the stream already has available, and the rest of
+the frame is then read with a single read of exactly the remaining size,
+straight into the frame buffer. The reader therefore never waits for data
+beyond the end of the current frame, e.g. for the next frame on a pipe.
+
+The reader holds a reference to the stream, which must outlive the reader.
+
+Example, processing frames from standard input:
+
+  auto reader = thinks::PnmFrameReader(std::cin);
+  while (reader.Next()) {
+    // ... use reader.pixel_data(), reader.frame_latency().
+  }
+
+An std::invalid_argument is thrown on construction if:
+  - the buffer size is zero.
+*/
+class PnmFrameReader {
+ public:
+  explicit PnmFrameReader(std::istream& is,
+                          std::size_t const buffer_size = 1 << 20)
+      : buffer_(is.rdbuf(), ThrowIfInvalidBufferSize(buffer_size)) {}
+
+  /*!
+  See std::istream overload version above. The file, which may be a named
+  pipe, is owned by the reader.
+
+  Throws an std::runtime_error if file cannot be opened.
+  */
+  explicit PnmFrameReader(std::string const& filename,
+                          std::size_t const buffer_size = 1 << 20)
+      : ifs_(OpenFile(filename)),
+        buffer_(ifs_->rdbuf(), ThrowIfInvalidBufferSize(buffer_size)) {}
+
+  /*!
+  Read the next frame. Returns false if the end of the stream was reached
+  before the first byte of a frame, in which case the previous frame is
+  kept. Whitespace between frames is skipped.
+
+  An std::runtime_error is thrown if:
+    - the header is invalid, see ReadPgmImage.
+    - the magic number is not 'P4', 'P5', 'P6' or 'P7'.
+    - the stream ends within the frame.
+  */
+  bool Next() {
+    auto const start = std::chrono::steady_clock::now();
+    while (detail::IsSpaceByte(buffer_.Peek())) {
+      buffer_.Get();
+    }
+    if (buffer_.Peek() < 0) {
+      return false;
+    }
+
+    header_ = detail::ScanHeader(&buffer_);
+    auto const n = header_.magic_number[1];
+    if (n < '4') {
+      auto oss = std::ostringstream{};
+      oss << "unsupported magic number '" << header_.magic_number << "'";
+      throw std::runtime_error(oss.str());
+    }
+    auto const raster_size = detail::RasterSize(header_);
+    if (raster_size > std::numeric_limits<std::size_t>::max()) {
+      throw std::runtime_error("image is too large");
+    }
+    frame_.resize(static_cast<std::size_t>(raster_size));
+    auto const read_size = buffer_.Read(
+        reinterpret_cast<char*>(frame_.data()), frame_.size());
+    if (read_size != frame_.size()) {
+      auto oss = std::ostringstream{};
+      oss << "failed reading " << frame_.size() << " bytes";
+      throw std::runtime_error(oss.str());
+    }
+    ++frames_read_;
+    frame_latency_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    return true;
+  }
+
+  //! Magic number of the current frame, 'P4' to 'P7'.
+  std::string const& magic_number() const { return header_.magic_number; }
+  std::size_t width() const { return header_.width; }
+  std::size_t height() const { return header_.height; }
+
+  //! Number of samples per pixel.
+  std::size_t depth() const { return detail::HeaderDepth(header_); }
+  std::uint32_t max_value() const { return header_.max_value; }
+
+  //! PAM tuple type, empty for other formats.
+  std::string const& tuple_type() const { return header_.tuple_type; }
+
+  //! Pixel data of the current frame, valid until the next call to Next.
+  std::uint8_t const* pixel_data() const { return frame_.data(); }
+
+  //! Size in bytes of the pixel data of the current frame.
+  std::size_t frame_size() const { return frame_.size(); }
+
+  //! Number of frames read so far.
+  std::size_t frames_read() const { return frames_read_; }
+
+  //! Time taken by the last successful call to Next, including time spent
+  //! waiting for the stream.
+  std::chrono::nanoseconds frame_latency() const { return frame_latency_; }
+
+ private:
+  static std::size_t ThrowIfInvalidBufferSize(std::size_t const buffer_size) {
+    if (buffer_size == 0) {
+      throw std::invalid_argument("buffer size must be non-zero");
+    }
+    return buffer_size;
+  }
+
+  static std::unique_ptr<std::ifstream> OpenFile(std::string const& filename) {
+    auto ifs = std::unique_ptr<std::ifstream>(new std::ifstream{});
+    detail::OpenFileStream(ifs.get(), filename);
+    return ifs;
+  }
+
+  std::unique_ptr<std::ifstream> ifs_;
+  detail::StreamReadBuffer buffer_;
+  detail::Header header_;
+  UninitializedVector<std::uint8_t> frame_;
+  std::size_t frames_read_ = 0;
+  std::chrono::nanoseconds frame_latency_{0};
+};
+
+/*!
+Incremental writer for PGM (greyscale) and PPM (RGB) images.
+
+The header is written on construction, pixel data is then written one
+row or strip of rows at a time, so the full image never needs to be held
+in memory. Pixel data is laid out as described for WritePgmImage and
+WritePpmImage, one row after the other. If the max value is larger than
+255 samples are stored as two bytes, these can be written from native
+16-bit samples using the std::uint16_t overload of WriteRows. Close must
+be called once all rows have been written, it checks that exactly height
+rows were written.
+
+Example, writing an image 16 rows at a time:
+
+  auto writer = thinks::PnmWriter("my_file.ppm", thinks::PnmFormat::kPpm,
+                                  width, height);
+  for (auto row = std::size_t{0}; row < height; row += 16) {
+    // ... compute strip.
+    writer.WriteRows(strip.data(), std::min<std::size_t>(height - row, 16));
+  }
+  writer.Close();
+
+An std::invalid_argument is thrown on construction if:
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+*/
+class PnmWriter {
+ public:
+  PnmWriter(std::ostream& os, PnmFormat const format, std::size_t const width,
+            std::size_t const height, std::uint32_t const max_value = 255)
+      : os_(&os), format_(format) {
+    WriteHeader(width, height, max_value);
+  }
+
+  /*!
+  See std::ostream overload version above. The file is owned by the
+  writer and is closed by Close.
+
+  Throws an std::runtime_error if file cannot be opened.
+  */
+  PnmWriter(std::string const& filename, PnmFormat const format,
+            std::size_t const width, std::size_t const height,
+            std::uint32_t const max_value = 255)
+      : ofs_(new std::ofstream{}), format_(format) {
+    // Validate before creating the file.
+    detail::ThrowIfInvalidWidth<std::invalid_argument>(width);
+    detail::ThrowIfInvalidHeight<std::invalid_argument>(height);
+    detail::ThrowIfInvalidMaxValue<std::invalid_argument>(max_value);
+    detail::OpenFileStream(ofs_.get(), filename);
+    os_ = ofs_.get();
+    WriteHeader(width, height, max_value);
+  }
+
+  PnmFormat format() const { return format_; }
+  std::size_t width() const { return header_.width; }
+  std::size_t height() const { return header_.height; }
+  std::size_t channels() const { return detail::ChannelCount(format_); }
+  std::uint32_t max_value() const { return header_.max_value; }
+
+  //! Number of bytes used to store each sample, one or two.
+  std::size_t bytes_per_sample() const {
+    return detail::BytesPerSample(header_.max_value);
+  }
+
+  //! Number of bytes per row of pixels, as stored.
+  std::size_t row_size() const {
+    return width() * channels() * bytes_per_sample();
+  }
+
+  //! Number of rows written so far.
+  std::size_t rows_written() const { return rows_written_; }
+
+  //! Number of rows not yet written.
+  std::size_t rows_remaining() const { return height() - rows_written_; }
+
+  /*!
+  Write the next @p row_count rows from @p pixel_data, which must hold
+  row_count * row_size() bytes.
+
+  An std::invalid_argument is thrown if:
+    - more rows are written than remain in the image.
+  */
+  void WriteRows(std::uint8_t const* const pixel_data,
+                 std::size_t const row_count) {
+    assert(pixel_data != nullptr && "null pixel data");
+    ThrowIfTooManyRows(row_count);
+    detail::WritePixelData(*os_, pixel_data, row_count * row_size());
+    rows_written_ += row_count;
+  }
+
+  /*!
+  As the std::uint8_t overload, but @p pixel_data holds native 16-bit
+  samples, row_count * width() * channels() of them.
+  */
+  void WriteRows(std::uint16_t const* const pixel_data,
+                 std::size_t const row_count) {
+    assert(pixel_data != nullptr && "null pixel data");
+    ThrowIfTooManyRows(row_count);
+    detail::WriteSamples16(*os_, header_.max_value, pixel_data,
+                           row_count * width() * channels());
+    rows_written_ += row_count;
+  }
+
+  //! Write the next row from @p pixel_data, which must hold row_size() bytes.
+  void WriteRow(std::uint8_t const* const pixel_data) {
+    WriteRows(pixel_data, 1);
+  }
+
+  /*!
+  Flush the written pixel data, closing the file if the writer owns it.
+
+  An std::runtime_error is thrown if:
+    - fewer than height rows have been written.
+    - the pixel data could not be written.
+  */
+  void Close() {
+    if (rows_remaining() > 0) {
+      auto oss = std::ostringstream{};
+      oss << "image incomplete, wrote " << rows_written_ << " of "
+          << height() << " rows";
+      throw std::runtime_error(oss.str());
+    }
+    os_->flush();
+    if (ofs_) {
+      ofs_->close();
+    }
+    if (!(*os_)) {
+      throw std::runtime_error("failed writing pixel data");
+    }
+  }
+
+ private:
+  void WriteHeader(std::size_t const width, std::size_t const height,
+                   std::uint32_t const max_value) {
+    header_.magic_number = detail::MagicNumber(format_);
+    header_.width = width;
+    header_.height = height;
+    header_.max_value = max_value;
+    detail::WriteHeader(*os_, header_);
+  }
+
+  void ThrowIfTooManyRows(std::size_t const row_count) const {
+    if (row_count > rows_remaining()) {
+      auto oss = std::ostringstream{};
+      oss << "cannot write " << row_count << " rows, " << rows_remaining()
+          << " rows remaining";
+      throw std::invalid_argument(oss.str());
+    }
+  }
+
+  std::unique_ptr<std::ofstream> ofs_;
+  std::ostream* os_ = nullptr;
+  detail::Header header_;
+  PnmFormat format_;
+  std::size_t rows_written_ = 0;
+};
+
 }  // namespace thinks
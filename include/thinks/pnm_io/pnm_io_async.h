@@ -0,0 +1,281 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+
+namespace thinks {
+
+/*!
+Writes PGM (greyscale) and PPM (RGB) image files on a background thread,
+so that the caller can carry on while the file is written. Images are
+queued and written in the order they are given, pixel data is either
+copied or taken over by the writer.
+
+At most @p max_queued images wait in the queue, in addition to the one
+being written. Writing an image to a full queue blocks until the
+background thread has caught up, which bounds the memory held by the
+writer. With a max queued count of one the writer double buffers: the
+caller fills the next image while the previous one is written. Buffers
+of copied images are reused.
+
+Errors from the background thread, e.g. a file that cannot be opened,
+are rethrown by the next call to a write function or Flush, after which
+they are cleared. Images queued after a failed image are still written.
+The destructor waits for queued images to be written, errors not yet
+reported are then lost, call Flush first to see them.
+
+The writer functions must not be called concurrently from several
+threads.
+
+Example, writing an image for every step of a simulation:
+
+  thinks::AsyncPnmWriter writer;
+  for (auto step = 0; step < step_count; ++step) {
+    // ... compute pixel data.
+    writer.WritePpmImage("step_" + std::to_string(step) + ".ppm", width,
+                         height, pixel_data.data());
+  }
+  writer.Flush();
+
+An std::invalid_argument is thrown on construction if:
+  - the max queued count is zero.
+*/
+class AsyncPnmWriter {
+ public:
+  explicit AsyncPnmWriter(std::size_t const max_queued = 2)
+      : max_queued_(ThrowIfInvalidMaxQueued(max_queued)),
+        thread_(&AsyncPnmWriter::Run, this) {}
+
+  AsyncPnmWriter(AsyncPnmWriter const&) = delete;
+  AsyncPnmWriter& operator=(AsyncPnmWriter const&) = delete;
+
+  ~AsyncPnmWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    queued_.notify_one();
+    thread_.join();
+  }
+
+  std::size_t max_queued() const { return max_queued_; }
+
+  /*!
+  Queue a PGM image for writing, copying @p pixel_data, laid out as for
+  thinks::WritePgmImage. Blocks while the queue is full.
+
+  An std::invalid_argument is thrown if:
+    - width or height is zero.
+
+  An std::runtime_error is thrown if writing a previous image failed.
+  */
+  void WritePgmImage(std::string const& filename, std::size_t const width,
+                     std::size_t const height,
+                     std::uint8_t const* const pixel_data) {
+    Enqueue(filename, PnmFormat::kPgm, width, height, pixel_data);
+  }
+
+  /*!
+  As above, but takes over @p pixel_data instead of copying it. The size
+  of the pixel data must be width * height.
+  */
+  void WritePgmImage(std::string const& filename, std::size_t const width,
+                     std::size_t const height,
+                     std::vector<std::uint8_t>&& pixel_data) {
+    Enqueue(filename, PnmFormat::kPgm, width, height, std::move(pixel_data));
+  }
+
+  /*!
+  Queue a PPM image for writing, copying @p pixel_data, laid out as for
+  thinks::WritePpmImage. Blocks while the queue is full.
+
+  An std::invalid_argument is thrown if:
+    - width or height is zero.
+
+  An std::runtime_error is thrown if writing a previous image failed.
+  */
+  void WritePpmImage(std::string const& filename, std::size_t const width,
+                     std::size_t const height,
+                     std::uint8_t const* const pixel_data) {
+    Enqueue(filename, PnmFormat::kPpm, width, height, pixel_data);
+  }
+
+  /*!
+  As above, but takes over @p pixel_data instead of copying it. The size
+  of the pixel data must be width * height * 3.
+  */
+  void WritePpmImage(std::string const& filename, std::size_t const width,
+                     std::size_t const height,
+                     std::vector<std::uint8_t>&& pixel_data) {
+    Enqueue(filename, PnmFormat::kPpm, width, height, std::move(pixel_data));
+  }
+
+  /*!
+  Wait until all queued images have been written.
+
+  An std::runtime_error is thrown if writing an image failed.
+  */
+  void Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [&]() { return queue_.empty() && !busy_; });
+    ThrowIfError();
+  }
+
+ private:
+  struct Job {
+    std::string filename;
+    PnmFormat format;
+    std::size_t width;
+    std::size_t height;
+    std::vector<std::uint8_t> pixel_data;
+  };
+
+  static std::size_t ThrowIfInvalidMaxQueued(std::size_t const max_queued) {
+    if (max_queued == 0) {
+      throw std::invalid_argument("max queued must be non-zero");
+    }
+    return max_queued;
+  }
+
+  static std::size_t PixelDataSize(PnmFormat const format,
+                                   std::size_t const width,
+                                   std::size_t const height) {
+    detail::ThrowIfInvalidWidth<std::invalid_argument>(width);
+    detail::ThrowIfInvalidHeight<std::invalid_argument>(height);
+    return width * height * detail::ChannelCount(format);
+  }
+
+  void Enqueue(std::string const& filename, PnmFormat const format,
+               std::size_t const width, std::size_t const height,
+               std::uint8_t const* const pixel_data) {
+    assert(pixel_data != nullptr && "null pixel data");
+    auto const size = PixelDataSize(format, width, height);
+    auto buffer = std::vector<std::uint8_t>{};
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ThrowIfError();
+      if (!free_buffers_.empty()) {
+        buffer.swap(free_buffers_.back());
+        free_buffers_.pop_back();
+      }
+    }
+    buffer.assign(pixel_data, pixel_data + size);
+    Push(Job{filename, format, width, height, std::move(buffer)});
+  }
+
+  void Enqueue(std::string const& filename, PnmFormat const format,
+               std::size_t const width, std::size_t const height,
+               std::vector<std::uint8_t>&& pixel_data) {
+    auto const size = PixelDataSize(format, width, height);
+    if (pixel_data.size() != size) {
+      auto oss = std::ostringstream{};
+      oss << "pixel data must hold " << size << " bytes, has "
+          << pixel_data.size();
+      throw std::invalid_argument(oss.str());
+    }
+    Push(Job{filename, format, width, height, std::move(pixel_data)});
+  }
+
+  void Push(Job&& job) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ThrowIfError();
+      dequeued_.wait(lock, [&]() { return queue_.size() < max_queued_; });
+      queue_.push_back(std::move(job));
+    }
+    queued_.notify_one();
+  }
+
+  // Must be called with the mutex locked.
+  void ThrowIfError() {
+    if (error_) {
+      auto error = std::exception_ptr{};
+      std::swap(error, error_);
+      std::rethrow_exception(error);
+    }
+  }
+
+  void Run() {
+    for (;;) {
+      auto job = Job{};
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queued_.wait(lock, [&]() { return !queue_.empty() || stop_; });
+        if (queue_.empty()) {
+          return;
+        }
+        job = std::move(queue_.front());
+        queue_.pop_front();
+        busy_ = true;
+      }
+      dequeued_.notify_one();
+
+      auto error = std::exception_ptr{};
+      try {
+        // The filename overloads do not check the stream, write through a
+        // stream of our own so that short writes are reported.
+        auto ofs = std::ofstream{};
+        detail::OpenFileStream(&ofs, job.filename);
+        if (job.format == PnmFormat::kPpm) {
+          thinks::WritePpmImage(ofs, job.width, job.height,
+                                job.pixel_data.data());
+        } else {
+          thinks::WritePgmImage(ofs, job.width, job.height,
+                                job.pixel_data.data());
+        }
+        ofs.close();
+        if (!ofs) {
+          auto oss = std::ostringstream{};
+          oss << "cannot write file '" << job.filename << "'";
+          throw std::runtime_error(oss.str());
+        }
+      } catch (...) {
+        error = std::current_exception();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error && !error_) {
+          error_ = error;
+        }
+        // Keep enough buffers for a full queue.
+        if (free_buffers_.size() <= max_queued_) {
+          free_buffers_.push_back(std::move(job.pixel_data));
+        }
+        busy_ = false;
+      }
+      idle_.notify_all();
+    }
+  }
+
+  std::size_t const max_queued_;
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::condition_variable dequeued_;
+  std::condition_variable idle_;
+  std::deque<Job> queue_;
+  std::vector<std::vector<std::uint8_t>> free_buffers_;
+  std::exception_ptr error_;
+  bool busy_ = false;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+}  // namespace thinks
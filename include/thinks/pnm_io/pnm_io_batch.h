@@ -0,0 +1,635 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_file.h"
+#include "thinks/pnm_io/pnm_io_probe.h"
+
+// The io_uring backend talks to the kernel directly, without liburing, and
+// is available on Linux when the kernel headers provide io_uring. Define
+// THINKS_PNM_IO_NO_IO_URING to leave it out.
+#if defined(__linux__) && !defined(THINKS_PNM_IO_NO_IO_URING) && \
+    defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && \
+    defined(__NR_io_uring_register)
+#define THINKS_PNM_IO_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace thinks {
+
+/*!
+How LoadPnmImages reads files.
+*/
+enum class BatchBackend {
+  //! Blocking reads, one file per thread.
+  kThreadPool,
+
+  //! Overlapped reads submitted from the calling thread through io_uring.
+  //! Linux 5.6 or later, LoadPnmImages falls back to kThreadPool where
+  //! io_uring reads are not available.
+  kIoUring,
+};
+
+/*!
+Options for LoadPnmImages.
+*/
+struct BatchLoadOptions {
+  BatchBackend backend = BatchBackend::kThreadPool;
+
+  //! Maximum number of images loaded at once, i.e. the number of threads
+  //! for kThreadPool and the number of reads in flight for kIoUring. Fast
+  //! storage often benefits from more than one per core.
+  std::size_t concurrency = detail::DefaultThreadCount();
+
+  //! Maximum number of bytes of pixel data held at once, zero for no
+  //! limit. An image larger than the limit is loaded on its own. Buffers
+  //! are reused between images only when there is no limit.
+  std::uint64_t memory_limit = 0;
+};
+
+/*!
+Image passed to the LoadPnmImages callback. Pixel data is laid out as
+described for ReadPgmImage and ReadPpmImage, samples are stored as two
+bytes, most significant byte first, if the max value is larger than 255.
+*/
+struct BatchImage {
+  std::size_t index = 0;  //!< Position of the file in the batch.
+  PnmFormat format = PnmFormat::kPgm;
+  std::size_t width = 0;
+  std::size_t height = 0;
+  std::uint32_t max_value = 0;
+
+  //! Valid only during the callback.
+  std::uint8_t const* pixel_data = nullptr;
+  std::size_t pixel_data_size = 0;
+};
+
+/*!
+Summary of a completed LoadPnmImages call.
+*/
+struct BatchLoadReport {
+  BatchBackend backend = BatchBackend::kThreadPool;  //!< Backend used.
+  std::size_t image_count = 0;
+  std::uint64_t byte_count = 0;  //!< Bytes of pixel data loaded.
+  std::chrono::nanoseconds duration{0};
+
+  //! Pixel data throughput in megabytes (10^6 bytes) per second.
+  double megabytes_per_second() const {
+    auto const seconds = duration.count() * 1e-9;
+    return seconds > 0 ? byte_count * 1e-6 / seconds : 0;
+  }
+};
+
+namespace detail {
+
+// Bounds the number of bytes held by concurrent loads. A request that
+// exceeds the limit on its own is granted once nothing else is held.
+class MemoryBudget {
+ public:
+  explicit MemoryBudget(std::uint64_t const limit) : limit_(limit) {}
+
+  void Acquire(std::uint64_t const size) {
+    if (limit_ == 0) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    released_.wait(lock, [&]() { return Fits(size); });
+    used_ += size;
+  }
+
+  bool TryAcquire(std::uint64_t const size) {
+    if (limit_ == 0) {
+      return true;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!Fits(size)) {
+      return false;
+    }
+    used_ += size;
+    return true;
+  }
+
+  void Release(std::uint64_t const size) {
+    if (limit_ == 0) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      used_ -= size;
+    }
+    released_.notify_all();
+  }
+
+  std::uint64_t limit() const { return limit_; }
+
+ private:
+  bool Fits(std::uint64_t const size) const {
+    return used_ == 0 || (used_ <= limit_ && size <= limit_ - used_);
+  }
+
+  std::uint64_t const limit_;
+  std::uint64_t used_ = 0;
+  std::mutex mutex_;
+  std::condition_variable released_;
+};
+
+// Releases a reservation when going out of scope.
+class BudgetReservation {
+ public:
+  BudgetReservation(MemoryBudget* const budget, std::uint64_t const size)
+      : budget_(budget), size_(size) {
+    budget_->Acquire(size_);
+  }
+  ~BudgetReservation() { budget_->Release(size_); }
+
+  BudgetReservation(BudgetReservation const&) = delete;
+  BudgetReservation& operator=(BudgetReservation const&) = delete;
+
+ private:
+  MemoryBudget* budget_;
+  std::uint64_t size_;
+};
+
+// Pixel data buffers shared between threads, so that each image does not
+// need a fresh allocation.
+class BufferPool {
+ public:
+  explicit BufferPool(bool const enabled) : enabled_(enabled) {}
+
+  UninitializedVector<std::uint8_t> Acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto buffer = UninitializedVector<std::uint8_t>{};
+    if (!buffers_.empty()) {
+      buffer.swap(buffers_.back());
+      buffers_.pop_back();
+    }
+    return buffer;
+  }
+
+  void Release(UninitializedVector<std::uint8_t>&& buffer) {
+    if (!enabled_) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back(std::move(buffer));
+  }
+
+ private:
+  bool const enabled_;
+  std::mutex mutex_;
+  std::vector<UninitializedVector<std::uint8_t>> buffers_;
+};
+
+inline std::size_t BatchRasterSize(PnmInfo const& info) {
+  if (info.raster_size > std::numeric_limits<std::size_t>::max()) {
+    throw std::runtime_error("image is too large");
+  }
+  return static_cast<std::size_t>(info.raster_size);
+}
+
+inline BatchImage MakeBatchImage(std::size_t const index, PnmInfo const& info,
+                                 std::uint8_t const* const pixel_data) {
+  auto image = BatchImage{};
+  image.index = index;
+  image.format = FormatFromMagicNumber(info.magic_number);
+  image.width = info.width;
+  image.height = info.height;
+  image.max_value = info.max_value;
+  image.pixel_data = pixel_data;
+  image.pixel_data_size = BatchRasterSize(info);
+  return image;
+}
+
+template <typename CallbackT>
+void LoadWithThreadPool(std::vector<std::string> const& filenames,
+                        CallbackT& callback, std::size_t const concurrency,
+                        MemoryBudget* const budget,
+                        std::atomic<std::uint64_t>* const byte_count) {
+  BufferPool pool(budget->limit() == 0);
+  ParallelFor(filenames.size(), concurrency, [&](std::size_t const i) {
+    auto const file = File(filenames[i]);
+    auto const info = ProbeFile(file);
+    FormatFromMagicNumber(info.magic_number);  // Validate before reading.
+    auto const size = BatchRasterSize(info);
+
+    BudgetReservation reservation(budget, size);
+    auto buffer = pool.Acquire();
+    buffer.resize(size);
+    if (file.ReadAt(buffer.data(), size, info.raster_offset) != size) {
+      auto oss = std::ostringstream{};
+      oss << "failed reading " << size << " bytes";
+      throw std::runtime_error(oss.str());
+    }
+    callback(MakeBatchImage(i, info, buffer.data()));
+    *byte_count += size;
+    pool.Release(std::move(buffer));
+  });
+}
+
+#if defined(THINKS_PNM_IO_IO_URING)
+// Minimal io_uring instance supporting only reads, with at most as many
+// reads in flight as there are submission queue entries.
+class IoUring {
+ public:
+  explicit IoUring(unsigned const entries) {
+    auto params = io_uring_params{};
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) {
+      ThrowError("cannot set up io_uring");
+    }
+    sq_entries_ = params.sq_entries;
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    auto const single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_ring_size_ =
+          sq_ring_size_ > cq_ring_size_ ? sq_ring_size_ : cq_ring_size_;
+      cq_ring_size_ = 0;
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+
+    try {
+      sq_ring_ = Map(sq_ring_size_, IORING_OFF_SQ_RING);
+      cq_ring_ =
+          single_mmap ? sq_ring_ : Map(cq_ring_size_, IORING_OFF_CQ_RING);
+      sqes_ = static_cast<io_uring_sqe*>(Map(sqes_size_, IORING_OFF_SQES));
+    } catch (...) {
+      Close();
+      throw;
+    }
+
+    auto* const sq = static_cast<char*>(sq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    auto* const cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  }
+
+  IoUring(IoUring const&) = delete;
+  IoUring& operator=(IoUring const&) = delete;
+
+  ~IoUring() { Close(); }
+
+  unsigned entries() const { return sq_entries_; }
+
+  // True if the kernel supports IORING_OP_READ. Kernels 5.1 to 5.5 set up
+  // a ring but complete such reads with -EINVAL, they also lack the probe.
+  bool SupportsRead() const {
+    constexpr auto kOpCount = std::size_t{IORING_OP_READ} + 1;
+    alignas(io_uring_probe) unsigned char
+        buffer[sizeof(io_uring_probe) + kOpCount * sizeof(io_uring_probe_op)];
+    std::memset(buffer, 0, sizeof(buffer));
+    auto* const probe = reinterpret_cast<io_uring_probe*>(buffer);
+    if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe,
+                  static_cast<unsigned>(kOpCount)) < 0) {
+      return false;
+    }
+    return probe->last_op >= IORING_OP_READ &&
+           (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+  }
+
+  // Queue a read, the caller must not exceed entries() reads in flight.
+  void PushRead(int const fd, void* const buffer, unsigned const size,
+                std::uint64_t const offset, std::uint64_t const user_data) {
+    auto const tail = *sq_tail_;
+    auto const index = tail & sq_mask_;
+    auto& sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(buffer);
+    sqe.len = size;
+    sqe.off = offset;
+    sqe.user_data = user_data;
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++unsubmitted_;
+  }
+
+  // Submit queued reads and wait for at least @p wait_count completions.
+  void SubmitAndWait(unsigned const wait_count) {
+    for (;;) {
+      auto const submitted =
+          ::syscall(__NR_io_uring_enter, fd_, unsubmitted_, wait_count,
+                    IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (submitted >= 0) {
+        unsubmitted_ -= static_cast<unsigned>(submitted);
+        if (unsubmitted_ == 0) {
+          return;
+        }
+      } else if (errno != EINTR) {
+        ThrowError("cannot submit io_uring reads");
+      }
+    }
+  }
+
+  bool PopCompletion(std::uint64_t* const user_data, int* const result) {
+    auto const head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      return false;
+    }
+    auto const& cqe = cqes_[head & cq_mask_];
+    *user_data = cqe.user_data;
+    *result = cqe.res;
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+ private:
+  [[noreturn]] void ThrowError(char const* const what) {
+    auto oss = std::ostringstream{};
+    oss << what << ", error: '" << LastErrorMessage() << "'";
+    throw std::runtime_error(oss.str());
+  }
+
+  void* Map(std::size_t const size, off_t const offset) {
+    auto* const address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, fd_, offset);
+    if (address == MAP_FAILED) {
+      ThrowError("cannot map io_uring");
+    }
+    return address;
+  }
+
+  void Close() noexcept {
+    if (sqes_ != nullptr) {
+      ::munmap(sqes_, sqes_size_);
+      sqes_ = nullptr;
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+      ::munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = nullptr;
+    if (sq_ring_ != nullptr) {
+      ::munmap(sq_ring_, sq_ring_size_);
+      sq_ring_ = nullptr;
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  int fd_ = -1;
+  unsigned sq_entries_ = 0;
+  std::size_t sq_ring_size_ = 0;
+  std::size_t cq_ring_size_ = 0;
+  std::size_t sqes_size_ = 0;
+  void* sq_ring_ = nullptr;
+  void* cq_ring_ = nullptr;
+  io_uring_sqe* sqes_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  unsigned unsubmitted_ = 0;
+};
+
+// Headers are read with blocking reads on the calling thread, pixel data
+// is read with up to @p concurrency overlapped reads, which must not
+// exceed ring->entries(). The callback is invoked on the calling thread.
+template <typename CallbackT>
+void LoadWithIoUring(IoUring* const ring,
+                     std::vector<std::string> const& filenames,
+                     CallbackT& callback, std::size_t const concurrency,
+                     MemoryBudget* const budget,
+                     std::atomic<std::uint64_t>* const byte_count) {
+  struct Slot {
+    std::unique_ptr<File> file;
+    PnmInfo info;
+    std::size_t index = 0;
+    std::size_t read_size = 0;
+    UninitializedVector<std::uint8_t> buffer;
+  };
+
+  // Reads larger than this are split, the kernel takes 32-bit lengths.
+  constexpr auto kMaxReadSize = std::size_t{1} << 30;
+
+  // The kernel rounds the ring size up to a power of two, use the
+  // requested number of reads in flight rather than ring->entries().
+  assert(concurrency <= ring->entries() && "too many reads in flight");
+  auto slots = std::vector<Slot>(concurrency);
+  auto free_slots = std::vector<std::size_t>{};
+  for (auto i = slots.size(); i > 0; --i) {
+    free_slots.push_back(i - 1);
+  }
+  auto in_flight = std::size_t{0};
+  auto const push_read = [&](std::size_t const s) {
+    auto& slot = slots[s];
+    auto const remaining = slot.buffer.size() - slot.read_size;
+    ring->PushRead(slot.file->native_handle(),
+                   slot.buffer.data() + slot.read_size,
+                   static_cast<unsigned>(remaining < kMaxReadSize
+                                             ? remaining
+                                             : kMaxReadSize),
+                   slot.info.raster_offset + slot.read_size, s);
+    ++in_flight;
+  };
+
+  try {
+    // A prepared slot, whose header has been read, waits here until enough
+    // memory is released.
+    constexpr auto kNoSlot = std::numeric_limits<std::size_t>::max();
+    auto pending = kNoSlot;
+    auto next = std::size_t{0};
+    for (;;) {
+      for (;;) {
+        if (pending == kNoSlot) {
+          if (free_slots.empty() || next == filenames.size()) {
+            break;
+          }
+          pending = free_slots.back();
+          free_slots.pop_back();
+          auto& slot = slots[pending];
+          slot.file.reset(new File(filenames[next]));
+          slot.info = ProbeFile(*slot.file);
+          FormatFromMagicNumber(slot.info.magic_number);
+          slot.index = next++;
+        }
+        auto& slot = slots[pending];
+        auto const size = BatchRasterSize(slot.info);
+        if (!budget->TryAcquire(size)) {
+          break;
+        }
+        slot.read_size = 0;
+        slot.buffer.resize(size);
+        push_read(pending);
+        pending = kNoSlot;
+      }
+      if (in_flight == 0) {
+        break;
+      }
+
+      ring->SubmitAndWait(1);
+      auto user_data = std::uint64_t{0};
+      auto result = 0;
+      while (ring->PopCompletion(&user_data, &result)) {
+        --in_flight;
+        auto const s = static_cast<std::size_t>(user_data);
+        auto& slot = slots[s];
+        if (result < 0) {
+          errno = -result;
+          ThrowLastError<std::runtime_error>("cannot read file",
+                                             slot.file->filename());
+        }
+        if (result == 0) {
+          auto oss = std::ostringstream{};
+          oss << "failed reading " << slot.buffer.size() << " bytes";
+          throw std::runtime_error(oss.str());
+        }
+        slot.read_size += static_cast<std::size_t>(result);
+        if (slot.read_size < slot.buffer.size()) {
+          push_read(s);  // Short read, continue where it ended.
+          continue;
+        }
+
+        callback(MakeBatchImage(slot.index, slot.info, slot.buffer.data()));
+        *byte_count += slot.buffer.size();
+        budget->Release(slot.buffer.size());
+        slot.file.reset();
+        if (budget->limit() != 0) {
+          UninitializedVector<std::uint8_t>{}.swap(slot.buffer);
+        }
+        free_slots.push_back(s);
+      }
+    }
+  } catch (...) {
+    // The kernel may still write to the buffers of reads in flight, wait
+    // for them before the buffers go away.
+    auto user_data = std::uint64_t{0};
+    auto result = 0;
+    while (in_flight > 0) {
+      ring->SubmitAndWait(1);
+      while (ring->PopCompletion(&user_data, &result)) {
+        --in_flight;
+      }
+    }
+    throw;
+  }
+}
+
+// Returns null if io_uring is not available or cannot read, e.g. on
+// older kernels or when blocked by a sandbox.
+inline std::unique_ptr<IoUring> TryCreateIoUring(unsigned const entries) {
+  auto ring = std::unique_ptr<IoUring>{};
+  try {
+    ring.reset(new IoUring(entries));
+  } catch (std::runtime_error const&) {
+    return nullptr;
+  }
+  if (!ring->SupportsRead()) {
+    return nullptr;
+  }
+  return ring;
+}
+#endif  // defined(THINKS_PNM_IO_IO_URING)
+
+}  // namespace detail
+
+/*!
+Load the PGM (greyscale) and PPM (RGB) images in @p filenames
+concurrently, invoking @p callback for each image as
+
+  callback(image)
+
+where @p image is a BatchImage whose pixel data is only valid during the
+callback. Images are passed to the callback in the order they finish
+loading, use BatchImage::index to tell them apart. With the kThreadPool
+backend the callback is invoked concurrently from several threads, with
+kIoUring it is invoked on the calling thread.
+
+If loading an image or the callback throws, no further images are started
+and the first exception is rethrown once all loads in progress are done.
+
+Example, loading a list of files with 16 reads in flight:
+
+  auto options = thinks::BatchLoadOptions{};
+  options.backend = thinks::BatchBackend::kIoUring;
+  options.concurrency = 16;
+  auto const report = thinks::LoadPnmImages(
+      filenames, [](thinks::BatchImage const& image) { ... }, options);
+  std::cout << report.megabytes_per_second() << " MB/s\n";
+
+An std::invalid_argument is thrown if:
+  - concurrency is zero.
+
+An std::runtime_error is thrown if:
+  - a file cannot be opened or read.
+  - a header is invalid, see ReadPgmImage.
+  - a magic number is not 'P5' or 'P6'.
+  - a file is too small to hold its pixel data.
+*/
+template <typename CallbackT>
+BatchLoadReport LoadPnmImages(
+    std::vector<std::string> const& filenames, CallbackT callback,
+    BatchLoadOptions const& options = BatchLoadOptions{}) {
+  if (options.concurrency == 0) {
+    throw std::invalid_argument("concurrency must be non-zero");
+  }
+
+  auto const start = std::chrono::steady_clock::now();
+  detail::MemoryBudget budget(options.memory_limit);
+  std::atomic<std::uint64_t> byte_count(0);
+  auto report = BatchLoadReport{};
+#if defined(THINKS_PNM_IO_IO_URING)
+  if (options.backend == BatchBackend::kIoUring && !filenames.empty()) {
+    constexpr auto kMaxEntries = std::size_t{4096};
+    auto entries = options.concurrency < filenames.size()
+                       ? options.concurrency
+                       : filenames.size();
+    entries = entries < kMaxEntries ? entries : kMaxEntries;
+    auto const ring =
+        detail::TryCreateIoUring(static_cast<unsigned>(entries));
+    if (ring) {
+      report.backend = BatchBackend::kIoUring;
+      detail::LoadWithIoUring(ring.get(), filenames, callback, entries,
+                              &budget, &byte_count);
+    }
+  }
+#endif
+  if (report.backend == BatchBackend::kThreadPool) {
+    detail::LoadWithThreadPool(filenames, callback, options.concurrency,
+                               &budget, &byte_count);
+  }
+
+  report.image_count = filenames.size();
+  report.byte_count = byte_count;
+  report.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+  return report;
+}
+
+}  // namespace thinks
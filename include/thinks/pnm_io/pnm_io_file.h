@@ -0,0 +1,414 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "thinks/pnm_io/pnm_io.h"
+
+namespace thinks {
+namespace detail {
+
+#if defined(_WIN32)
+inline std::string LastErrorMessage() {
+  auto const error_code = ::GetLastError();
+  char* buffer = nullptr;
+  auto const length = ::FormatMessageA(
+      FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
+          FORMAT_MESSAGE_IGNORE_INSERTS,
+      nullptr, error_code, 0, reinterpret_cast<LPSTR>(&buffer), 0, nullptr);
+  auto message = std::string(buffer, length);
+  ::LocalFree(buffer);
+  while (!message.empty() &&
+         (message.back() == '\n' || message.back() == '\r')) {
+    message.pop_back();
+  }
+  return message;
+}
+#else
+inline std::string LastErrorMessage() { return ErrorMessage(errno); }
+#endif
+
+template <typename ExceptionT>
+[[noreturn]] void ThrowLastError(std::string const& what,
+                                 std::string const& filename) {
+  auto oss = std::ostringstream{};
+  oss << what << " '" << filename << "', "
+      << "error: '" << LastErrorMessage() << "'";
+  throw ExceptionT(oss.str());
+}
+
+// Hints on how a range of a file will be accessed, see File::Advise.
+enum class FileAdvice {
+  kSequential,
+  kWillNeed,
+  kDontNeed,
+};
+
+// RAII wrapper around a native (unbuffered) read-only file handle.
+class File {
+ public:
+#if defined(_WIN32)
+  using NativeHandle = HANDLE;
+#else
+  using NativeHandle = int;
+#endif
+
+  // If @p direct_io is true the file is opened with O_DIRECT, bypassing the
+  // page cache, where the platform and file system support it. Reads must
+  // then use offsets, sizes and buffers aligned to kDirectIoAlignment, use
+  // direct_io() to check whether the flag took effect.
+  explicit File(std::string const& filename, bool const direct_io = false)
+      : filename_(filename) {
+#if defined(_WIN32)
+    static_cast<void>(direct_io);
+    handle_ = ::CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+    if (handle_ == InvalidHandle()) {
+      ThrowLastError<std::runtime_error>("cannot open file", filename);
+    }
+#else
+#if defined(O_DIRECT)
+    if (direct_io) {
+      do {
+        handle_ = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+      } while (handle_ == InvalidHandle() && errno == EINTR);
+      // File systems without direct I/O support, e.g. tmpfs, fail with
+      // EINVAL, fall back to buffered reads.
+      direct_io_ = handle_ != InvalidHandle();
+    }
+#else
+    static_cast<void>(direct_io);
+#endif
+    while (handle_ == InvalidHandle()) {
+      handle_ = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+      if (handle_ != InvalidHandle() || errno != EINTR) {
+        break;
+      }
+    }
+    if (handle_ == InvalidHandle()) {
+      ThrowLastError<std::runtime_error>("cannot open file", filename);
+    }
+#endif
+  }
+
+  File(File&& other) noexcept
+      : filename_(std::move(other.filename_)),
+        handle_(other.handle_),
+        direct_io_(other.direct_io_) {
+    other.handle_ = InvalidHandle();
+  }
+
+  File& operator=(File&& other) noexcept {
+    if (this != &other) {
+      Close();
+      filename_ = std::move(other.filename_);
+      handle_ = other.handle_;
+      direct_io_ = other.direct_io_;
+      other.handle_ = InvalidHandle();
+    }
+    return *this;
+  }
+
+  File(File const&) = delete;
+  File& operator=(File const&) = delete;
+
+  ~File() { Close(); }
+
+  NativeHandle native_handle() const { return handle_; }
+  std::string const& filename() const { return filename_; }
+
+  // True if the file was opened for direct I/O.
+  bool direct_io() const { return direct_io_; }
+
+  // Alignment of offsets, sizes and buffers for direct I/O, large enough
+  // for the logical block size of common devices.
+  static constexpr std::size_t kDirectIoAlignment = 4096;
+
+  // Pass an access hint for @p size bytes starting at @p offset to the
+  // operating system (posix_fadvise), a size of zero means to the end of
+  // the file. Hints never change what is read and are ignored on
+  // platforms that do not support them.
+  void Advise(FileAdvice const advice, std::uint64_t const offset,
+              std::uint64_t const size) const {
+#if defined(POSIX_FADV_SEQUENTIAL)
+    auto native_advice = POSIX_FADV_NORMAL;
+    switch (advice) {
+      case FileAdvice::kSequential:
+        native_advice = POSIX_FADV_SEQUENTIAL;
+        break;
+      case FileAdvice::kWillNeed:
+        native_advice = POSIX_FADV_WILLNEED;
+        break;
+      case FileAdvice::kDontNeed:
+        native_advice = POSIX_FADV_DONTNEED;
+        break;
+    }
+    ::posix_fadvise(handle_, static_cast<off_t>(offset),
+                    static_cast<off_t>(size), native_advice);
+#else
+    static_cast<void>(advice);
+    static_cast<void>(offset);
+    static_cast<void>(size);
+#endif
+  }
+
+  std::uint64_t Size() const {
+#if defined(_WIN32)
+    auto size = LARGE_INTEGER{};
+    if (!::GetFileSizeEx(handle_, &size)) {
+      ThrowLastError<std::runtime_error>("cannot get size of file", filename_);
+    }
+    return static_cast<std::uint64_t>(size.QuadPart);
+#else
+    struct stat st;
+    if (::fstat(handle_, &st) != 0) {
+      ThrowLastError<std::runtime_error>("cannot get size of file", filename_);
+    }
+    return static_cast<std::uint64_t>(st.st_size);
+#endif
+  }
+
+  // Read up to @p size bytes starting at @p offset into @p buffer, without
+  // moving the file position. Returns the number of bytes read, which is
+  // less than @p size only if the end of the file is reached.
+  std::size_t ReadAt(void* const buffer, std::size_t const size,
+                     std::uint64_t const offset) const {
+    auto* const bytes = static_cast<char*>(buffer);
+    auto total = std::size_t{0};
+    while (total < size) {
+      auto const position = offset + total;
+#if defined(_WIN32)
+      constexpr auto max_chunk = std::size_t{1} << 30;
+      auto const chunk = size - total < max_chunk ? size - total : max_chunk;
+      auto overlapped = OVERLAPPED{};
+      overlapped.Offset = static_cast<DWORD>(position & 0xffffffffu);
+      overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+      auto read = DWORD{0};
+      if (!::ReadFile(handle_, bytes + total, static_cast<DWORD>(chunk), &read,
+                      &overlapped)) {
+        if (::GetLastError() == ERROR_HANDLE_EOF) {
+          break;
+        }
+        ThrowLastError<std::runtime_error>("cannot read file", filename_);
+      }
+#else
+      auto const read = ::pread(handle_, bytes + total, size - total,
+                                static_cast<off_t>(position));
+      if (read < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        ThrowLastError<std::runtime_error>("cannot read file", filename_);
+      }
+#endif
+      if (read == 0) {
+        break;
+      }
+      total += static_cast<std::size_t>(read);
+    }
+    return total;
+  }
+
+ private:
+  static NativeHandle InvalidHandle() {
+#if defined(_WIN32)
+    return INVALID_HANDLE_VALUE;
+#else
+    return -1;
+#endif
+  }
+
+  void Close() noexcept {
+    if (handle_ != InvalidHandle()) {
+#if defined(_WIN32)
+      ::CloseHandle(handle_);
+#else
+      ::close(handle_);
+#endif
+      handle_ = InvalidHandle();
+    }
+  }
+
+  std::string filename_;
+  NativeHandle handle_ = InvalidHandle();
+  bool direct_io_ = false;
+};
+
+// A range of bytes to be written, see OutputFile::WriteGather.
+struct ByteRange {
+  void const* data;
+  std::size_t size;
+};
+
+// RAII wrapper around a native (unbuffered) file handle opened for
+// writing. The file is created, or truncated if it exists.
+class OutputFile {
+ public:
+#if defined(_WIN32)
+  using NativeHandle = HANDLE;
+#else
+  using NativeHandle = int;
+#endif
+
+  explicit OutputFile(std::string const& filename) : filename_(filename) {
+#if defined(_WIN32)
+    handle_ = ::CreateFileA(filename.c_str(), GENERIC_WRITE, 0, nullptr,
+                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle_ == InvalidHandle()) {
+      ThrowLastError<std::runtime_error>("cannot open file", filename);
+    }
+#else
+    while (handle_ == InvalidHandle()) {
+      handle_ = ::open(filename.c_str(),
+                       O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+      if (handle_ != InvalidHandle() || errno != EINTR) {
+        break;
+      }
+    }
+    if (handle_ == InvalidHandle()) {
+      ThrowLastError<std::runtime_error>("cannot open file", filename);
+    }
+#endif
+  }
+
+  OutputFile(OutputFile&& other) noexcept
+      : filename_(std::move(other.filename_)), handle_(other.handle_) {
+    other.handle_ = InvalidHandle();
+  }
+
+  OutputFile& operator=(OutputFile&&) = delete;
+  OutputFile(OutputFile const&) = delete;
+  OutputFile& operator=(OutputFile const&) = delete;
+
+  // Errors are not reported when closing on destruction, call Close to
+  // check them.
+  ~OutputFile() {
+    if (handle_ != InvalidHandle()) {
+#if defined(_WIN32)
+      ::CloseHandle(handle_);
+#else
+      ::close(handle_);
+#endif
+    }
+  }
+
+  // Write @p count byte ranges in order with as few system calls as
+  // possible: a single writev unless there are more than IOV_MAX ranges or
+  // the kernel accepts only part of the data.
+  void WriteGather(ByteRange const* const ranges, std::size_t const count) {
+#if defined(_WIN32)
+    for (auto i = std::size_t{0}; i < count; ++i) {
+      auto const* bytes = static_cast<char const*>(ranges[i].data);
+      auto remaining = ranges[i].size;
+      while (remaining > 0) {
+        constexpr auto max_chunk = std::size_t{1} << 30;
+        auto const chunk = remaining < max_chunk ? remaining : max_chunk;
+        auto written = DWORD{0};
+        if (!::WriteFile(handle_, bytes, static_cast<DWORD>(chunk), &written,
+                         nullptr)) {
+          ThrowLastError<std::runtime_error>("cannot write file", filename_);
+        }
+        bytes += written;
+        remaining -= written;
+      }
+    }
+#else
+#if defined(IOV_MAX)
+    constexpr auto max_iov = std::size_t{IOV_MAX};
+#else
+    constexpr auto max_iov = std::size_t{16};
+#endif
+    iovec iov[max_iov < 1024 ? max_iov : 1024];
+    constexpr auto iov_capacity = sizeof(iov) / sizeof(iov[0]);
+    auto next = std::size_t{0};
+    auto offset = std::size_t{0};  // Bytes of ranges[next] already written.
+    while (next < count) {
+      auto iov_count = std::size_t{0};
+      for (auto i = next; i < count && iov_count < iov_capacity; ++i) {
+        auto const skip = i == next ? offset : 0;
+        iov[iov_count].iov_base = const_cast<char*>(
+            static_cast<char const*>(ranges[i].data) + skip);
+        iov[iov_count].iov_len = ranges[i].size - skip;
+        ++iov_count;
+      }
+      auto const written =
+          ::writev(handle_, iov, static_cast<int>(iov_count));
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        ThrowLastError<std::runtime_error>("cannot write file", filename_);
+      }
+
+      // Skip past the ranges that were written completely.
+      auto remaining = static_cast<std::size_t>(written);
+      while (next < count && remaining >= ranges[next].size - offset) {
+        remaining -= ranges[next].size - offset;
+        offset = 0;
+        ++next;
+      }
+      offset += remaining;
+    }
+#endif
+  }
+
+  // Close the file, throwing if data could not be written.
+  void Close() {
+    if (handle_ == InvalidHandle()) {
+      return;
+    }
+    auto const handle = handle_;
+    handle_ = InvalidHandle();
+#if defined(_WIN32)
+    if (!::CloseHandle(handle)) {
+      ThrowLastError<std::runtime_error>("cannot close file", filename_);
+    }
+#else
+    if (::close(handle) != 0 && errno != EINTR) {
+      ThrowLastError<std::runtime_error>("cannot close file", filename_);
+    }
+#endif
+  }
+
+ private:
+  static NativeHandle InvalidHandle() {
+#if defined(_WIN32)
+    return INVALID_HANDLE_VALUE;
+#else
+    return -1;
+#endif
+  }
+
+  std::string filename_;
+  NativeHandle handle_ = InvalidHandle();
+};
+
+}  // namespace detail
+}  // namespace thinks
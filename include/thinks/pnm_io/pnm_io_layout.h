@@ -0,0 +1,410 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_simd.h"
+
+namespace thinks {
+
+/*!
+Pixel layout of the pixel data returned by the ReadPgmImage and
+ReadPpmImage overloads taking a layout. Conversion happens while the
+pixel data is read, one cache-sized block at a time, so the stored pixel
+data is never held in memory in full.
+*/
+enum class PixelLayout {
+  //! As stored, i.e. one sample per pixel for PGM and RGB triplets for PPM.
+  kStored,
+
+  //! All red samples, then all green samples, then all blue samples, each
+  //! plane in row major order. PPM only.
+  kPlanar,
+
+  //! One sample per pixel. RGB is converted to luma with the ITU-R BT.601
+  //! weights 0.299, 0.587 and 0.114.
+  kGrey,
+
+  //! RGB triplets, greyscale samples are replicated.
+  kRgb,
+
+  //! RGBA quadruplets with alpha set to the max value (1 for normalized
+  //! floats). Also serves as RGBX, e.g. for 32-bit aligned pixel access.
+  kRgba,
+};
+
+namespace detail {
+
+inline std::size_t LayoutChannelCount(PixelLayout const layout,
+                                      std::size_t const stored_channel_count) {
+  switch (layout) {
+    case PixelLayout::kPlanar:
+    case PixelLayout::kRgb:
+      return 3;
+    case PixelLayout::kGrey:
+      return 1;
+    case PixelLayout::kRgba:
+      return 4;
+    case PixelLayout::kStored:
+      break;
+  }
+  return stored_channel_count;
+}
+
+template <typename ExceptionT>
+void ThrowIfInvalidLayout(PixelLayout const layout,
+                          std::size_t const stored_channel_count) {
+  if (layout == PixelLayout::kPlanar && stored_channel_count != 3) {
+    throw ExceptionT("planar layout requires RGB pixel data");
+  }
+}
+
+// Convert @p count pixels with @p channel_count interleaved samples each,
+// the pixels starting at @p first in an image of @p pixel_count pixels, to
+// @p layout in @p dst, which holds the whole image.
+template <typename T>
+void ConvertLayout(T const* const src, std::size_t const channel_count,
+                   PixelLayout const layout, std::size_t const first,
+                   std::size_t const count, std::size_t const pixel_count,
+                   T const alpha, T* const dst) {
+  if (channel_count == 3) {
+    switch (layout) {
+      case PixelLayout::kPlanar:
+        RgbToPlanar(src, dst + first, dst + pixel_count + first,
+                    dst + 2 * pixel_count + first, count);
+        return;
+      case PixelLayout::kGrey:
+        RgbToLuma(src, dst + first, count);
+        return;
+      case PixelLayout::kRgba:
+        RgbToRgba(src, dst + 4 * first, count, alpha);
+        return;
+      case PixelLayout::kRgb:
+      case PixelLayout::kStored:
+        break;
+    }
+  } else {
+    switch (layout) {
+      case PixelLayout::kRgb:
+        GreyToRgb(src, dst + 3 * first, count);
+        return;
+      case PixelLayout::kRgba:
+        GreyToRgba(src, dst + 4 * first, count, alpha);
+        return;
+      case PixelLayout::kPlanar:
+      case PixelLayout::kGrey:
+      case PixelLayout::kStored:
+        break;
+    }
+  }
+  std::copy(src, src + count * channel_count, dst + first * channel_count);
+}
+
+inline bool IsStoredLayout(PixelLayout const layout,
+                           std::size_t const stored_channel_count) {
+  return LayoutChannelCount(layout, stored_channel_count) ==
+             stored_channel_count &&
+         layout != PixelLayout::kPlanar;
+}
+
+// Read @p pixel_count pixels with @p channel_count samples each and
+// convert them to @p layout in @p pixel_data. A block of pixels is read
+// into a staging buffer that stays in cache and converted straight into
+// the destination.
+inline void ReadPixelDataLayout(std::istream& is,
+                                std::size_t const channel_count,
+                                PixelLayout const layout,
+                                std::uint8_t const alpha,
+                                std::size_t const pixel_count,
+                                std::uint8_t* const pixel_data) {
+  std::uint8_t block[3 * kSampleBlockSize];
+  for (auto i = std::size_t{0}; i < pixel_count; i += kSampleBlockSize) {
+    auto const n = pixel_count - i < kSampleBlockSize ? pixel_count - i
+                                                      : kSampleBlockSize;
+    ReadPixelData(is, block, n * channel_count);
+    ConvertLayout(block, channel_count, layout, i, n, pixel_count, alpha,
+                  pixel_data);
+  }
+}
+
+template <typename AllocatorT>
+void ReadImageLayout(std::istream& is, PnmFormat const format,
+                     std::size_t* const width, std::size_t* const height,
+                     std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                     PixelLayout const layout,
+                     std::uint32_t* const max_value) {
+  auto const channel_count = ChannelCount(format);
+  ThrowIfInvalidLayout<std::invalid_argument>(layout, channel_count);
+  auto timer = PhaseTimer(false);
+  auto const header = ReadImageHeader<std::uint8_t>(
+      is, MagicNumber(format), width, height, max_value);
+  timer.Mark(IoPhase::kHeader);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  auto const pixel_count = header.width * header.height;
+  pixel_data->resize(pixel_count * LayoutChannelCount(layout, channel_count));
+  timer.Mark(IoPhase::kAllocate, pixel_data->size());
+  if (IsStoredLayout(layout, channel_count)) {
+    ReadPixelData(is, pixel_data->data(), pixel_data->size());
+    timer.Mark(IoPhase::kRaster, pixel_data->size());
+    return;
+  }
+  ReadPixelDataLayout(is, channel_count, layout,
+                      static_cast<std::uint8_t>(header.max_value),
+                      pixel_count, pixel_data->data());
+  timer.Mark(IoPhase::kRaster, pixel_count * channel_count);
+}
+
+template <typename AllocatorT>
+void ReadImageLayout(std::istream& is, PnmFormat const format,
+                     std::size_t* const width, std::size_t* const height,
+                     std::vector<float, AllocatorT>* const pixel_data,
+                     PixelLayout const layout,
+                     std::uint32_t* const max_value) {
+  auto const channel_count = ChannelCount(format);
+  ThrowIfInvalidLayout<std::invalid_argument>(layout, channel_count);
+  auto timer = PhaseTimer(false);
+  auto const header = ReadImageHeader<std::uint16_t>(
+      is, MagicNumber(format), width, height, max_value);
+  timer.Mark(IoPhase::kHeader);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  auto const pixel_count = header.width * header.height;
+  pixel_data->resize(pixel_count * LayoutChannelCount(layout, channel_count));
+  timer.Mark(IoPhase::kAllocate, pixel_data->size() * sizeof(float));
+  auto const stored = IsStoredLayout(layout, channel_count);
+  auto const bytes_per_sample = BytesPerSample(header.max_value);
+  auto const scale = 1.F / header.max_value;
+
+  // Samples are widened to floats in cache-sized blocks, which are then
+  // converted to the layout unless it is as stored.
+  constexpr auto kBlockPixels = kSampleBlockSize / 4;
+  std::uint8_t bytes[3 * 2 * kBlockPixels];
+  std::uint16_t words[3 * kBlockPixels];
+  float floats[3 * kBlockPixels];
+  for (auto i = std::size_t{0}; i < pixel_count; i += kBlockPixels) {
+    auto const n =
+        pixel_count - i < kBlockPixels ? pixel_count - i : kBlockPixels;
+    auto const sample_count = n * channel_count;
+    auto* const dst =
+        stored ? pixel_data->data() + i * channel_count : floats;
+    ReadPixelData(is, bytes, sample_count * bytes_per_sample);
+    if (bytes_per_sample == 2) {
+      LoadBigEndian16(bytes, words, sample_count);
+      ToFloat(words, dst, sample_count, scale);
+    } else {
+      ToFloat(bytes, dst, sample_count, scale);
+    }
+    if (!stored) {
+      ConvertLayout(floats, channel_count, layout, i, n, pixel_count, 1.F,
+                    pixel_data->data());
+    }
+  }
+  timer.Mark(IoPhase::kRaster, pixel_count * channel_count * bytes_per_sample);
+}
+
+}  // namespace detail
+
+/*!
+Read a PGM (greyscale) image from an input stream, converting the pixel
+data to @p layout while it is read. Only 8-bit images are supported, see
+the float overload for images with larger max values.
+
+Useful layouts are PixelLayout::kRgb and PixelLayout::kRgba, which
+replicate the greyscale samples. The alpha value is the max value of the
+image.
+
+An std::invalid_argument is thrown if:
+  - the layout is PixelLayout::kPlanar.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P5'.
+  - width or height is zero.
+  - the max value is not in the range [1, 255].
+  - the pixel data cannot be read.
+*/
+template <typename AllocatorT>
+void ReadPgmImage(std::istream& is, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                  PixelLayout const layout,
+                  std::uint32_t* const max_value = nullptr) {
+  detail::ReadImageLayout(is, PnmFormat::kPgm, width, height, pixel_data,
+                          layout, max_value);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+template <typename AllocatorT>
+void ReadPgmImage(std::string const& filename, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                  PixelLayout const layout,
+                  std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPgmImage(ifs, width, height, pixel_data, layout, max_value);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Read a PGM (greyscale) image from an input stream as floats in the range
+[0, 1], i.e. samples are divided by the max value of the image, in the
+given layout. Images with max values up to 65535 are supported.
+
+An std::invalid_argument is thrown if:
+  - the layout is PixelLayout::kPlanar.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P5'.
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+  - the pixel data cannot be read.
+*/
+template <typename AllocatorT>
+void ReadPgmImage(std::istream& is, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<float, AllocatorT>* const pixel_data,
+                  PixelLayout const layout = PixelLayout::kStored,
+                  std::uint32_t* const max_value = nullptr) {
+  detail::ReadImageLayout(is, PnmFormat::kPgm, width, height, pixel_data,
+                          layout, max_value);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+template <typename AllocatorT>
+void ReadPgmImage(std::string const& filename, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<float, AllocatorT>* const pixel_data,
+                  PixelLayout const layout = PixelLayout::kStored,
+                  std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPgmImage(ifs, width, height, pixel_data, layout, max_value);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Read a PPM (RGB) image from an input stream, converting the pixel data to
+@p layout while it is read. Only 8-bit images are supported, see the
+float overload for images with larger max values.
+
+For instance, PixelLayout::kPlanar gives separate red, green and blue
+planes, PixelLayout::kGrey gives luma and PixelLayout::kRgba pads each
+pixel to four bytes with an alpha value equal to the max value.
+
+Example, reading an image into planes for a neural network:
+
+  auto pixel_data = std::vector<std::uint8_t>{};
+  thinks::ReadPpmImage("image.ppm", &width, &height, &pixel_data,
+                       thinks::PixelLayout::kPlanar);
+  auto const* const red = pixel_data.data();
+  auto const* const green = red + width * height;
+  auto const* const blue = green + width * height;
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P6'.
+  - width or height is zero.
+  - the max value is not in the range [1, 255].
+  - the pixel data cannot be read.
+*/
+template <typename AllocatorT>
+void ReadPpmImage(std::istream& is, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                  PixelLayout const layout,
+                  std::uint32_t* const max_value = nullptr) {
+  detail::ReadImageLayout(is, PnmFormat::kPpm, width, height, pixel_data,
+                          layout, max_value);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+template <typename AllocatorT>
+void ReadPpmImage(std::string const& filename, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                  PixelLayout const layout,
+                  std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPpmImage(ifs, width, height, pixel_data, layout, max_value);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Read a PPM (RGB) image from an input stream as floats in the range
+[0, 1], i.e. samples are divided by the max value of the image, in the
+given layout. Images with max values up to 65535 are supported.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P6'.
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+  - the pixel data cannot be read.
+*/
+template <typename AllocatorT>
+void ReadPpmImage(std::istream& is, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<float, AllocatorT>* const pixel_data,
+                  PixelLayout const layout = PixelLayout::kStored,
+                  std::uint32_t* const max_value = nullptr) {
+  detail::ReadImageLayout(is, PnmFormat::kPpm, width, height, pixel_data,
+                          layout, max_value);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+template <typename AllocatorT>
+void ReadPpmImage(std::string const& filename, std::size_t* const width,
+                  std::size_t* const height,
+                  std::vector<float, AllocatorT>* const pixel_data,
+                  PixelLayout const layout = PixelLayout::kStored,
+                  std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPpmImage(ifs, width, height, pixel_data, layout, max_value);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+}  // namespace thinks
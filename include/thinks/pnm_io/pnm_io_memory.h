@@ -0,0 +1,410 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_simd.h"
+
+namespace thinks {
+
+namespace detail {
+
+// Number of decimal digits of @p value.
+inline std::size_t DecimalSize(std::uint64_t value) {
+  auto size = std::size_t{1};
+  while (value >= 10) {
+    value /= 10;
+    ++size;
+  }
+  return size;
+}
+
+// Store @p value as decimal digits followed by a newline, the same bytes
+// that WriteHeader streams. Returns the end of the stored bytes.
+inline std::uint8_t* StoreHeaderValue(std::uint64_t value,
+                                      std::uint8_t* const dst) {
+  auto const size = DecimalSize(value);
+  for (auto i = size; i > 0; --i) {
+    dst[i - 1] = static_cast<std::uint8_t>('0' + value % 10);
+    value /= 10;
+  }
+  dst[size] = '\n';
+  return dst + size + 1;
+}
+
+// Size in bytes of a binary PGM or PPM header, at most kMaxHeaderSize.
+inline std::size_t EncodedHeaderSize(std::size_t const width,
+                                     std::size_t const height,
+                                     std::uint32_t const max_value) {
+  return 3 + DecimalSize(width) + 1 + DecimalSize(height) + 1 +
+         DecimalSize(max_value) + 1;
+}
+
+constexpr std::size_t kMaxHeaderSize = 3 + 3 * 21;
+
+// Store a binary PGM or PPM header, returning the end of the stored bytes.
+inline std::uint8_t* StoreHeader(char const* const magic_number,
+                                 std::size_t const width,
+                                 std::size_t const height,
+                                 std::uint32_t const max_value,
+                                 std::uint8_t* dst) {
+  *dst++ = static_cast<std::uint8_t>(magic_number[0]);
+  *dst++ = static_cast<std::uint8_t>(magic_number[1]);
+  *dst++ = '\n';
+  dst = StoreHeaderValue(width, dst);
+  dst = StoreHeaderValue(height, dst);
+  return StoreHeaderValue(max_value, dst);
+}
+
+// Size in bytes of a binary PGM or PPM image as written by the stream
+// functions, header included.
+inline std::size_t EncodedImageSize(std::size_t const channels,
+                                    std::size_t const width,
+                                    std::size_t const height,
+                                    std::uint32_t const max_value) {
+  ThrowIfInvalidWidth<std::invalid_argument>(width);
+  ThrowIfInvalidHeight<std::invalid_argument>(height);
+  ThrowIfInvalidMaxValue<std::invalid_argument>(max_value);
+  return EncodedHeaderSize(width, height, max_value) +
+         width * height * channels * BytesPerSample(max_value);
+}
+
+inline void StoreSamples(std::uint8_t const* const pixel_data,
+                         std::uint32_t const /*max_value*/,
+                         std::uint8_t* const dst, std::size_t const count) {
+  std::memcpy(dst, pixel_data, count);
+}
+
+inline void StoreSamples(std::uint16_t const* const pixel_data,
+                         std::uint32_t const max_value,
+                         std::uint8_t* const dst, std::size_t const count) {
+  if (BytesPerSample(max_value) == 2) {
+    StoreBigEndian16(pixel_data, dst, count);
+  } else {
+    Narrow16To8(pixel_data, dst, count);
+  }
+}
+
+// Encode an image into @p buffer, which has room for @p capacity bytes.
+// The header is formatted in place and the samples are stored right
+// after it, so each byte of the output is written exactly once. Returns
+// the number of bytes stored.
+template <typename SampleT>
+std::size_t EncodeImage(char const* const magic_number,
+                        std::size_t const channels, std::size_t const width,
+                        std::size_t const height,
+                        SampleT const* const pixel_data,
+                        std::uint32_t const max_value,
+                        std::uint8_t* const buffer, std::size_t const capacity,
+                        PhaseTimer* const timer) {
+  auto const size = EncodedImageSize(channels, width, height, max_value);
+  if (capacity < size) {
+    auto oss = std::ostringstream{};
+    oss << "buffer capacity must be at least " << size << " bytes, was "
+        << capacity;
+    throw std::invalid_argument(oss.str());
+  }
+  assert(buffer != nullptr && "null buffer");
+
+  auto* const p = StoreHeader(magic_number, width, height, max_value, buffer);
+  timer->Mark(IoPhase::kHeader);
+
+  auto const sample_count = width * height * channels;
+  StoreSamples(pixel_data, max_value, p, sample_count);
+  timer->Mark(IoPhase::kRaster, sample_count * BytesPerSample(max_value));
+  return size;
+}
+
+template <typename SampleT, typename AllocatorT>
+void EncodeImage(char const* const magic_number, std::size_t const channels,
+                 std::size_t const width, std::size_t const height,
+                 SampleT const* const pixel_data,
+                 std::uint32_t const max_value,
+                 std::vector<std::uint8_t, AllocatorT>* const buffer) {
+  auto timer = PhaseTimer(true);
+  assert(buffer != nullptr && "null buffer");
+  buffer->resize(EncodedImageSize(channels, width, height, max_value));
+  timer.Mark(IoPhase::kAllocate, buffer->size());
+  EncodeImage(magic_number, channels, width, height, pixel_data, max_value,
+              buffer->data(), buffer->size(), &timer);
+}
+
+template <typename SampleT>
+std::size_t EncodeImage(char const* const magic_number,
+                        std::size_t const channels, std::size_t const width,
+                        std::size_t const height,
+                        SampleT const* const pixel_data,
+                        std::uint32_t const max_value,
+                        std::uint8_t* const buffer,
+                        std::size_t const capacity) {
+  auto timer = PhaseTimer(true);
+  return EncodeImage(magic_number, channels, width, height, pixel_data,
+                     max_value, buffer, capacity, &timer);
+}
+
+}  // namespace detail
+
+/*!
+A read-only, zero-copy view of the pixel data of a PGM or PPM image that
+is held in memory, e.g. a request body.
+
+The view does not own any memory, it points into the buffer it was
+decoded from and is valid for as long as that buffer is. The pixel data
+is laid out exactly as in the encoded image, see MappedPnmImage.
+*/
+class PnmImageView {
+ public:
+  std::size_t width() const { return width_; }
+  std::size_t height() const { return height_; }
+  std::size_t channels() const { return channels_; }
+  std::uint32_t max_value() const { return max_value_; }
+
+  //! Number of bytes used to store each sample, one or two.
+  std::size_t bytes_per_sample() const {
+    return detail::BytesPerSample(max_value_);
+  }
+
+  //! Number of bytes per row of pixels.
+  std::size_t row_size() const {
+    return width_ * channels_ * bytes_per_sample();
+  }
+
+  //! Pixel data, row major order.
+  std::uint8_t const* data() const { return data_; }
+
+  //! Size of pixel data in bytes.
+  std::size_t size() const { return row_size() * height_; }
+
+  //! Pointer to the first pixel on row @p row.
+  std::uint8_t const* row(std::size_t const row) const {
+    assert(row < height_ && "row out of range");
+    return data_ + row * row_size();
+  }
+
+ private:
+  friend PnmImageView DecodePgmImage(std::uint8_t const*, std::size_t);
+  friend PnmImageView DecodePpmImage(std::uint8_t const*, std::size_t);
+
+  PnmImageView(std::uint8_t const* const data, std::size_t const size,
+               char const* const expected_magic_number,
+               std::size_t const channels)
+      : channels_(channels) {
+    auto header_size = std::size_t{0};
+    auto const header = detail::ReadHeader(
+        reinterpret_cast<char const*>(data), size, &header_size);
+    detail::ThrowIfInvalidMagicNumber<std::runtime_error>(
+        header.magic_number, expected_magic_number);
+
+    data_ = data + header_size;
+    width_ = header.width;
+    height_ = header.height;
+    max_value_ = header.max_value;
+
+    auto const available = size - header_size;
+    if (available < this->size()) {
+      auto oss = std::ostringstream{};
+      oss << "pixel data requires " << this->size() << " bytes, buffer has "
+          << available;
+      throw std::runtime_error(oss.str());
+    }
+  }
+
+  std::uint8_t const* data_ = nullptr;
+  std::size_t width_ = 0;
+  std::size_t height_ = 0;
+  std::size_t channels_ = 0;
+  std::uint32_t max_value_ = 0;
+};
+
+/*!
+Decode a PGM (greyscale) image from the @p size bytes at @p data without
+copying the pixel data. Bytes after the pixel data are ignored.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P5'.
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+  - the buffer is too small to hold the pixel data.
+*/
+inline PnmImageView DecodePgmImage(std::uint8_t const* const data,
+                                   std::size_t const size) {
+  return PnmImageView(data, size, detail::PgmMagicNumber(), 1);
+}
+
+/*!
+Decode a PPM (RGB) image from the @p size bytes at @p data without
+copying the pixel data. Bytes after the pixel data are ignored.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P6'.
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+  - the buffer is too small to hold the pixel data.
+*/
+inline PnmImageView DecodePpmImage(std::uint8_t const* const data,
+                                   std::size_t const size) {
+  return PnmImageView(data, size, detail::PpmMagicNumber(), 3);
+}
+
+/*!
+Size in bytes of a PGM (greyscale) image encoded by EncodePgmImage, i.e.
+the same bytes as written by WritePgmImage.
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+*/
+inline std::size_t EncodedPgmSize(std::size_t const width,
+                                  std::size_t const height,
+                                  std::uint32_t const max_value = 255) {
+  return detail::EncodedImageSize(1, width, height, max_value);
+}
+
+/*!
+Size in bytes of a PPM (RGB) image encoded by EncodePpmImage, see
+EncodedPgmSize.
+*/
+inline std::size_t EncodedPpmSize(std::size_t const width,
+                                  std::size_t const height,
+                                  std::uint32_t const max_value = 255) {
+  return detail::EncodedImageSize(3, width, height, max_value);
+}
+
+/*!
+Encode a PGM (greyscale) image into @p buffer, which is resized to the
+exact encoded size once. The bytes are the same as written by
+WritePgmImage. Use an UninitializedVector to avoid zero-filling memory
+that is about to be overwritten.
+
+An std::invalid_argument is thrown if width or height is zero.
+*/
+template <typename AllocatorT>
+void EncodePgmImage(std::size_t const width, std::size_t const height,
+                    std::uint8_t const* const pixel_data,
+                    std::vector<std::uint8_t, AllocatorT>* const buffer) {
+  detail::EncodeImage(detail::PgmMagicNumber(), 1, width, height, pixel_data,
+                      255, buffer);
+}
+
+/*!
+As the std::uint8_t overload, with 16-bit pixel data stored as for
+WritePgmImage.
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+*/
+template <typename AllocatorT>
+void EncodePgmImage(std::size_t const width, std::size_t const height,
+                    std::uint16_t const* const pixel_data,
+                    std::vector<std::uint8_t, AllocatorT>* const buffer,
+                    std::uint32_t const max_value = 65535) {
+  detail::EncodeImage(detail::PgmMagicNumber(), 1, width, height, pixel_data,
+                      max_value, buffer);
+}
+
+/*!
+As the std::vector overload, but the image is encoded into @p buffer,
+which has room for @p capacity bytes, see EncodedPgmSize. Returns the
+number of bytes stored.
+
+An std::invalid_argument is thrown if:
+  - @p capacity is less than the encoded size.
+  - width or height is zero.
+*/
+inline std::size_t EncodePgmImage(std::size_t const width,
+                                  std::size_t const height,
+                                  std::uint8_t const* const pixel_data,
+                                  std::uint8_t* const buffer,
+                                  std::size_t const capacity) {
+  return detail::EncodeImage(detail::PgmMagicNumber(), 1, width, height,
+                             pixel_data, 255, buffer, capacity);
+}
+
+/*!
+As the std::uint8_t overload, with 16-bit pixel data stored as for
+WritePgmImage.
+*/
+inline std::size_t EncodePgmImage(std::size_t const width,
+                                  std::size_t const height,
+                                  std::uint16_t const* const pixel_data,
+                                  std::uint8_t* const buffer,
+                                  std::size_t const capacity,
+                                  std::uint32_t const max_value = 65535) {
+  return detail::EncodeImage(detail::PgmMagicNumber(), 1, width, height,
+                             pixel_data, max_value, buffer, capacity);
+}
+
+/*!
+Encode a PPM (RGB) image into @p buffer, see EncodePgmImage. The bytes
+are the same as written by WritePpmImage.
+
+An std::invalid_argument is thrown if width or height is zero.
+*/
+template <typename AllocatorT>
+void EncodePpmImage(std::size_t const width, std::size_t const height,
+                    std::uint8_t const* const pixel_data,
+                    std::vector<std::uint8_t, AllocatorT>* const buffer) {
+  detail::EncodeImage(detail::PpmMagicNumber(), 3, width, height, pixel_data,
+                      255, buffer);
+}
+
+/*!
+As the std::uint8_t overload, with 16-bit pixel data stored as for
+WritePpmImage.
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+*/
+template <typename AllocatorT>
+void EncodePpmImage(std::size_t const width, std::size_t const height,
+                    std::uint16_t const* const pixel_data,
+                    std::vector<std::uint8_t, AllocatorT>* const buffer,
+                    std::uint32_t const max_value = 65535) {
+  detail::EncodeImage(detail::PpmMagicNumber(), 3, width, height, pixel_data,
+                      max_value, buffer);
+}
+
+/*!
+As the std::vector overload, but the image is encoded into @p buffer,
+which has room for @p capacity bytes, see EncodedPpmSize. Returns the
+number of bytes stored.
+
+An std::invalid_argument is thrown if:
+  - @p capacity is less than the encoded size.
+  - width or height is zero.
+*/
+inline std::size_t EncodePpmImage(std::size_t const width,
+                                  std::size_t const height,
+                                  std::uint8_t const* const pixel_data,
+                                  std::uint8_t* const buffer,
+                                  std::size_t const capacity) {
+  return detail::EncodeImage(detail::PpmMagicNumber(), 3, width, height,
+                             pixel_data, 255, buffer, capacity);
+}
+
+/*!
+As the std::uint8_t overload, with 16-bit pixel data stored as for
+WritePpmImage.
+*/
+inline std::size_t EncodePpmImage(std::size_t const width,
+                                  std::size_t const height,
+                                  std::uint16_t const* const pixel_data,
+                                  std::uint8_t* const buffer,
+                                  std::size_t const capacity,
+                                  std::uint32_t const max_value = 65535) {
+  return detail::EncodeImage(detail::PpmMagicNumber(), 3, width, height,
+                             pixel_data, max_value, buffer, capacity);
+}
+
+}  // namespace thinks
@@ -0,0 +1,308 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_file.h"
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+namespace thinks {
+
+/*!
+Access pattern hints for mapped images, forwarded to the operating system
+(posix_madvise). Hints never change the contents of the mapping, only
+how eagerly pages are read in and evicted. Hints are ignored on platforms
+that do not support them.
+*/
+enum class AccessHint {
+  kNormal,
+  kSequential,
+  kRandom,
+  kWillNeed,
+  kDontNeed,
+};
+
+namespace detail {
+
+// RAII read-only memory mapping of an entire file.
+class MemoryMapping {
+ public:
+  MemoryMapping() = default;
+
+  explicit MemoryMapping(File const& file) {
+    auto const file_size = file.Size();
+    if (file_size > std::numeric_limits<std::size_t>::max()) {
+      auto oss = std::ostringstream{};
+      oss << "file '" << file.filename() << "' is too large to map";
+      throw std::runtime_error(oss.str());
+    }
+    size_ = static_cast<std::size_t>(file_size);
+    if (size_ == 0) {
+      // Empty files cannot be mapped, leave the mapping empty.
+      return;
+    }
+
+#if defined(_WIN32)
+    mapping_handle_ = ::CreateFileMappingA(file.native_handle(), nullptr,
+                                           PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle_ == nullptr) {
+      ThrowLastError<std::runtime_error>("cannot map file", file.filename());
+    }
+    address_ = ::MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0);
+    if (address_ == nullptr) {
+      ::CloseHandle(mapping_handle_);
+      mapping_handle_ = nullptr;
+      ThrowLastError<std::runtime_error>("cannot map file", file.filename());
+    }
+#else
+    address_ =
+        ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, file.native_handle(), 0);
+    if (address_ == MAP_FAILED) {
+      address_ = nullptr;
+      ThrowLastError<std::runtime_error>("cannot map file", file.filename());
+    }
+#endif
+  }
+
+  MemoryMapping(MemoryMapping&& other) noexcept { Swap(other); }
+
+  MemoryMapping& operator=(MemoryMapping&& other) noexcept {
+    if (this != &other) {
+      Unmap();
+      Swap(other);
+    }
+    return *this;
+  }
+
+  MemoryMapping(MemoryMapping const&) = delete;
+  MemoryMapping& operator=(MemoryMapping const&) = delete;
+
+  ~MemoryMapping() { Unmap(); }
+
+  std::uint8_t const* data() const {
+    return static_cast<std::uint8_t const*>(address_);
+  }
+  std::size_t size() const { return size_; }
+
+  // Offset and length are in bytes and need not be page aligned.
+  void Advise(AccessHint const hint, std::size_t const offset,
+              std::size_t const length) const {
+    assert(offset <= size_ && "advice offset out of range");
+    if (address_ == nullptr || length == 0) {
+      return;
+    }
+#if defined(_WIN32)
+    (void)hint;
+    (void)offset;
+    (void)length;
+#else
+    // posix_madvise requires a page aligned address.
+    auto const page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    auto const aligned_offset = offset - offset % page_size;
+    auto const end = offset + length < size_ ? offset + length : size_;
+    auto const advice = [hint]() {
+      switch (hint) {
+        case AccessHint::kSequential:
+          return POSIX_MADV_SEQUENTIAL;
+        case AccessHint::kRandom:
+          return POSIX_MADV_RANDOM;
+        case AccessHint::kWillNeed:
+          return POSIX_MADV_WILLNEED;
+        case AccessHint::kDontNeed:
+          return POSIX_MADV_DONTNEED;
+        default:
+          return POSIX_MADV_NORMAL;
+      }
+    }();
+    // Advice is best effort, errors are deliberately ignored.
+    ::posix_madvise(static_cast<char*>(address_) + aligned_offset,
+                    end - aligned_offset, advice);
+#endif
+  }
+
+ private:
+  void Swap(MemoryMapping& other) noexcept {
+    std::swap(address_, other.address_);
+    std::swap(size_, other.size_);
+#if defined(_WIN32)
+    std::swap(mapping_handle_, other.mapping_handle_);
+#endif
+  }
+
+  void Unmap() noexcept {
+    if (address_ != nullptr) {
+#if defined(_WIN32)
+      ::UnmapViewOfFile(address_);
+      ::CloseHandle(mapping_handle_);
+      mapping_handle_ = nullptr;
+#else
+      ::munmap(address_, size_);
+#endif
+      address_ = nullptr;
+    }
+    size_ = 0;
+  }
+
+  void* address_ = nullptr;
+  std::size_t size_ = 0;
+#if defined(_WIN32)
+  HANDLE mapping_handle_ = nullptr;
+#endif
+};
+
+}  // namespace detail
+
+/*!
+A read-only, zero-copy view of the pixel data of a PGM or PPM image file.
+
+The view owns a memory mapping of the file, pixel data is never copied
+into a separate buffer. Pages are read from disk on first access, which
+makes it cheap to sample parts of very large images. The pixel data is
+laid out exactly as in the file, i.e. as described for ReadPgmImage and
+ReadPpmImage, and is valid for as long as the view is alive. Images with
+a max value larger than 255 store samples as two bytes, most significant
+byte first.
+
+Views are movable but not copyable.
+*/
+class MappedPnmImage {
+ public:
+  MappedPnmImage(MappedPnmImage&&) = default;
+  MappedPnmImage& operator=(MappedPnmImage&&) = default;
+
+  std::size_t width() const { return width_; }
+  std::size_t height() const { return height_; }
+  std::size_t channels() const { return channels_; }
+  std::uint32_t max_value() const { return max_value_; }
+
+  //! Number of bytes used to store each sample, one or two.
+  std::size_t bytes_per_sample() const {
+    return detail::BytesPerSample(max_value_);
+  }
+
+  //! Number of bytes per row of pixels.
+  std::size_t row_size() const {
+    return width_ * channels_ * bytes_per_sample();
+  }
+
+  //! Pixel data, row major order.
+  std::uint8_t const* data() const { return mapping_.data() + pixel_offset_; }
+
+  //! Size of pixel data in bytes.
+  std::size_t size() const { return row_size() * height_; }
+
+  //! Pointer to the first pixel on row @p row.
+  std::uint8_t const* row(std::size_t const row) const {
+    assert(row < height_ && "row out of range");
+    return data() + row * row_size();
+  }
+
+  //! Hint the expected access pattern for the entire pixel data.
+  void Advise(AccessHint const hint) const {
+    mapping_.Advise(hint, pixel_offset_, size());
+  }
+
+  //! Hint the expected access pattern for a range of rows.
+  void Advise(AccessHint const hint, std::size_t const first_row,
+              std::size_t const row_count) const {
+    assert(first_row + row_count <= height_ && "rows out of range");
+    mapping_.Advise(hint, pixel_offset_ + first_row * row_size(),
+                    row_count * row_size());
+  }
+
+ private:
+  friend MappedPnmImage MapPgmImage(std::string const&, AccessHint);
+  friend MappedPnmImage MapPpmImage(std::string const&, AccessHint);
+
+  MappedPnmImage(std::string const& filename,
+                 char const* const expected_magic_number,
+                 std::size_t const channels)
+      : mapping_(detail::File(filename)), channels_(channels) {
+    auto header_size = std::size_t{0};
+    auto const header = detail::ReadHeader(
+        reinterpret_cast<char const*>(mapping_.data()), mapping_.size(),
+        &header_size);
+    detail::ThrowIfInvalidMagicNumber<std::runtime_error>(
+        header.magic_number, expected_magic_number);
+
+    pixel_offset_ = header_size;
+    width_ = header.width;
+    height_ = header.height;
+    max_value_ = header.max_value;
+
+    auto const available = mapping_.size() - pixel_offset_;
+    if (available < size()) {
+      auto oss = std::ostringstream{};
+      oss << "pixel data requires " << size() << " bytes, file has "
+          << available;
+      throw std::runtime_error(oss.str());
+    }
+  }
+
+  detail::MemoryMapping mapping_;
+  std::size_t pixel_offset_ = 0;
+  std::size_t width_ = 0;
+  std::size_t height_ = 0;
+  std::size_t channels_ = 0;
+  std::uint32_t max_value_ = 0;
+};
+
+/*!
+Map a PGM (greyscale) image file into memory.
+
+The header is validated in the same way as for ReadPgmImage, the returned
+view has a single channel.
+
+An std::runtime_error is thrown if:
+  - the file cannot be opened or mapped.
+  - the magic number is not 'P5'.
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+  - the file is too small to hold the pixel data.
+*/
+inline MappedPnmImage MapPgmImage(
+    std::string const& filename, AccessHint const hint = AccessHint::kNormal) {
+  auto image = MappedPnmImage(filename, detail::PgmMagicNumber(), 1);
+  if (hint != AccessHint::kNormal) {
+    image.Advise(hint);
+  }
+  return image;
+}
+
+/*!
+Map a PPM (RGB) image file into memory.
+
+The header is validated in the same way as for ReadPpmImage, the returned
+view has three channels.
+
+An std::runtime_error is thrown if:
+  - the file cannot be opened or mapped.
+  - the magic number is not 'P6'.
+  - width or height is zero.
+  - the max value is not in the range [1, 65535].
+  - the file is too small to hold the pixel data.
+*/
+inline MappedPnmImage MapPpmImage(
+    std::string const& filename, AccessHint const hint = AccessHint::kNormal) {
+  auto image = MappedPnmImage(filename, detail::PpmMagicNumber(), 3);
+  if (hint != AccessHint::kNormal) {
+    image.Advise(hint);
+  }
+  return image;
+}
+
+}  // namespace thinks
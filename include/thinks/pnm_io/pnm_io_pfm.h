@@ -0,0 +1,423 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <locale>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_simd.h"
+
+namespace thinks {
+
+/*!
+Options for writing float pixel data as 8-bit PGM or PPM images. Each
+sample is multiplied by the scale, clamped to [0, 1], optionally sRGB
+encoded and quantized to [0, 255], all in a single vectorized pass while
+the image is written.
+*/
+struct QuantizeOptions {
+  //! Multiplier applied before clamping, e.g. an exposure.
+  float scale = 1.F;
+
+  //! Encode linear samples with the sRGB transfer function.
+  bool srgb = false;
+
+  //! Add a 4x4 ordered (Bayer) dither instead of rounding to nearest,
+  //! which hides banding in smooth gradients.
+  bool dither = false;
+};
+
+namespace detail {
+
+inline constexpr const char* PfmMagicNumber() { return "Pf"; }
+inline constexpr const char* PfmColorMagicNumber() { return "PF"; }
+
+inline bool IsLittleEndian() {
+#if defined(THINKS_PNM_IO_LITTLE_ENDIAN)
+  return true;
+#else
+  auto const word = std::uint32_t{1};
+  auto byte = std::uint8_t{0};
+  std::memcpy(&byte, &word, 1);
+  return byte == 1;
+#endif
+}
+
+struct PfmHeader {
+  std::size_t width = 0;
+  std::size_t height = 0;
+  std::size_t channels = 1;
+
+  // Absolute value of the scale in the header, whose sign gives the byte
+  // order of the pixel data: negative for little endian.
+  float scale = 1.F;
+  bool little_endian = true;
+};
+
+template <typename ExceptionT>
+void ThrowIfInvalidPfmChannels(std::size_t const channels) {
+  if (channels != 1 && channels != 3) {
+    auto oss = std::ostringstream{};
+    oss << "channel count must be 1 or 3, was " << channels;
+    throw ExceptionT(oss.str());
+  }
+}
+
+// PFM headers have the same layout as PGM/PPM headers, with a signed real
+// scale in place of the max value.
+template <typename ByteSourceT>
+PfmHeader ScanPfmHeader(ByteSourceT* const source) {
+  auto header = PfmHeader{};
+  auto const p = source->Get();
+  auto const f = source->Get();
+  if (p < 0 || f < 0) {
+    ThrowUnexpectedHeaderByte(-1);
+  }
+  if (p != 'P' || (f != 'F' && f != 'f')) {
+    auto oss = std::ostringstream{};
+    oss << "magic number must be '" << PfmColorMagicNumber() << "' or '"
+        << PfmMagicNumber() << "', was '" << static_cast<char>(p)
+        << static_cast<char>(f) << "'";
+    throw std::runtime_error(oss.str());
+  }
+  header.channels = f == 'F' ? 3 : 1;
+
+  SkipHeaderSpace(source);
+  header.width = static_cast<std::size_t>(ReadHeaderValue(
+      source, "width", std::numeric_limits<std::size_t>::max()));
+  SkipHeaderSpace(source);
+  header.height = static_cast<std::size_t>(ReadHeaderValue(
+      source, "height", std::numeric_limits<std::size_t>::max()));
+  SkipHeaderSpace(source);
+
+  // Parsed with the classic locale, the decimal separator is always '.'.
+  auto const token = ReadHeaderToken(source);
+  auto iss = std::istringstream(token);
+  iss.imbue(std::locale::classic());
+  auto scale = 0.F;
+  if (!(iss >> scale) || iss.peek() != std::istringstream::traits_type::eof() ||
+      scale == 0.F || !std::isfinite(scale)) {
+    auto oss = std::ostringstream{};
+    oss << "invalid scale '" << token << "'";
+    throw std::runtime_error(oss.str());
+  }
+  header.scale = std::fabs(scale);
+  header.little_endian = scale < 0.F;
+
+  if (!IsSpaceByte(source->Peek())) {
+    ThrowUnexpectedHeaderByte(source->Peek());
+  }
+  source->Get();
+
+  ThrowIfInvalidWidth<std::runtime_error>(header.width);
+  ThrowIfInvalidHeight<std::runtime_error>(header.height);
+  auto const max_size = std::numeric_limits<std::size_t>::max();
+  if (header.width > max_size / header.height / header.channels /
+                         sizeof(float)) {
+    throw std::runtime_error("image is too large");
+  }
+  return header;
+}
+
+template <typename AllocatorT>
+void ReadPfmImage(std::istream& is, std::size_t* const width,
+                  std::size_t* const height, std::size_t* const channels,
+                  std::vector<float, AllocatorT>* const pixel_data,
+                  float* const scale) {
+  auto timer = PhaseTimer(false);
+  auto source = StreamByteSource(is);
+  auto const header = ScanPfmHeader(&source);
+  assert(width != nullptr && "null width");
+  assert(height != nullptr && "null height");
+  assert(channels != nullptr && "null channels");
+  *width = header.width;
+  *height = header.height;
+  *channels = header.channels;
+  if (scale != nullptr) {
+    *scale = header.scale;
+  }
+  timer.Mark(IoPhase::kHeader);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  auto const row_size = header.width * header.channels;
+  pixel_data->resize(row_size * header.height);
+  timer.Mark(IoPhase::kAllocate, pixel_data->size() * sizeof(float));
+
+  // Rows are stored bottom-up, each is read straight into place and byte
+  // swapped while it is still in cache.
+  auto const swap = header.little_endian != IsLittleEndian();
+  for (auto row = header.height; row > 0; --row) {
+    auto* const dst = reinterpret_cast<std::uint8_t*>(pixel_data->data() +
+                                                      (row - 1) * row_size);
+    ReadPixelData(is, dst, row_size * sizeof(float));
+    if (swap) {
+      SwapBytes32(dst, row_size);
+    }
+  }
+  timer.Mark(IoPhase::kRaster, pixel_data->size() * sizeof(float));
+}
+
+inline void WritePfmImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height,
+                          std::size_t const channels,
+                          float const* const pixel_data, float const scale) {
+  ThrowIfInvalidWidth<std::invalid_argument>(width);
+  ThrowIfInvalidHeight<std::invalid_argument>(height);
+  ThrowIfInvalidPfmChannels<std::invalid_argument>(channels);
+  if (!(scale > 0.F) || !std::isfinite(scale)) {
+    auto oss = std::ostringstream{};
+    oss << "scale must be positive, was " << scale;
+    throw std::invalid_argument(oss.str());
+  }
+
+  auto timer = PhaseTimer(true);
+  auto header = std::ostringstream{};
+  header.imbue(std::locale::classic());
+  header.precision(std::numeric_limits<float>::max_digits10);
+  header << (channels == 3 ? PfmColorMagicNumber() : PfmMagicNumber()) << "\n"
+         << width << " " << height << "\n"
+         << (IsLittleEndian() ? -scale : scale) << "\n";
+  os << header.str();
+  timer.Mark(IoPhase::kHeader);
+
+  // Native byte order, bottom row first.
+  auto const row_size = width * channels;
+  for (auto row = height; row > 0; --row) {
+    WritePixelData(os,
+                   reinterpret_cast<std::uint8_t const*>(
+                       pixel_data + (row - 1) * row_size),
+                   row_size * sizeof(float));
+  }
+  timer.Mark(IoPhase::kRaster, row_size * height * sizeof(float));
+}
+
+inline void WriteQuantizedImage(std::ostream& os,
+                                char const* const magic_number,
+                                std::size_t const channels,
+                                std::size_t const width,
+                                std::size_t const height,
+                                float const* const pixel_data,
+                                QuantizeOptions const& options) {
+  auto timer = PhaseTimer(true);
+  auto header = Header{};
+  header.magic_number = magic_number;
+  header.width = width;
+  header.height = height;
+  WriteHeader(os, header);
+  timer.Mark(IoPhase::kHeader);
+
+  // Per row biases, repeating every four pixels. All samples of a pixel
+  // share the dither threshold so that dithering does not shift hues.
+  constexpr std::uint8_t kBayer[4][4] = {
+      {0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+  constexpr auto kBiasSize = std::size_t{2 * 4 * 3 + 15};
+  auto const period = 4 * channels;
+  float biases[4][kBiasSize];
+  for (auto y = 0; y < 4; ++y) {
+    for (auto k = std::size_t{0}; k < kBiasSize; ++k) {
+      biases[y][k] = options.dither
+                         ? (kBayer[y][(k / channels) % 4] + 0.5F) / 16.F
+                         : 0.5F;
+    }
+  }
+
+  // Rows are quantized into a cache-sized block, which is written when
+  // full. Rows longer than a block are split at multiples of the bias
+  // period.
+  auto const row_size = width * channels;
+  auto const chunk_size = kSampleBlockSize - kSampleBlockSize % period;
+  std::uint8_t block[kSampleBlockSize];
+  auto used = std::size_t{0};
+  for (auto row = std::size_t{0}; row < height; ++row) {
+    auto const* const src = pixel_data + row * row_size;
+    for (auto j = std::size_t{0}; j < row_size; j += chunk_size) {
+      auto const n = row_size - j < chunk_size ? row_size - j : chunk_size;
+      if (used + n > kSampleBlockSize) {
+        WritePixelData(os, block, used);
+        used = 0;
+      }
+      QuantizeToUint8(src + j, block + used, n, options.scale, options.srgb,
+                      biases[row % 4], period);
+      used += n;
+    }
+  }
+  WritePixelData(os, block, used);
+  timer.Mark(IoPhase::kRaster, row_size * height);
+}
+
+}  // namespace detail
+
+/*!
+Read a PFM (floating point) image, magic number 'PF' (RGB) or 'Pf'
+(greyscale), from an input stream.
+
+Pixel data is read into native floats with @p channels samples per pixel,
+1 or 3, interleaved in row major order with the top row first, i.e. the
+same layout as for ReadPgmImage and ReadPpmImage. PFM files store rows
+bottom-up, in the byte order given by the sign of the scale in the
+header, rows are flipped and byte swapped as needed while they are read.
+If @p scale is non-null it is set to the absolute value of the scale in
+the header, samples are not multiplied by it.
+
+Pre-conditions:
+  - the output pointers for width, height, channels and pixel data are
+    non-null.
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'PF' or 'Pf'.
+  - width or height is zero.
+  - the scale is not a non-zero real number.
+  - the pixel data cannot be read.
+*/
+template <typename AllocatorT>
+void ReadPfmImage(std::istream& is, std::size_t* const width,
+                  std::size_t* const height, std::size_t* const channels,
+                  std::vector<float, AllocatorT>* const pixel_data,
+                  float* const scale = nullptr) {
+  detail::ReadPfmImage(is, width, height, channels, pixel_data, scale);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+template <typename AllocatorT>
+void ReadPfmImage(std::string const& filename, std::size_t* const width,
+                  std::size_t* const height, std::size_t* const channels,
+                  std::vector<float, AllocatorT>* const pixel_data,
+                  float* const scale = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadPfmImage(ifs, width, height, channels, pixel_data, scale);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Write a PFM (floating point) image to an output stream, magic number 'PF'
+if @p channels is 3 and 'Pf' if it is 1.
+
+Pixel data is laid out as for ReadPfmImage. Rows are written bottom-up
+straight from @p pixel_data, in native byte order. The header stores
+@p scale with the sign giving the byte order.
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+  - @p channels is not 1 or 3.
+  - @p scale is not a positive real number.
+*/
+inline void WritePfmImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height,
+                          std::size_t const channels,
+                          float const* const pixel_data,
+                          float const scale = 1.F) {
+  detail::WritePfmImage(os, width, height, channels, pixel_data, scale);
+}
+
+/*!
+See std::ostream overload version above.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void WritePfmImage(std::string const& filename, std::size_t const width,
+                          std::size_t const height,
+                          std::size_t const channels,
+                          float const* const pixel_data,
+                          float const scale = 1.F) {
+  auto timer = detail::PhaseTimer(true);
+  auto ofs = std::ofstream{};
+  detail::OpenFileStream(&ofs, filename);
+  timer.Mark(IoPhase::kOpen);
+  WritePfmImage(ofs, width, height, channels, pixel_data, scale);
+  timer.Restart();
+  ofs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Write float pixel data as an 8-bit PGM (greyscale) image, quantizing
+samples as described by @p options while they are written. Pixel data is
+laid out as for the std::uint8_t overload of WritePgmImage.
+
+An std::invalid_argument is thrown if width or height is zero.
+*/
+inline void WritePgmImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height,
+                          float const* const pixel_data,
+                          QuantizeOptions const& options = QuantizeOptions{}) {
+  detail::WriteQuantizedImage(os, detail::PgmMagicNumber(), 1, width, height,
+                              pixel_data, options);
+}
+
+/*!
+See std::ostream overload version above.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void WritePgmImage(std::string const& filename, std::size_t const width,
+                          std::size_t const height,
+                          float const* const pixel_data,
+                          QuantizeOptions const& options = QuantizeOptions{}) {
+  auto timer = detail::PhaseTimer(true);
+  auto ofs = std::ofstream{};
+  detail::OpenFileStream(&ofs, filename);
+  timer.Mark(IoPhase::kOpen);
+  WritePgmImage(ofs, width, height, pixel_data, options);
+  timer.Restart();
+  ofs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Write float pixel data as an 8-bit PPM (RGB) image, quantizing samples as
+described by @p options while they are written. Pixel data is laid out as
+for the std::uint8_t overload of WritePpmImage.
+
+An std::invalid_argument is thrown if width or height is zero.
+*/
+inline void WritePpmImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height,
+                          float const* const pixel_data,
+                          QuantizeOptions const& options = QuantizeOptions{}) {
+  detail::WriteQuantizedImage(os, detail::PpmMagicNumber(), 3, width, height,
+                              pixel_data, options);
+}
+
+/*!
+See std::ostream overload version above.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void WritePpmImage(std::string const& filename, std::size_t const width,
+                          std::size_t const height,
+                          float const* const pixel_data,
+                          QuantizeOptions const& options = QuantizeOptions{}) {
+  auto timer = detail::PhaseTimer(true);
+  auto ofs = std::ofstream{};
+  detail::OpenFileStream(&ofs, filename);
+  timer.Mark(IoPhase::kOpen);
+  WritePpmImage(ofs, width, height, pixel_data, options);
+  timer.Restart();
+  ofs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+}  // namespace thinks
@@ -0,0 +1,269 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <exception>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_file.h"
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace thinks {
+
+/*!
+Header information of an image file, see ProbePnm.
+*/
+struct PnmInfo {
+  std::string magic_number = "";  //!< 'P1' to 'P7'.
+  std::size_t width = 0;
+  std::size_t height = 0;
+
+  //! Samples per pixel: one for PBM and PGM, three for PPM, as stored for
+  //! PAM.
+  std::size_t depth = 0;
+
+  //! Max sample value, one for PBM.
+  std::uint32_t max_value = 0;
+
+  //! PAM tuple type, empty for other formats.
+  std::string tuple_type = "";
+
+  //! Offset in bytes of the pixel data from the start of the file.
+  std::uint64_t raster_offset = 0;
+
+  //! Size in bytes of the pixel data. Zero for plain (ASCII) formats, where
+  //! the size depends on the sample values.
+  std::uint64_t raster_size = 0;
+
+  //! Size in bytes of the file.
+  std::uint64_t file_size = 0;
+};
+
+/*!
+Result of probing a single file, see IndexPnmDirectory.
+*/
+struct PnmIndexEntry {
+  std::string filename = "";
+  PnmInfo info;
+  std::string error = "";  //!< Empty if the file was probed successfully.
+};
+
+namespace detail {
+
+// Byte source reading a file through a small buffer, so that probing a
+// file costs a single read for all but the largest headers. The buffer,
+// offsets and sizes are aligned so that files opened for direct I/O can be
+// read too.
+class FileByteSource {
+ public:
+  explicit FileByteSource(File const& file) : file_(&file) {}
+
+  int Peek() {
+    if (pos_ == end_ && !Fill()) {
+      return -1;
+    }
+    return buffer_[pos_];
+  }
+
+  int Get() {
+    auto const c = Peek();
+    if (c >= 0) {
+      ++pos_;
+    }
+    return c;
+  }
+
+  //! Number of bytes consumed so far.
+  std::uint64_t offset() const { return buffer_offset_ + pos_; }
+
+ private:
+  bool Fill() {
+    buffer_offset_ += end_;
+    pos_ = 0;
+    end_ = file_->ReadAt(buffer_, sizeof(buffer_), buffer_offset_);
+    return end_ > 0;
+  }
+
+  File const* file_;
+  alignas(File::kDirectIoAlignment) unsigned char
+      buffer_[File::kDirectIoAlignment];
+  std::uint64_t buffer_offset_ = 0;
+  std::size_t pos_ = 0;
+  std::size_t end_ = 0;
+};
+
+inline bool IsPnmFilename(std::string const& filename) {
+  auto const dot = filename.find_last_of('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  auto extension = filename.substr(dot + 1);
+  for (auto& c : extension) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return extension == "pbm" || extension == "pgm" || extension == "ppm" ||
+         extension == "pnm" || extension == "pam";
+}
+
+// Names of the regular files in @p directory, symbolic links are followed.
+inline std::vector<std::string> ListDirectory(std::string const& directory) {
+  auto names = std::vector<std::string>{};
+#if defined(_WIN32)
+  auto data = WIN32_FIND_DATAA{};
+  auto const handle = ::FindFirstFileA((directory + "\\*").c_str(), &data);
+  if (handle == INVALID_HANDLE_VALUE) {
+    ThrowLastError<std::runtime_error>("cannot open directory", directory);
+  }
+  do {
+    if ((data.dwFileAttributes &
+         (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_DEVICE)) == 0) {
+      names.emplace_back(data.cFileName);
+    }
+  } while (::FindNextFileA(handle, &data));
+  ::FindClose(handle);
+#else
+  auto* const dir = ::opendir(directory.c_str());
+  if (dir == nullptr) {
+    ThrowLastError<std::runtime_error>("cannot open directory", directory);
+  }
+  while (auto const* const entry = ::readdir(dir)) {
+    auto is_regular = entry->d_type == DT_REG;
+    if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+      // Not all file systems report the type, and links need resolving.
+      auto const path = directory + "/" + entry->d_name;
+      struct stat st;
+      is_regular = ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+    }
+    if (is_regular) {
+      names.emplace_back(entry->d_name);
+    }
+  }
+  ::closedir(dir);
+#endif
+  return names;
+}
+
+// See ProbePnm.
+inline PnmInfo ProbeFile(File const& file) {
+  auto source = FileByteSource(file);
+  auto const header = ScanHeader(&source);
+
+  auto info = PnmInfo{};
+  info.magic_number = header.magic_number;
+  info.width = header.width;
+  info.height = header.height;
+  info.depth = HeaderDepth(header);
+  info.max_value = header.max_value;
+  info.tuple_type = header.tuple_type;
+  info.raster_offset = source.offset();
+  info.raster_size = RasterSize(header);
+  info.file_size = file.Size();
+
+  auto const available = info.file_size - info.raster_offset;
+  if (available < info.raster_size) {
+    auto oss = std::ostringstream{};
+    oss << "pixel data requires " << info.raster_size << " bytes, file has "
+        << available;
+    throw std::runtime_error(oss.str());
+  }
+  return info;
+}
+
+}  // namespace detail
+
+/*!
+Read only the header of an image file, which may be in any of the Netpbm
+formats (magic numbers 'P1' to 'P7'). Pixel data is not read, so probing
+costs a single small read regardless of the image size.
+
+For binary formats the expected size of the pixel data is checked against
+the size of the file.
+
+An std::runtime_error is thrown if:
+  - the file cannot be opened or read.
+  - the header is invalid, see ReadPgmImage.
+  - the file is too small to hold the pixel data.
+*/
+inline PnmInfo ProbePnm(std::string const& filename) {
+  return detail::ProbeFile(detail::File(filename));
+}
+
+/*!
+Probe all image files in @p directory, using ProbePnm on up to
+@p thread_count files concurrently. Image files are the regular files
+with one of the extensions '.pbm', '.pgm', '.ppm', '.pnm' or '.pam' (in
+any case), sub-directories are not searched. Since probing is dominated
+by I/O latency, more threads than cores may pay off on slow storage.
+
+Entries are sorted by filename, which includes the directory. Files that
+cannot be probed are included, with the reason stored in the entry error.
+
+An std::runtime_error is thrown if the directory cannot be read.
+*/
+inline std::vector<PnmIndexEntry> IndexPnmDirectory(
+    std::string const& directory,
+    std::size_t const thread_count = detail::DefaultThreadCount()) {
+  auto names = detail::ListDirectory(directory);
+  names.erase(std::remove_if(names.begin(), names.end(),
+                             [](std::string const& name) {
+                               return !detail::IsPnmFilename(name);
+                             }),
+              names.end());
+  std::sort(names.begin(), names.end());
+
+  auto entries = std::vector<PnmIndexEntry>(names.size());
+  detail::ParallelFor(
+      entries.size(), thread_count, [&](std::size_t const i) {
+        auto& entry = entries[i];
+        entry.filename = directory + "/" + names[i];
+        try {
+          entry.info = ProbePnm(entry.filename);
+        } catch (std::exception const& e) {
+          entry.error = e.what();
+        }
+      });
+  return entries;
+}
+
+/*!
+Write @p entries as tab separated values, one line per entry, preceded by
+a line of column names:
+
+  filename magic_number width height depth max_value raster_offset
+  raster_size error
+
+Only the filename and error columns are set for entries with an error.
+*/
+inline void WritePnmIndex(std::ostream& os,
+                          std::vector<PnmIndexEntry> const& entries) {
+  os << "filename\tmagic_number\twidth\theight\tdepth\tmax_value\t"
+     << "raster_offset\traster_size\terror\n";
+  for (auto const& entry : entries) {
+    os << entry.filename << '\t';
+    if (entry.error.empty()) {
+      auto const& info = entry.info;
+      os << info.magic_number << '\t' << info.width << '\t' << info.height
+         << '\t' << info.depth << '\t' << info.max_value << '\t'
+         << info.raster_offset << '\t' << info.raster_size << '\t' << '\n';
+    } else {
+      os << "\t\t\t\t\t\t\t" << entry.error << '\n';
+    }
+  }
+}
+
+}  // namespace thinks
@@ -0,0 +1,290 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_file.h"
+#include "thinks/pnm_io/pnm_io_probe.h"
+
+namespace thinks {
+
+/*!
+Rectangle of pixels, @p x and @p y being the column and row of its top
+left pixel.
+*/
+struct PnmRegion {
+  std::size_t x = 0;
+  std::size_t y = 0;
+  std::size_t width = 0;
+  std::size_t height = 0;
+};
+
+namespace detail {
+
+inline void ReadExactlyAt(File const& file, std::uint8_t* const dst,
+                          std::size_t const size, std::uint64_t const offset) {
+  if (file.ReadAt(dst, size, offset) != size) {
+    auto oss = std::ostringstream{};
+    oss << "failed reading " << size << " bytes";
+    throw std::runtime_error(oss.str());
+  }
+}
+
+template <typename ExceptionT>
+void ThrowIfInvalidRegion(PnmRegion const& region, std::size_t const width,
+                          std::size_t const height) {
+  if (region.width == 0 || region.height == 0) {
+    throw ExceptionT("region width and height must be non-zero");
+  }
+  if (region.x >= width || region.width > width - region.x ||
+      region.y >= height || region.height > height - region.y) {
+    auto oss = std::ostringstream{};
+    oss << "region " << region.width << "x" << region.height << " at ("
+        << region.x << ", " << region.y << ") is outside " << width << "x"
+        << height << " image";
+    throw ExceptionT(oss.str());
+  }
+}
+
+}  // namespace detail
+
+/*!
+Reads rectangular regions of a binary image file (magic numbers 'P5' to
+'P7') with positioned reads, so that I/O scales with the size of the
+region rather than the size of the file. The file is opened and its
+header parsed once, after which any number of regions can be read.
+
+Rows of a region are read one by one, skipping the columns outside the
+region, unless the gap between rows is small enough that reading
+several rows at once, gap included, is cheaper.
+
+Read may be called concurrently from several threads.
+
+An std::runtime_error is thrown on construction if:
+  - the file cannot be opened or read.
+  - the header is invalid, see ReadPgmImage.
+  - the magic number is not 'P5', 'P6' or 'P7'.
+  - the file is too small to hold the pixel data.
+*/
+class PnmRegionReader {
+ public:
+  explicit PnmRegionReader(std::string const& filename)
+      : file_(filename), info_(detail::ProbeFile(file_)) {
+    if (info_.raster_size == 0 || detail::IsBitmapMagicNumber(
+                                      info_.magic_number)) {
+      auto oss = std::ostringstream{};
+      oss << "unsupported magic number '" << info_.magic_number << "'";
+      throw std::runtime_error(oss.str());
+    }
+    pixel_size_ = info_.depth * detail::BytesPerSample(info_.max_value);
+  }
+
+  PnmInfo const& info() const { return info_; }
+
+  //! Bytes per pixel, as stored.
+  std::size_t pixel_size() const { return pixel_size_; }
+
+  //! Bytes of pixel data in @p region.
+  std::size_t RegionSize(PnmRegion const& region) const {
+    return region.width * region.height * pixel_size_;
+  }
+
+  /*!
+  Read the pixel data of @p region into @p pixel_data, which must have room
+  for RegionSize(region) bytes. Rows of the region are stored one after
+  the other, with pixels as stored in the file.
+
+  An std::invalid_argument is thrown if:
+    - region width or height is zero.
+    - the region is not inside the image.
+
+  An std::runtime_error is thrown if the pixel data cannot be read.
+  */
+  void Read(PnmRegion const& region, std::uint8_t* const pixel_data) const {
+    detail::ThrowIfInvalidRegion<std::invalid_argument>(region, info_.width,
+                                                         info_.height);
+    assert(pixel_data != nullptr && "null pixel data");
+
+    auto const row_pitch = info_.width * pixel_size_;
+    auto const row_size = region.width * pixel_size_;
+    auto const offset = info_.raster_offset +
+                        std::uint64_t{region.y} * row_pitch +
+                        region.x * pixel_size_;
+    if (row_size == row_pitch) {
+      detail::ReadExactlyAt(file_, pixel_data, row_size * region.height,
+                            offset);
+      return;
+    }
+
+    if (row_pitch - row_size >= kMaxGapSize) {
+      for (auto row = std::size_t{0}; row < region.height; ++row) {
+        detail::ReadExactlyAt(file_, pixel_data + row * row_size, row_size,
+                              offset + std::uint64_t{row} * row_pitch);
+      }
+      return;
+    }
+
+    // Small gaps, read bands of rows including the gaps and copy out the
+    // region columns.
+    auto const band_rows =
+        kBandSize > row_pitch ? kBandSize / row_pitch : std::size_t{1};
+    auto band = UninitializedVector<std::uint8_t>(
+        (band_rows - 1) * row_pitch + row_size);
+    for (auto row = std::size_t{0}; row < region.height; row += band_rows) {
+      auto const n =
+          region.height - row < band_rows ? region.height - row : band_rows;
+      detail::ReadExactlyAt(file_, band.data(), (n - 1) * row_pitch + row_size,
+                            offset + std::uint64_t{row} * row_pitch);
+      for (auto i = std::size_t{0}; i < n; ++i) {
+        std::memcpy(pixel_data + (row + i) * row_size,
+                    band.data() + i * row_pitch, row_size);
+      }
+    }
+  }
+
+ private:
+  // Gaps between rows smaller than this are read rather than skipped.
+  static constexpr std::size_t kMaxGapSize = 4096;
+
+  // Bytes per read when reading bands of rows.
+  static constexpr std::size_t kBandSize = std::size_t{1} << 20;
+
+  detail::File file_;
+  PnmInfo info_;
+  std::size_t pixel_size_ = 0;
+};
+
+namespace detail {
+
+template <typename AllocatorT>
+void ReadImageRegions(
+    std::string const& filename, PnmFormat const format,
+    std::vector<PnmRegion> const& regions,
+    std::vector<std::vector<std::uint8_t, AllocatorT>>* const pixel_data,
+    std::uint32_t* const max_value) {
+  assert(pixel_data != nullptr && "null pixel data");
+  auto const reader = PnmRegionReader(filename);
+  ThrowIfInvalidMagicNumber<std::runtime_error>(reader.info().magic_number,
+                                                MagicNumber(format));
+  ThrowIfMaxValueExceeds8Bit<std::runtime_error>(reader.info().max_value);
+  if (max_value != nullptr) {
+    *max_value = reader.info().max_value;
+  }
+
+  // Read regions top to bottom, so that the file is traversed once.
+  auto order = std::vector<std::size_t>(regions.size());
+  for (auto i = std::size_t{0}; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t const a, std::size_t const b) {
+                     return regions[a].y < regions[b].y;
+                   });
+
+  pixel_data->resize(regions.size());
+  for (auto const i : order) {
+    auto& region_data = (*pixel_data)[i];
+    region_data.resize(reader.RegionSize(regions[i]));
+    reader.Read(regions[i], region_data.data());
+  }
+}
+
+}  // namespace detail
+
+/*!
+Read a region of a PGM (greyscale) image file, using positioned reads of
+only the rows of the region, see PnmRegionReader. Pixel data is laid out
+as for ReadPgmImage, for an image of size @p width x @p height.
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+  - the region is not inside the image.
+
+An std::runtime_error is thrown if:
+  - the file cannot be opened or read.
+  - the magic number is not 'P5'.
+  - the max value is not in the range [1, 255].
+  - the file is too small to hold the pixel data.
+*/
+template <typename AllocatorT>
+void ReadPgmRegion(std::string const& filename, std::size_t const x,
+                   std::size_t const y, std::size_t const width,
+                   std::size_t const height,
+                   std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                   std::uint32_t* const max_value = nullptr) {
+  auto region = PnmRegion{};
+  region.x = x;
+  region.y = y;
+  region.width = width;
+  region.height = height;
+  auto regions_data = std::vector<std::vector<std::uint8_t, AllocatorT>>{};
+  detail::ReadImageRegions(filename, PnmFormat::kPgm, {region},
+                           &regions_data, max_value);
+  pixel_data->swap(regions_data.front());
+}
+
+/*!
+Read a region of a PPM (RGB) image file, see ReadPgmRegion.
+
+Example, cropping a patch from a huge image:
+
+  auto patch = std::vector<std::uint8_t>{};
+  thinks::ReadPpmRegion("huge.ppm", 10000, 10000, 512, 512, &patch);
+*/
+template <typename AllocatorT>
+void ReadPpmRegion(std::string const& filename, std::size_t const x,
+                   std::size_t const y, std::size_t const width,
+                   std::size_t const height,
+                   std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                   std::uint32_t* const max_value = nullptr) {
+  auto region = PnmRegion{};
+  region.x = x;
+  region.y = y;
+  region.width = width;
+  region.height = height;
+  auto regions_data = std::vector<std::vector<std::uint8_t, AllocatorT>>{};
+  detail::ReadImageRegions(filename, PnmFormat::kPpm, {region},
+                           &regions_data, max_value);
+  pixel_data->swap(regions_data.front());
+}
+
+/*!
+Read several regions of a PGM (greyscale) image file, opening the file
+once. @p pixel_data is resized to hold one vector per region, in the
+order of @p regions. Regions are read top to bottom and may overlap.
+Exceptions as for ReadPgmRegion.
+*/
+template <typename AllocatorT>
+void ReadPgmRegions(
+    std::string const& filename, std::vector<PnmRegion> const& regions,
+    std::vector<std::vector<std::uint8_t, AllocatorT>>* const pixel_data,
+    std::uint32_t* const max_value = nullptr) {
+  detail::ReadImageRegions(filename, PnmFormat::kPgm, regions, pixel_data,
+                           max_value);
+}
+
+/*!
+Read several regions of a PPM (RGB) image file, opening the file once,
+see ReadPgmRegions.
+*/
+template <typename AllocatorT>
+void ReadPpmRegions(
+    std::string const& filename, std::vector<PnmRegion> const& regions,
+    std::vector<std::vector<std::uint8_t, AllocatorT>>* const pixel_data,
+    std::uint32_t* const max_value = nullptr) {
+  detail::ReadImageRegions(filename, PnmFormat::kPpm, regions, pixel_data,
+                           max_value);
+}
+
+}  // namespace thinks
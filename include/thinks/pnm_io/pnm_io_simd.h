@@ -0,0 +1,948 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Vectorized kernels are selected at compile time from the instruction
+// sets enabled for the translation unit (e.g. -mavx2 or /arch:AVX2),
+// every kernel has a scalar fallback. Define THINKS_PNM_IO_NO_SIMD to
+// always use the scalar versions.
+#if !defined(THINKS_PNM_IO_NO_SIMD)
+#if defined(__AVX2__)
+#define THINKS_PNM_IO_AVX2 1
+#endif
+#if defined(__SSSE3__) || defined(__AVX__)
+#define THINKS_PNM_IO_SSSE3 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define THINKS_PNM_IO_SSE2 1
+#endif
+#endif
+
+#if defined(THINKS_PNM_IO_AVX2)
+#include <immintrin.h>
+#elif defined(THINKS_PNM_IO_SSSE3)
+#include <tmmintrin.h>
+#elif defined(THINKS_PNM_IO_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && \
+                        __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define THINKS_PNM_IO_LITTLE_ENDIAN 1
+#endif
+
+namespace thinks {
+namespace detail {
+
+// Number of samples processed per block by the chunked conversion loops,
+// chosen so that a block stays in L1 cache between passes.
+constexpr std::size_t kSampleBlockSize = 4096;
+
+#if defined(THINKS_PNM_IO_SSE2)
+inline __m128i SwapBytes16(__m128i const v) {
+  return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+#endif
+
+#if defined(THINKS_PNM_IO_AVX2)
+inline __m256i SwapBytes16(__m256i const v) {
+  return _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+}
+#endif
+
+// Convert big-endian 16-bit samples in @p src to native samples in @p dst.
+// The buffers may alias exactly, allowing conversion in place.
+inline void LoadBigEndian16(std::uint8_t const* const src,
+                            std::uint16_t* const dst, std::size_t const count) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_AVX2)
+  for (; i + 16 <= count; i += 16) {
+    auto const v =
+        _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + 2 * i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), SwapBytes16(v));
+  }
+#endif
+#if defined(THINKS_PNM_IO_SSE2)
+  for (; i + 8 <= count; i += 8) {
+    auto const v =
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 2 * i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), SwapBytes16(v));
+  }
+#endif
+  for (; i < count; ++i) {
+    auto const hi = src[2 * i];
+    auto const lo = src[2 * i + 1];
+    dst[i] = static_cast<std::uint16_t>((hi << 8) | lo);
+  }
+}
+
+// Convert native 16-bit samples in @p src to big-endian samples in @p dst.
+// The buffers may alias exactly, allowing conversion in place.
+inline void StoreBigEndian16(std::uint16_t const* const src,
+                             std::uint8_t* const dst,
+                             std::size_t const count) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_AVX2)
+  for (; i + 16 <= count; i += 16) {
+    auto const v =
+        _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i),
+                        SwapBytes16(v));
+  }
+#endif
+#if defined(THINKS_PNM_IO_SSE2)
+  for (; i + 8 <= count; i += 8) {
+    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), SwapBytes16(v));
+  }
+#endif
+  for (; i < count; ++i) {
+    auto const value = src[i];
+    dst[2 * i] = static_cast<std::uint8_t>(value >> 8);
+    dst[2 * i + 1] = static_cast<std::uint8_t>(value & 0xff);
+  }
+}
+
+// Zero-extend 8-bit samples to 16-bit samples.
+inline void Widen8To16(std::uint8_t const* const src, std::uint16_t* const dst,
+                       std::size_t const count) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_AVX2)
+  for (; i + 16 <= count; i += 16) {
+    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_cvtepu8_epi16(v));
+  }
+#endif
+#if defined(THINKS_PNM_IO_SSE2)
+  auto const zero = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                     _mm_unpacklo_epi8(v, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8),
+                     _mm_unpackhi_epi8(v, zero));
+  }
+#endif
+  for (; i < count; ++i) {
+    dst[i] = src[i];
+  }
+}
+
+// Unsigned min(v, 255) of 16-bit lanes. Packing instructions saturate
+// signed lanes, i.e. turn samples of 32768 and above into zero, so
+// samples are clamped before packing.
+#if defined(THINKS_PNM_IO_SSE2)
+inline __m128i Min255(__m128i const v) {
+  return _mm_sub_epi16(v, _mm_subs_epu16(v, _mm_set1_epi16(255)));
+}
+#endif
+
+#if defined(THINKS_PNM_IO_AVX2)
+inline __m256i Min255(__m256i const v) {
+  return _mm256_sub_epi16(v, _mm256_subs_epu16(v, _mm256_set1_epi16(255)));
+}
+#endif
+
+// Narrow 16-bit samples to 8-bit samples, samples larger than 255
+// saturate.
+inline void Narrow16To8(std::uint16_t const* const src, std::uint8_t* const dst,
+                        std::size_t const count) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_AVX2)
+  for (; i + 32 <= count; i += 32) {
+    auto const a = Min255(
+        _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i)));
+    auto const b = Min255(
+        _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i + 16)));
+    // Packing is per 128-bit lane, restore sample order afterwards.
+    auto const packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b),
+                                                 _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+  }
+#endif
+#if defined(THINKS_PNM_IO_SSE2)
+  for (; i + 16 <= count; i += 16) {
+    auto const a =
+        Min255(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i)));
+    auto const b =
+        Min255(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i + 8)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                     _mm_packus_epi16(a, b));
+  }
+#endif
+  for (; i < count; ++i) {
+    dst[i] = static_cast<std::uint8_t>(src[i] > 255 ? 255 : src[i]);
+  }
+}
+
+// Rescale samples in the range [0, max_value] to the range [0, 65535],
+// rounding to nearest. Samples larger than max_value saturate.
+inline void RescaleToFullRange16(std::uint16_t* const data,
+                                 std::size_t const count,
+                                 std::uint32_t const max_value) {
+  auto const scale = 65535.f / static_cast<float>(max_value);
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_AVX2)
+  {
+    auto const zero = _mm256_setzero_si256();
+    auto const vscale = _mm256_set1_ps(scale);
+    auto const half = _mm256_set1_ps(0.5f);
+    auto const vmax = _mm256_set1_ps(65535.f);
+    auto const bias = _mm256_set1_epi32(32768);
+    auto const flip = _mm256_set1_epi16(static_cast<std::int16_t>(0x8000));
+    for (; i + 16 <= count; i += 16) {
+      auto const v =
+          _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+      auto const lo = _mm256_cvttps_epi32(_mm256_min_ps(
+          _mm256_add_ps(
+              _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_unpacklo_epi16(v, zero)),
+                            vscale),
+              half),
+          vmax));
+      auto const hi = _mm256_cvttps_epi32(_mm256_min_ps(
+          _mm256_add_ps(
+              _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_unpackhi_epi16(v, zero)),
+                            vscale),
+              half),
+          vmax));
+      // Unsigned 32-bit to 16-bit pack via signed saturation. Unpacking and
+      // packing are both per 128-bit lane so sample order is preserved.
+      auto const packed = _mm256_xor_si256(
+          _mm256_packs_epi32(_mm256_sub_epi32(lo, bias),
+                             _mm256_sub_epi32(hi, bias)),
+          flip);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), packed);
+    }
+  }
+#endif
+#if defined(THINKS_PNM_IO_SSE2)
+  {
+    auto const zero = _mm_setzero_si128();
+    auto const vscale = _mm_set1_ps(scale);
+    auto const half = _mm_set1_ps(0.5f);
+    auto const vmax = _mm_set1_ps(65535.f);
+    auto const bias = _mm_set1_epi32(32768);
+    auto const flip = _mm_set1_epi16(static_cast<std::int16_t>(0x8000));
+    for (; i + 8 <= count; i += 8) {
+      auto const v =
+          _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+      auto const lo = _mm_cvttps_epi32(_mm_min_ps(
+          _mm_add_ps(
+              _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), vscale),
+              half),
+          vmax));
+      auto const hi = _mm_cvttps_epi32(_mm_min_ps(
+          _mm_add_ps(
+              _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), vscale),
+              half),
+          vmax));
+      // Unsigned 32-bit to 16-bit pack via signed saturation.
+      auto const packed = _mm_xor_si128(
+          _mm_packs_epi32(_mm_sub_epi32(lo, bias), _mm_sub_epi32(hi, bias)),
+          flip);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), packed);
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    auto const scaled = data[i] * scale + 0.5f;
+    data[i] = static_cast<std::uint16_t>(scaled < 65535.f ? scaled : 65535.f);
+  }
+}
+
+// PBM rows store one bit per pixel, most significant bit first, with set
+// bits for black pixels and each row padded to a whole number of bytes.
+// Expanded bitmaps store one byte per pixel, 0 for black and 255 for white.
+
+inline std::size_t PackedRowSize(std::size_t const width) {
+  return (width + 7) / 8;
+}
+
+inline std::uint8_t ReverseBits8(std::uint32_t const b) {
+  return static_cast<std::uint8_t>(
+      (((b * 0x0802u) & 0x22110u) | ((b * 0x8020u) & 0x88440u)) * 0x10101u >>
+      16);
+}
+
+// Expand one packed row of @p width pixels in @p src to one byte per pixel
+// in @p dst.
+inline void UnpackBits(std::uint8_t const* const src, std::uint8_t* const dst,
+                       std::size_t const width) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_AVX2)
+  {
+    // Broadcast four packed bytes, spread each over eight lanes and test
+    // one bit per lane. Clear bits (white) compare equal to zero.
+    auto const spread =
+        _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,  //
+                         2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    auto const bits = _mm256_set1_epi64x(0x0102040810204080);
+    auto const zero = _mm256_setzero_si256();
+    for (; i + 32 <= width; i += 32) {
+      auto word = std::int32_t{0};
+      std::memcpy(&word, src + i / 8, sizeof(word));
+      auto const v = _mm256_shuffle_epi8(_mm256_set1_epi32(word), spread);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                          _mm256_cmpeq_epi8(_mm256_and_si256(v, bits), zero));
+    }
+  }
+#endif
+#if defined(THINKS_PNM_IO_SSE2)
+  {
+    auto const bits = _mm_set1_epi64x(0x0102040810204080);
+    auto const zero = _mm_setzero_si128();
+    for (; i + 16 <= width; i += 16) {
+      auto v = _mm_cvtsi32_si128(src[i / 8] | (src[i / 8 + 1] << 8));
+      v = _mm_unpacklo_epi8(v, v);
+      v = _mm_unpacklo_epi16(v, v);
+      v = _mm_unpacklo_epi32(v, v);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                       _mm_cmpeq_epi8(_mm_and_si128(v, bits), zero));
+    }
+  }
+#endif
+  for (; i < width; ++i) {
+    auto const black = (src[i / 8] >> (7 - i % 8)) & 1;
+    dst[i] = black ? 0 : 255;
+  }
+}
+
+// Pack one row of @p width pixels in @p src, one byte per pixel, to one bit
+// per pixel in @p dst. Zero pixels are black, any other value is white.
+// Padding bits are cleared. @p dst may be equal to @p src, allowing
+// conversion in place.
+inline void PackBits(std::uint8_t const* const src, std::uint8_t* const dst,
+                     std::size_t const width) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_AVX2)
+  {
+    // Reverse each group of eight lanes so that the move mask yields the
+    // first pixel in the most significant bit of each byte.
+    auto const reverse =
+        _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                         7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    auto const zero = _mm256_setzero_si256();
+    for (; i + 32 <= width; i += 32) {
+      auto const v = _mm256_shuffle_epi8(
+          _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i)),
+          reverse);
+      auto const mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+      std::memcpy(dst + i / 8, &mask, sizeof(mask));
+    }
+  }
+#endif
+#if defined(THINKS_PNM_IO_SSE2)
+  {
+    auto const zero = _mm_setzero_si128();
+    for (; i + 16 <= width; i += 16) {
+      auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+      auto const mask = static_cast<std::uint32_t>(
+          _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)));
+      dst[i / 8] = ReverseBits8(mask & 0xff);
+      dst[i / 8 + 1] = ReverseBits8(mask >> 8);
+    }
+  }
+#endif
+  for (; i < width; i += 8) {
+    auto byte = 0u;
+    for (auto j = std::size_t{0}; j < 8 && i + j < width; ++j) {
+      byte |= (src[i + j] == 0 ? 0x80u : 0u) >> j;
+    }
+    dst[i / 8] = static_cast<std::uint8_t>(byte);
+  }
+}
+
+inline int CountTrailingZeros64(std::uint64_t const x) {
+  assert(x != 0 && "count trailing zeros of zero");
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanForward64(&index, x);
+  return static_cast<int>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(x);
+#else
+  auto n = 0;
+  for (auto v = x; (v & 1) == 0; v >>= 1) {
+    ++n;
+  }
+  return n;
+#endif
+}
+
+inline std::size_t PopCount64(std::uint64_t const x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+  return static_cast<std::size_t>(__popcnt64(x));
+#elif defined(__GNUC__) || defined(__clang__)
+  return static_cast<std::size_t>(__builtin_popcountll(x));
+#else
+  auto n = std::size_t{0};
+  for (auto v = x; v != 0; v &= v - 1) {
+    ++n;
+  }
+  return n;
+#endif
+}
+
+// Whitespace as defined by the Netpbm formats (and isspace in the C locale).
+inline bool IsSpace(char const c) {
+  return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+inline bool IsDigit(char const c) {
+  return static_cast<unsigned char>(c - '0') <= 9;
+}
+
+#if defined(THINKS_PNM_IO_LITTLE_ENDIAN)
+// Parse a run of @p length (1 to 8) decimal digits without branching on
+// the length (SWAR). Eight bytes are loaded from @p digits, so at least
+// eight bytes must be readable.
+inline std::uint32_t ParseDigits8(char const* const digits,
+                                  std::size_t const length) {
+  assert(length >= 1 && length <= 8 && "invalid digit count");
+  std::uint64_t v;
+  std::memcpy(&v, digits, sizeof(v));
+  // Right-align the digits, shifting in leading zeros.
+  v = (v - 0x3030303030303030ull) << (8 * (8 - length));
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000ff000000ffull) * (100 + (1000000ull << 32))) +
+       (((v >> 16) & 0x000000ff000000ffull) * (1 + (10000ull << 32)))) >>
+      32;
+  return static_cast<std::uint32_t>(v);
+}
+#endif
+
+// Per-byte classification of a block of text, bit i corresponds to byte i.
+struct TextMasks {
+  std::uint64_t digits;
+  std::uint64_t invalid;  // Neither digit nor whitespace.
+};
+
+#if defined(THINKS_PNM_IO_SSE2)
+inline std::uint32_t InRangeMask16(__m128i const v, char const first,
+                                   char const last) {
+  // Unsigned range check: (v - first) <= (last - first).
+  auto const d = _mm_sub_epi8(v, _mm_set1_epi8(first));
+  auto const in_range =
+      _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(last - first)), d);
+  return static_cast<std::uint32_t>(_mm_movemask_epi8(in_range));
+}
+#endif
+
+#if defined(THINKS_PNM_IO_AVX2)
+inline std::uint32_t InRangeMask32(__m256i const v, char const first,
+                                   char const last) {
+  auto const d = _mm256_sub_epi8(v, _mm256_set1_epi8(first));
+  auto const in_range = _mm256_cmpeq_epi8(
+      _mm256_min_epu8(d, _mm256_set1_epi8(last - first)), d);
+  return static_cast<std::uint32_t>(_mm256_movemask_epi8(in_range));
+}
+#endif
+
+// Classify @p size (at most 64) bytes of text. Bytes beyond @p size are
+// treated as whitespace.
+inline TextMasks ClassifyText64(char const* const text,
+                                std::size_t const size) {
+  assert(size <= 64 && "text block too large");
+  char padded[64];
+  auto block = text;
+  if (size < 64) {
+    std::memset(padded, ' ', sizeof(padded));
+    std::memcpy(padded, text, size);
+    block = padded;
+  }
+
+  auto digits = std::uint64_t{0};
+  auto spaces = std::uint64_t{0};
+#if defined(THINKS_PNM_IO_AVX2)
+  for (auto i = 0; i < 64; i += 32) {
+    auto const v =
+        _mm256_loadu_si256(reinterpret_cast<__m256i const*>(block + i));
+    auto const space = InRangeMask32(v, '\t', '\r') |
+                       static_cast<std::uint32_t>(_mm256_movemask_epi8(
+                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))));
+    digits |= std::uint64_t{InRangeMask32(v, '0', '9')} << i;
+    spaces |= std::uint64_t{space} << i;
+  }
+#elif defined(THINKS_PNM_IO_SSE2)
+  for (auto i = 0; i < 64; i += 16) {
+    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(block + i));
+    auto const space = InRangeMask16(v, '\t', '\r') |
+                       static_cast<std::uint32_t>(_mm_movemask_epi8(
+                           _mm_cmpeq_epi8(v, _mm_set1_epi8(' '))));
+    digits |= std::uint64_t{InRangeMask16(v, '0', '9')} << i;
+    spaces |= std::uint64_t{space} << i;
+  }
+#else
+  for (auto i = 0; i < 64; ++i) {
+    digits |= std::uint64_t{IsDigit(block[i])} << i;
+    spaces |= std::uint64_t{IsSpace(block[i])} << i;
+  }
+#endif
+  return TextMasks{digits, ~(digits | spaces)};
+}
+
+// Pixel layout conversions. Interleaved RGB pixels are three consecutive
+// samples, RGBA pixels four. The std::uint8_t overloads are vectorized,
+// the templates serve other sample types.
+
+#if defined(THINKS_PNM_IO_SSSE3)
+// Shuffle masks gathering @p channel of 16 RGB pixels from the three
+// vectors holding them, one mask per vector.
+inline void DeinterleaveMasks(int const channel, __m128i* const masks) {
+  for (auto part = 0; part < 3; ++part) {
+    alignas(16) std::int8_t mask[16];
+    for (auto j = 0; j < 16; ++j) {
+      auto const pos = 3 * j + channel;
+      mask[j] = static_cast<std::int8_t>(pos / 16 == part ? pos % 16 : -1);
+    }
+    masks[part] = _mm_load_si128(reinterpret_cast<__m128i const*>(mask));
+  }
+}
+
+// Load 16 RGB pixels from @p src as one vector per channel.
+inline void LoadRgb16(std::uint8_t const* const src,
+                      __m128i const (*const masks)[3],
+                      __m128i* const channels) {
+  auto const a0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+  auto const a1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 16));
+  auto const a2 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 32));
+  for (auto c = 0; c < 3; ++c) {
+    channels[c] = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(a0, masks[c][0]),
+                     _mm_shuffle_epi8(a1, masks[c][1])),
+        _mm_shuffle_epi8(a2, masks[c][2]));
+  }
+}
+
+// Shuffle mask for output vector @p part when each of the 16 input bytes
+// is repeated @p repeat times. With @p alpha set, every fourth output
+// byte is left zero.
+inline __m128i RepeatMask(int const repeat, int const part, bool const alpha) {
+  alignas(16) std::int8_t mask[16];
+  for (auto j = 0; j < 16; ++j) {
+    auto const pos = 16 * part + j;
+    mask[j] = static_cast<std::int8_t>(alpha && pos % 4 == 3 ? -1
+                                                             : pos / repeat);
+  }
+  return _mm_load_si128(reinterpret_cast<__m128i const*>(mask));
+}
+#endif
+
+template <typename T>
+void RgbToPlanar(T const* const src, T* const r, T* const g, T* const b,
+                 std::size_t const count) {
+  for (auto i = std::size_t{0}; i < count; ++i) {
+    r[i] = src[3 * i];
+    g[i] = src[3 * i + 1];
+    b[i] = src[3 * i + 2];
+  }
+}
+
+inline void RgbToPlanar(std::uint8_t const* const src, std::uint8_t* const r,
+                        std::uint8_t* const g, std::uint8_t* const b,
+                        std::size_t const count) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_SSSE3)
+  __m128i masks[3][3];
+  for (auto c = 0; c < 3; ++c) {
+    DeinterleaveMasks(c, masks[c]);
+  }
+  for (; i + 16 <= count; i += 16) {
+    __m128i channels[3];
+    LoadRgb16(src + 3 * i, masks, channels);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(r + i), channels[0]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(g + i), channels[1]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b + i), channels[2]);
+  }
+#endif
+  RgbToPlanar<std::uint8_t>(src + 3 * i, r + i, g + i, b + i, count - i);
+}
+
+// Luma from ITU-R BT.601 weights, in 8-bit fixed point for 8-bit samples.
+inline void RgbToLuma(float const* const src, float* const dst,
+                      std::size_t const count) {
+  for (auto i = std::size_t{0}; i < count; ++i) {
+    dst[i] = 0.299f * src[3 * i] + 0.587f * src[3 * i + 1] +
+             0.114f * src[3 * i + 2];
+  }
+}
+
+inline void RgbToLuma(std::uint8_t const* const src, std::uint8_t* const dst,
+                      std::size_t const count) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_SSSE3)
+  __m128i masks[3][3];
+  for (auto c = 0; c < 3; ++c) {
+    DeinterleaveMasks(c, masks[c]);
+  }
+  auto const zero = _mm_setzero_si128();
+  auto const wr = _mm_set1_epi16(77);
+  auto const wg = _mm_set1_epi16(150);
+  auto const wb = _mm_set1_epi16(29);
+  auto const round = _mm_set1_epi16(128);
+  for (; i + 16 <= count; i += 16) {
+    __m128i channels[3];
+    LoadRgb16(src + 3 * i, masks, channels);
+    // The weights sum to 256, so the weighted sum fits in 16 bits.
+    auto const lo = _mm_srli_epi16(
+        _mm_add_epi16(
+            _mm_add_epi16(
+                _mm_mullo_epi16(_mm_unpacklo_epi8(channels[0], zero), wr),
+                _mm_mullo_epi16(_mm_unpacklo_epi8(channels[1], zero), wg)),
+            _mm_add_epi16(
+                _mm_mullo_epi16(_mm_unpacklo_epi8(channels[2], zero), wb),
+                round)),
+        8);
+    auto const hi = _mm_srli_epi16(
+        _mm_add_epi16(
+            _mm_add_epi16(
+                _mm_mullo_epi16(_mm_unpackhi_epi8(channels[0], zero), wr),
+                _mm_mullo_epi16(_mm_unpackhi_epi8(channels[1], zero), wg)),
+            _mm_add_epi16(
+                _mm_mullo_epi16(_mm_unpackhi_epi8(channels[2], zero), wb),
+                round)),
+        8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                     _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; i < count; ++i) {
+    dst[i] = static_cast<std::uint8_t>(
+        (77 * src[3 * i] + 150 * src[3 * i + 1] + 29 * src[3 * i + 2] + 128) >>
+        8);
+  }
+}
+
+template <typename T>
+void GreyToRgb(T const* const src, T* const dst, std::size_t const count) {
+  for (auto i = std::size_t{0}; i < count; ++i) {
+    dst[3 * i] = src[i];
+    dst[3 * i + 1] = src[i];
+    dst[3 * i + 2] = src[i];
+  }
+}
+
+inline void GreyToRgb(std::uint8_t const* const src, std::uint8_t* const dst,
+                      std::size_t const count) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_SSSE3)
+  __m128i masks[3];
+  for (auto part = 0; part < 3; ++part) {
+    masks[part] = RepeatMask(3, part, false);
+  }
+  for (; i + 16 <= count; i += 16) {
+    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+    for (auto part = 0; part < 3; ++part) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * i + 16 * part),
+                       _mm_shuffle_epi8(v, masks[part]));
+    }
+  }
+#endif
+  GreyToRgb<std::uint8_t>(src + i, dst + 3 * i, count - i);
+}
+
+template <typename T>
+void GreyToRgba(T const* const src, T* const dst, std::size_t const count,
+                T const alpha) {
+  for (auto i = std::size_t{0}; i < count; ++i) {
+    dst[4 * i] = src[i];
+    dst[4 * i + 1] = src[i];
+    dst[4 * i + 2] = src[i];
+    dst[4 * i + 3] = alpha;
+  }
+}
+
+inline void GreyToRgba(std::uint8_t const* const src, std::uint8_t* const dst,
+                       std::size_t const count, std::uint8_t const alpha) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_SSSE3)
+  __m128i masks[4];
+  for (auto part = 0; part < 4; ++part) {
+    masks[part] = RepeatMask(4, part, true);
+  }
+  auto const alpha_bytes = _mm_set1_epi32(static_cast<int>(alpha) << 24);
+  for (; i + 16 <= count; i += 16) {
+    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+    for (auto part = 0; part < 4; ++part) {
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(dst + 4 * i + 16 * part),
+          _mm_or_si128(_mm_shuffle_epi8(v, masks[part]), alpha_bytes));
+    }
+  }
+#endif
+  GreyToRgba<std::uint8_t>(src + i, dst + 4 * i, count - i, alpha);
+}
+
+template <typename T>
+void RgbToRgba(T const* const src, T* const dst, std::size_t const count,
+               T const alpha) {
+  for (auto i = std::size_t{0}; i < count; ++i) {
+    dst[4 * i] = src[3 * i];
+    dst[4 * i + 1] = src[3 * i + 1];
+    dst[4 * i + 2] = src[3 * i + 2];
+    dst[4 * i + 3] = alpha;
+  }
+}
+
+inline void RgbToRgba(std::uint8_t const* const src, std::uint8_t* const dst,
+                      std::size_t const count, std::uint8_t const alpha) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_SSSE3)
+  alignas(16) std::int8_t mask_bytes[16];
+  for (auto j = 0; j < 16; ++j) {
+    mask_bytes[j] =
+        static_cast<std::int8_t>(j % 4 == 3 ? -1 : 3 * (j / 4) + j % 4);
+  }
+  auto const mask =
+      _mm_load_si128(reinterpret_cast<__m128i const*>(mask_bytes));
+  auto const alpha_bytes = _mm_set1_epi32(static_cast<int>(alpha) << 24);
+  for (; i + 16 <= count; i += 16) {
+    auto const* const s = src + 3 * i;
+    auto const a0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s));
+    auto const a1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + 16));
+    auto const a2 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + 32));
+    // Windows starting at pixels 0, 4, 8 and 12, i.e. bytes 0, 12, 24, 36.
+    __m128i const windows[4] = {a0, _mm_alignr_epi8(a1, a0, 12),
+                                _mm_alignr_epi8(a2, a1, 8),
+                                _mm_srli_si128(a2, 4)};
+    for (auto part = 0; part < 4; ++part) {
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(dst + 4 * i + 16 * part),
+          _mm_or_si128(_mm_shuffle_epi8(windows[part], mask), alpha_bytes));
+    }
+  }
+#endif
+  RgbToRgba<std::uint8_t>(src + 3 * i, dst + 4 * i, count - i, alpha);
+}
+
+template <typename T>
+void RgbaToRgb(T const* const src, T* const dst, std::size_t const count) {
+  for (auto i = std::size_t{0}; i < count; ++i) {
+    dst[3 * i] = src[4 * i];
+    dst[3 * i + 1] = src[4 * i + 1];
+    dst[3 * i + 2] = src[4 * i + 2];
+  }
+}
+
+inline void RgbaToRgb(std::uint8_t const* const src, std::uint8_t* const dst,
+                      std::size_t const count) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_SSSE3)
+  alignas(16) std::int8_t mask_bytes[16];
+  for (auto j = 0; j < 16; ++j) {
+    mask_bytes[j] =
+        static_cast<std::int8_t>(j < 12 ? 4 * (j / 3) + j % 3 : -1);
+  }
+  auto const mask =
+      _mm_load_si128(reinterpret_cast<__m128i const*>(mask_bytes));
+  for (; i + 16 <= count; i += 16) {
+    // Each part packs 4 pixels into its low 12 bytes.
+    __m128i parts[4];
+    for (auto part = 0; part < 4; ++part) {
+      parts[part] = _mm_shuffle_epi8(
+          _mm_loadu_si128(
+              reinterpret_cast<__m128i const*>(src + 4 * i + 16 * part)),
+          mask);
+    }
+    auto* const d = dst + 3 * i;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d),
+                     _mm_or_si128(parts[0], _mm_slli_si128(parts[1], 12)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 16),
+                     _mm_or_si128(_mm_srli_si128(parts[1], 4),
+                                  _mm_slli_si128(parts[2], 8)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 32),
+                     _mm_or_si128(_mm_srli_si128(parts[2], 8),
+                                  _mm_slli_si128(parts[3], 4)));
+  }
+#endif
+  RgbaToRgb<std::uint8_t>(src + 4 * i, dst + 3 * i, count - i);
+}
+
+// Convert samples to floats multiplied by @p scale.
+inline void ToFloat(std::uint8_t const* const src, float* const dst,
+                    std::size_t const count, float const scale) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_SSE2)
+  auto const zero = _mm_setzero_si128();
+  auto const vscale = _mm_set1_ps(scale);
+  for (; i + 16 <= count; i += 16) {
+    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+    __m128i const words[2] = {_mm_unpacklo_epi8(v, zero),
+                              _mm_unpackhi_epi8(v, zero)};
+    for (auto k = 0; k < 2; ++k) {
+      _mm_storeu_ps(dst + i + 8 * k,
+                    _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words[k],
+                                                                  zero)),
+                               vscale));
+      _mm_storeu_ps(dst + i + 8 * k + 4,
+                    _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words[k],
+                                                                  zero)),
+                               vscale));
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    dst[i] = src[i] * scale;
+  }
+}
+
+inline void ToFloat(std::uint16_t const* const src, float* const dst,
+                    std::size_t const count, float const scale) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_SSE2)
+  auto const zero = _mm_setzero_si128();
+  auto const vscale = _mm_set1_ps(scale);
+  for (; i + 8 <= count; i += 8) {
+    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(
+                                          v, zero)),
+                                      vscale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(
+                                              v, zero)),
+                                          vscale));
+  }
+#endif
+  for (; i < count; ++i) {
+    dst[i] = src[i] * scale;
+  }
+}
+
+// Reverse the bytes of each of @p count 32-bit words in place, e.g. to
+// convert floats between little and big endian.
+inline void SwapBytes32(std::uint8_t* const data, std::size_t const count) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_SSE2)
+  for (; i + 4 <= count; i += 4) {
+    auto* const p = reinterpret_cast<__m128i*>(data + 4 * i);
+    auto const v = SwapBytes16(_mm_loadu_si128(p));
+    _mm_storeu_si128(p, _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1),
+                                            0xB1));
+  }
+#endif
+  for (; i < count; ++i) {
+    auto* const p = data + 4 * i;
+    auto const b0 = p[0];
+    auto const b1 = p[1];
+    p[0] = p[3];
+    p[1] = p[2];
+    p[2] = b1;
+    p[3] = b0;
+  }
+}
+
+// Approximation of the sRGB transfer function for values in [0, 1],
+// within half an 8-bit level of the exact curve. Only square roots are
+// needed, so the vectorized version computes the same values.
+inline float EncodeSrgb(float const v) {
+  if (v <= 0.0031308F) {
+    return 12.92F * v;
+  }
+  auto const s = std::sqrt(v);
+  auto const q = std::sqrt(s);
+  return 0.585122381F * s + 0.783140355F * q - 0.368262736F * std::sqrt(q);
+}
+
+// Quantize @p count float samples to 8 bits in one pass: multiply by
+// @p scale, clamp to [0, 1] (NaN becomes 0), optionally sRGB encode, then
+// map to [0, 255] and add a bias in [0, 1) before truncating. The bias of
+// sample i is bias[i % period], with bias holding at least
+// 2 * period + 15 entries so that vector loads need no wrap-around. A
+// bias of 0.5 rounds to nearest, varying biases dither.
+inline void QuantizeToUint8(float const* const src, std::uint8_t* const dst,
+                            std::size_t const count, float const scale,
+                            bool const srgb, float const* const bias,
+                            std::size_t const period) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_SSE2)
+  auto const vscale = _mm_set1_ps(scale);
+  auto const zero = _mm_setzero_ps();
+  auto const one = _mm_set1_ps(1.F);
+  auto const knee = _mm_set1_ps(0.0031308F);
+  auto const linear_slope = _mm_set1_ps(12.92F);
+  auto const c0 = _mm_set1_ps(0.585122381F);
+  auto const c1 = _mm_set1_ps(0.783140355F);
+  auto const c2 = _mm_set1_ps(0.368262736F);
+  auto const levels = _mm_set1_ps(255.F);
+  for (; i + 16 <= count; i += 16) {
+    auto const* const b = bias + i % period;
+    __m128i words[4];
+    for (auto k = 0; k < 4; ++k) {
+      auto v = _mm_mul_ps(_mm_loadu_ps(src + i + 4 * k), vscale);
+      v = _mm_min_ps(_mm_max_ps(v, zero), one);
+      if (srgb) {
+        auto const s = _mm_sqrt_ps(v);
+        auto const q = _mm_sqrt_ps(s);
+        auto const curve = _mm_sub_ps(
+            _mm_add_ps(_mm_mul_ps(c0, s), _mm_mul_ps(c1, q)),
+            _mm_mul_ps(c2, _mm_sqrt_ps(q)));
+        auto const mask = _mm_cmple_ps(v, knee);
+        v = _mm_or_ps(_mm_and_ps(mask, _mm_mul_ps(linear_slope, v)),
+                      _mm_andnot_ps(mask, curve));
+      }
+      v = _mm_add_ps(_mm_mul_ps(v, levels), _mm_loadu_ps(b + 4 * k));
+      words[k] = _mm_cvttps_epi32(v);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                     _mm_packus_epi16(_mm_packs_epi32(words[0], words[1]),
+                                      _mm_packs_epi32(words[2], words[3])));
+  }
+#endif
+  for (; i < count; ++i) {
+    auto v = src[i] * scale;
+    v = v > 0.F ? v : 0.F;
+    v = v < 1.F ? v : 1.F;
+    if (srgb) {
+      v = EncodeSrgb(v);
+    }
+    dst[i] = static_cast<std::uint8_t>(
+        static_cast<int>(v * 255.F + bias[i % period]));
+  }
+}
+
+// Add 8-bit samples in @p src to the 16-bit sums in @p sums, e.g. to sum
+// the rows of a block of pixels being averaged.
+inline void AccumulateSamples(std::uint8_t const* const src,
+                              std::uint16_t* const sums,
+                              std::size_t const count) {
+  auto i = std::size_t{0};
+#if defined(THINKS_PNM_IO_AVX2)
+  for (; i + 16 <= count; i += 16) {
+    auto const v = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i)));
+    auto* const p = reinterpret_cast<__m256i*>(sums + i);
+    _mm256_storeu_si256(p, _mm256_add_epi16(_mm256_loadu_si256(p), v));
+  }
+#endif
+#if defined(THINKS_PNM_IO_SSE2)
+  auto const zero = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+    auto* const lo = reinterpret_cast<__m128i*>(sums + i);
+    auto* const hi = reinterpret_cast<__m128i*>(sums + i + 8);
+    _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo),
+                                       _mm_unpacklo_epi8(v, zero)));
+    _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi),
+                                       _mm_unpackhi_epi8(v, zero)));
+  }
+#endif
+  for (; i < count; ++i) {
+    sums[i] = static_cast<std::uint16_t>(sums[i] + src[i]);
+  }
+}
+
+}  // namespace detail
+}  // namespace thinks
@@ -0,0 +1,327 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_file.h"
+#include "thinks/pnm_io/pnm_io_memory.h"
+
+namespace thinks {
+
+/*!
+Order of rows in a caller buffer. Files always store the top row first,
+bottom-up buffers, e.g. from glReadPixels, store the bottom row first.
+*/
+enum class RowOrder {
+  kTopDown,
+  kBottomUp,
+};
+
+/*!
+How the rows of 8-bit pixel data are laid out in a caller buffer, e.g. a
+sub-rectangle of a larger framebuffer or rows padded to an alignment.
+*/
+struct RowLayout {
+  //! Bytes from the first sample of one row to the first sample of the
+  //! next. Zero means tightly packed rows, otherwise the stride must be
+  //! at least the size of a row.
+  std::size_t stride = 0;
+
+  //! Rows of bottom-up buffers are written and read in reverse order,
+  //! straight from and to the buffer, without a separate flip pass.
+  RowOrder order = RowOrder::kTopDown;
+};
+
+namespace detail {
+
+template <typename ExceptionT>
+std::size_t RowStride(RowLayout const& rows, std::size_t const row_size) {
+  if (rows.stride == 0) {
+    return row_size;
+  }
+  if (rows.stride < row_size) {
+    auto oss = std::ostringstream{};
+    oss << "row stride must be at least " << row_size << " bytes, was "
+        << rows.stride;
+    throw ExceptionT(oss.str());
+  }
+  return rows.stride;
+}
+
+// True if the rows are stored exactly as in a file.
+inline bool IsContiguous(RowLayout const& rows, std::size_t const row_size,
+                         std::size_t const stride) {
+  return stride == row_size && rows.order == RowOrder::kTopDown;
+}
+
+// Offset in the caller buffer of image row @p row, counted from the top.
+inline std::size_t RowOffset(RowLayout const& rows, std::size_t const stride,
+                             std::size_t const height, std::size_t const row) {
+  return (rows.order == RowOrder::kBottomUp ? height - 1 - row : row) *
+         stride;
+}
+
+// Write rows straight from the source, a single write if they are
+// contiguous.
+inline void WriteRows(std::ostream& os, std::uint8_t const* const pixel_data,
+                      RowLayout const& rows, std::size_t const row_size,
+                      std::size_t const stride, std::size_t const height) {
+  if (IsContiguous(rows, row_size, stride)) {
+    WritePixelData(os, pixel_data, row_size * height);
+    return;
+  }
+  for (auto row = std::size_t{0}; row < height; ++row) {
+    WritePixelData(os, pixel_data + RowOffset(rows, stride, height, row),
+                   row_size);
+  }
+}
+
+inline void WriteImageStrided(std::ostream& os,
+                              char const* const magic_number,
+                              std::size_t const channels,
+                              std::size_t const width,
+                              std::size_t const height,
+                              std::uint8_t const* const pixel_data,
+                              RowLayout const& rows) {
+  auto timer = PhaseTimer(true);
+  auto header = Header{};
+  header.magic_number = magic_number;
+  header.width = width;
+  header.height = height;
+  auto const row_size = width * channels;
+  auto const stride = RowStride<std::invalid_argument>(rows, row_size);
+  WriteHeader(os, header);
+  timer.Mark(IoPhase::kHeader);
+  WriteRows(os, pixel_data, rows, row_size, stride, height);
+  timer.Mark(IoPhase::kRaster, row_size * height);
+}
+
+// The header and every row are written with a single gathered write
+// (writev), so rows are neither packed into a staging buffer nor written
+// with one system call each.
+inline void WriteImageStrided(std::string const& filename,
+                              char const* const magic_number,
+                              std::size_t const channels,
+                              std::size_t const width,
+                              std::size_t const height,
+                              std::uint8_t const* const pixel_data,
+                              RowLayout const& rows) {
+  ThrowIfInvalidWidth<std::invalid_argument>(width);
+  ThrowIfInvalidHeight<std::invalid_argument>(height);
+  auto const row_size = width * channels;
+  auto const stride = RowStride<std::invalid_argument>(rows, row_size);
+
+  auto timer = PhaseTimer(true);
+  auto file = OutputFile(filename);
+  timer.Mark(IoPhase::kOpen);
+
+  std::uint8_t header[kMaxHeaderSize];
+  auto const header_end = StoreHeader(magic_number, width, height, 255, header);
+  auto ranges = std::vector<ByteRange>{};
+  ranges.push_back(
+      ByteRange{header, static_cast<std::size_t>(header_end - header)});
+  if (IsContiguous(rows, row_size, stride)) {
+    ranges.push_back(ByteRange{pixel_data, row_size * height});
+  } else {
+    ranges.reserve(1 + height);
+    for (auto row = std::size_t{0}; row < height; ++row) {
+      ranges.push_back(ByteRange{
+          pixel_data + RowOffset(rows, stride, height, row), row_size});
+    }
+  }
+  timer.Mark(IoPhase::kHeader);
+  file.WriteGather(ranges.data(), ranges.size());
+  timer.Mark(IoPhase::kRaster, row_size * height);
+  file.Close();
+  timer.Mark(IoPhase::kClose);
+}
+
+inline void ReadImageStrided(std::istream& is, char const* const magic_number,
+                             std::size_t const channels,
+                             std::size_t* const width,
+                             std::size_t* const height,
+                             std::uint8_t* const pixel_data,
+                             std::size_t const capacity,
+                             RowLayout const& rows,
+                             std::uint32_t* const max_value) {
+  auto timer = PhaseTimer(false);
+  auto const header = ReadImageHeader<std::uint8_t>(is, magic_number, width,
+                                                    height, max_value);
+  timer.Mark(IoPhase::kHeader);
+  auto const row_size = header.width * channels;
+  auto const stride = RowStride<std::runtime_error>(rows, row_size);
+  auto const size = (header.height - 1) * stride + row_size;
+  if (capacity < size) {
+    auto oss = std::ostringstream{};
+    oss << "pixel data requires " << size << " bytes, capacity is "
+        << capacity;
+    throw std::runtime_error(oss.str());
+  }
+
+  assert(pixel_data != nullptr && "null pixel data");
+  if (IsContiguous(rows, row_size, stride)) {
+    ReadPixelData(is, pixel_data, row_size * header.height);
+  } else {
+    for (auto row = std::size_t{0}; row < header.height; ++row) {
+      ReadPixelData(
+          is, pixel_data + RowOffset(rows, stride, header.height, row),
+          row_size);
+    }
+  }
+  timer.Mark(IoPhase::kRaster, row_size * header.height);
+}
+
+inline void ReadImageStrided(std::string const& filename,
+                             char const* const magic_number,
+                             std::size_t const channels,
+                             std::size_t* const width,
+                             std::size_t* const height,
+                             std::uint8_t* const pixel_data,
+                             std::size_t const capacity,
+                             RowLayout const& rows,
+                             std::uint32_t* const max_value) {
+  auto timer = PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadImageStrided(ifs, magic_number, channels, width, height, pixel_data,
+                   capacity, rows, max_value);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+}  // namespace detail
+
+/*!
+As the pointer overload of ReadPgmImage, but rows are stored @p rows.stride
+bytes apart in @p pixel_data, which has room for @p capacity bytes, in
+the order given by @p rows.order. Rows are read straight into place,
+bytes between rows are left untouched. The required capacity is
+(height - 1) * stride + width.
+
+An std::runtime_error is thrown if:
+  - the stride is non-zero and less than the width.
+  - @p capacity is less than the required capacity.
+  - any of the conditions for the std::vector overload apply.
+*/
+inline void ReadPgmImage(std::istream& is, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint8_t* const pixel_data,
+                         std::size_t const capacity, RowLayout const& rows,
+                         std::uint32_t* const max_value = nullptr) {
+  detail::ReadImageStrided(is, detail::PgmMagicNumber(), 1, width, height,
+                           pixel_data, capacity, rows, max_value);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPgmImage(std::string const& filename, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint8_t* const pixel_data,
+                         std::size_t const capacity, RowLayout const& rows,
+                         std::uint32_t* const max_value = nullptr) {
+  detail::ReadImageStrided(filename, detail::PgmMagicNumber(), 1, width,
+                           height, pixel_data, capacity, rows, max_value);
+}
+
+/*!
+As the strided ReadPgmImage, for PPM (RGB) images. The required capacity
+is (height - 1) * stride + width * 3.
+*/
+inline void ReadPpmImage(std::istream& is, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint8_t* const pixel_data,
+                         std::size_t const capacity, RowLayout const& rows,
+                         std::uint32_t* const max_value = nullptr) {
+  detail::ReadImageStrided(is, detail::PpmMagicNumber(), 3, width, height,
+                           pixel_data, capacity, rows, max_value);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+inline void ReadPpmImage(std::string const& filename, std::size_t* const width,
+                         std::size_t* const height,
+                         std::uint8_t* const pixel_data,
+                         std::size_t const capacity, RowLayout const& rows,
+                         std::uint32_t* const max_value = nullptr) {
+  detail::ReadImageStrided(filename, detail::PpmMagicNumber(), 3, width,
+                           height, pixel_data, capacity, rows, max_value);
+}
+
+/*!
+As WritePgmImage, but rows are taken @p rows.stride bytes apart from
+@p pixel_data, in the order given by @p rows.order, without packing or
+flipping them into a staging buffer first.
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+  - the stride is non-zero and less than the width.
+*/
+inline void WritePgmImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height,
+                          std::uint8_t const* const pixel_data,
+                          RowLayout const& rows) {
+  detail::WriteImageStrided(os, detail::PgmMagicNumber(), 1, width, height,
+                            pixel_data, rows);
+}
+
+/*!
+See std::ostream overload version above. The header and all rows are
+written with a single gathered write (writev) where supported.
+
+Throws an std::runtime_error if file cannot be opened or written.
+*/
+inline void WritePgmImage(std::string const& filename, std::size_t const width,
+                          std::size_t const height,
+                          std::uint8_t const* const pixel_data,
+                          RowLayout const& rows) {
+  detail::WriteImageStrided(filename, detail::PgmMagicNumber(), 1, width,
+                            height, pixel_data, rows);
+}
+
+/*!
+As the strided WritePgmImage, for PPM (RGB) images. The stride must be
+zero or at least width * 3.
+*/
+inline void WritePpmImage(std::ostream& os, std::size_t const width,
+                          std::size_t const height,
+                          std::uint8_t const* const pixel_data,
+                          RowLayout const& rows) {
+  detail::WriteImageStrided(os, detail::PpmMagicNumber(), 3, width, height,
+                            pixel_data, rows);
+}
+
+/*!
+See std::ostream overload version above. The header and all rows are
+written with a single gathered write (writev) where supported.
+
+Throws an std::runtime_error if file cannot be opened or written.
+*/
+inline void WritePpmImage(std::string const& filename, std::size_t const width,
+                          std::size_t const height,
+                          std::uint8_t const* const pixel_data,
+                          RowLayout const& rows) {
+  detail::WriteImageStrided(filename, detail::PpmMagicNumber(), 3, width,
+                            height, pixel_data, rows);
+}
+
+}  // namespace thinks
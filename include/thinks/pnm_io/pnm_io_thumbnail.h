@@ -0,0 +1,298 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_file.h"
+#include "thinks/pnm_io/pnm_io_probe.h"
+#include "thinks/pnm_io/pnm_io_simd.h"
+
+namespace thinks {
+
+/*!
+How blocks of pixels are reduced to a single pixel when downscaling.
+*/
+enum class DownscaleFilter {
+  //! Average of the block, rounded to nearest.
+  kBox,
+
+  //! Center pixel of the block. Cheaper, and reads only one row per block
+  //! when reading from a file.
+  kNearest,
+};
+
+namespace detail {
+
+// Samples are summed in 16 bits, which holds the sum of a column of up
+// to 257 8-bit samples.
+constexpr std::size_t kMaxDownscaleFactor = 256;
+
+inline void ThrowIfInvalidDownscaleFactor(std::size_t const factor) {
+  if (factor == 0 || factor > kMaxDownscaleFactor) {
+    auto oss = std::ostringstream{};
+    oss << "downscale factor must be in the range [1, " << kMaxDownscaleFactor
+        << "], was " << factor;
+    throw std::invalid_argument(oss.str());
+  }
+}
+
+// Source image dimensions and the downscaled dimensions, which are
+// rounded up so that partial blocks at the right and bottom edges are
+// included.
+class Downscaler {
+ public:
+  Downscaler(std::size_t const width, std::size_t const height,
+             std::size_t const channel_count, std::size_t const factor,
+             DownscaleFilter const filter)
+      : width_(width),
+        height_(height),
+        channel_count_(channel_count),
+        factor_(factor),
+        filter_(filter) {}
+
+  std::size_t width() const { return (width_ + factor_ - 1) / factor_; }
+  std::size_t height() const { return (height_ + factor_ - 1) / factor_; }
+  std::size_t row_size() const { return width_ * channel_count_; }
+
+  std::size_t first_row(std::size_t const row) const { return row * factor_; }
+  std::size_t row_count(std::size_t const row) const {
+    return std::min(factor_, height_ - first_row(row));
+  }
+
+  // Index of the single source row used by kNearest, relative to the
+  // first row of the block.
+  std::size_t nearest_row(std::size_t const row) const {
+    return std::min(factor_ / 2, row_count(row) - 1);
+  }
+
+  // Reduce the source rows of output row @p row to @p dst. For kBox
+  // @p rows holds all row_count(row) source rows of the block and
+  // @p sums has room for row_size() sums, for kNearest @p rows holds only
+  // the nearest row.
+  void Reduce(std::size_t const row, std::uint8_t const* const rows,
+              std::uint16_t* const sums, std::uint8_t* const dst) const {
+    auto const out_width = width();
+    auto const half = factor_ / 2;
+    if (filter_ == DownscaleFilter::kNearest) {
+      for (auto x = std::size_t{0}; x < out_width; ++x) {
+        auto const src_x = std::min(x * factor_ + half, width_ - 1);
+        std::memcpy(dst + x * channel_count_, rows + src_x * channel_count_,
+                    channel_count_);
+      }
+      return;
+    }
+
+    // Sum the rows of the block vertically, then the columns of each
+    // block horizontally.
+    auto const rows_in_block = row_count(row);
+    std::memset(sums, 0, row_size() * sizeof(std::uint16_t));
+    for (auto i = std::size_t{0}; i < rows_in_block; ++i) {
+      AccumulateSamples(rows + i * row_size(), sums, row_size());
+    }
+    for (auto x = std::size_t{0}; x < out_width; ++x) {
+      auto const first_column = x * factor_;
+      auto const column_count = std::min(factor_, width_ - first_column);
+      auto const count =
+          static_cast<std::uint32_t>(column_count * rows_in_block);
+      for (auto c = std::size_t{0}; c < channel_count_; ++c) {
+        auto sum = count / 2;
+        auto const* column = sums + first_column * channel_count_ + c;
+        for (auto i = std::size_t{0}; i < column_count; ++i) {
+          sum += column[i * channel_count_];
+        }
+        dst[x * channel_count_ + c] = static_cast<std::uint8_t>(sum / count);
+      }
+    }
+  }
+
+ private:
+  std::size_t width_;
+  std::size_t height_;
+  std::size_t channel_count_;
+  std::size_t factor_;
+  DownscaleFilter filter_;
+};
+
+template <typename AllocatorT>
+void ReadThumbnail(std::istream& is, PnmFormat const format,
+                   std::size_t const factor, std::size_t* const width,
+                   std::size_t* const height,
+                   std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                   DownscaleFilter const filter) {
+  ThrowIfInvalidDownscaleFactor(factor);
+  auto const header = ReadImageHeader<std::uint8_t>(
+      is, MagicNumber(format), width, height, nullptr);
+  auto const downscaler = Downscaler(header.width, header.height,
+                                     ChannelCount(format), factor, filter);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  auto const out_row_size = downscaler.width() * ChannelCount(format);
+  pixel_data->resize(out_row_size * downscaler.height());
+  auto rows = UninitializedVector<std::uint8_t>(factor * downscaler.row_size());
+  auto sums = UninitializedVector<std::uint16_t>(downscaler.row_size());
+  for (auto row = std::size_t{0}; row < downscaler.height(); ++row) {
+    auto const row_count = downscaler.row_count(row);
+    ReadPixelData(is, rows.data(), row_count * downscaler.row_size());
+    auto const* src = rows.data();
+    if (filter == DownscaleFilter::kNearest) {
+      src += downscaler.nearest_row(row) * downscaler.row_size();
+    }
+    downscaler.Reduce(row, src, sums.data(),
+                      pixel_data->data() + row * out_row_size);
+  }
+  *width = downscaler.width();
+  *height = downscaler.height();
+}
+
+template <typename AllocatorT>
+void ReadThumbnail(std::string const& filename, PnmFormat const format,
+                   std::size_t const factor, std::size_t* const width,
+                   std::size_t* const height,
+                   std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                   DownscaleFilter const filter,
+                   std::size_t const thread_count) {
+  assert(width != nullptr && "null width");
+  assert(height != nullptr && "null height");
+  assert(pixel_data != nullptr && "null pixel data");
+  ThrowIfInvalidDownscaleFactor(factor);
+  auto const file = File(filename);
+  auto const info = ProbeFile(file);
+  ThrowIfInvalidMagicNumber<std::runtime_error>(info.magic_number,
+                                                MagicNumber(format));
+  ThrowIfMaxValueExceeds8Bit<std::runtime_error>(info.max_value);
+  auto const downscaler = Downscaler(info.width, info.height,
+                                     ChannelCount(format), factor, filter);
+
+  auto const out_height = downscaler.height();
+  auto const out_row_size = downscaler.width() * ChannelCount(format);
+  pixel_data->resize(out_row_size * out_height);
+
+  // Each task reduces a contiguous band of output rows, reading the
+  // source rows of one output row at a time.
+  auto const task_count =
+      std::max(std::size_t{1}, std::min(thread_count, out_height));
+  ParallelFor(task_count, task_count, [&](std::size_t const task) {
+    auto const row_size = downscaler.row_size();
+    auto rows = UninitializedVector<std::uint8_t>(
+        filter == DownscaleFilter::kNearest ? row_size : factor * row_size);
+    auto sums = UninitializedVector<std::uint16_t>(
+        filter == DownscaleFilter::kNearest ? 0 : row_size);
+    auto const end = out_height * (task + 1) / task_count;
+    for (auto row = out_height * task / task_count; row < end; ++row) {
+      auto first_row = downscaler.first_row(row);
+      auto read_size = downscaler.row_count(row) * row_size;
+      if (filter == DownscaleFilter::kNearest) {
+        first_row += downscaler.nearest_row(row);
+        read_size = row_size;
+      }
+      if (file.ReadAt(rows.data(), read_size,
+                      info.raster_offset +
+                          std::uint64_t{first_row} * row_size) != read_size) {
+        auto oss = std::ostringstream{};
+        oss << "failed reading " << read_size << " bytes";
+        throw std::runtime_error(oss.str());
+      }
+      downscaler.Reduce(row, rows.data(), sums.data(),
+                        pixel_data->data() + row * out_row_size);
+    }
+  });
+  *width = downscaler.width();
+  *height = downscaler.height();
+}
+
+}  // namespace detail
+
+/*!
+Read a PGM (greyscale) image from an input stream, downscaled by an
+integer @p factor in each dimension. Source rows are read one block of
+@p factor rows at a time and reduced as they arrive, so the full
+resolution image is never held in memory.
+
+The downscaled width and height are the source width and height divided
+by @p factor, rounded up. Blocks at the right and bottom edges may be
+partial, in which case kBox averages the pixels that are present. Only
+8-bit images are supported.
+
+An std::invalid_argument is thrown if:
+  - the factor is not in the range [1, 256].
+
+An std::runtime_error is thrown if:
+  - the magic number is not 'P5'.
+  - width or height is zero.
+  - the max value is not in the range [1, 255].
+  - the pixel data cannot be read.
+*/
+template <typename AllocatorT>
+void ReadPgmThumbnail(std::istream& is, std::size_t const factor,
+                      std::size_t* const width, std::size_t* const height,
+                      std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                      DownscaleFilter const filter = DownscaleFilter::kBox) {
+  detail::ReadThumbnail(is, PnmFormat::kPgm, factor, width, height,
+                        pixel_data, filter);
+}
+
+/*!
+As the std::istream overload, but bands of output rows are reduced on up
+to @p thread_count threads, each reading its source rows with positioned
+reads. With kNearest only one source row per output row is read.
+
+An std::runtime_error is also thrown if:
+  - the file cannot be opened.
+  - the file is too small to hold the pixel data.
+*/
+template <typename AllocatorT>
+void ReadPgmThumbnail(
+    std::string const& filename, std::size_t const factor,
+    std::size_t* const width, std::size_t* const height,
+    std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+    DownscaleFilter const filter = DownscaleFilter::kBox,
+    std::size_t const thread_count = detail::DefaultThreadCount()) {
+  detail::ReadThumbnail(filename, PnmFormat::kPgm, factor, width, height,
+                        pixel_data, filter, thread_count);
+}
+
+/*!
+Read a PPM (RGB) image from an input stream, downscaled by an integer
+@p factor in each dimension, see ReadPgmThumbnail.
+
+Example, a preview at 1/16 of the size in each dimension:
+
+  thinks::ReadPpmThumbnail("huge.ppm", 16, &width, &height, &pixel_data);
+*/
+template <typename AllocatorT>
+void ReadPpmThumbnail(std::istream& is, std::size_t const factor,
+                      std::size_t* const width, std::size_t* const height,
+                      std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+                      DownscaleFilter const filter = DownscaleFilter::kBox) {
+  detail::ReadThumbnail(is, PnmFormat::kPpm, factor, width, height,
+                        pixel_data, filter);
+}
+
+/*!
+See the std::istream overload and the file overload of ReadPgmThumbnail.
+*/
+template <typename AllocatorT>
+void ReadPpmThumbnail(
+    std::string const& filename, std::size_t const factor,
+    std::size_t* const width, std::size_t* const height,
+    std::vector<std::uint8_t, AllocatorT>* const pixel_data,
+    DownscaleFilter const filter = DownscaleFilter::kBox,
+    std::size_t const thread_count = detail::DefaultThreadCount()) {
+  detail::ReadThumbnail(filename, PnmFormat::kPpm, factor, width, height,
+                        pixel_data, filter, thread_count);
+}
+
+}  // namespace thinks
@@ -0,0 +1,349 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_region.h"
+
+namespace thinks {
+
+/*!
+Counters of a TiledPnmImage cache, see TiledPnmImage::stats.
+*/
+struct TileCacheStats {
+  std::uint64_t hits = 0;    //!< Pins of tiles that were cached or loading.
+  std::uint64_t misses = 0;  //!< Pins that loaded a tile from the file.
+  std::uint64_t evictions = 0;
+  std::uint64_t bytes_read = 0;    //!< Bytes of pixel data read from file.
+  std::uint64_t cached_bytes = 0;  //!< Bytes of pixel data currently held.
+  std::size_t pinned_tiles = 0;    //!< Tiles currently pinned.
+};
+
+/*!
+Random access to the pixel data of a large binary image file (magic
+numbers 'P5' to 'P7') through a cache of tiles. The image is divided into
+tiles of tile_width x tile_height pixels, smaller at the right and bottom
+edges, which are read on demand with positioned reads (see
+PnmRegionReader) and kept in a least recently used cache bounded by
+@p memory_limit bytes.
+
+All member functions may be called concurrently. A tile is read from the
+file at most once while it is cached, threads asking for a tile that is
+being loaded wait for that load instead of reading it again.
+
+Tiles are accessed through pins: a TileHandle keeps its tile in memory
+until the handle is unpinned or destroyed. Pinned tiles are never
+evicted, so if more than the memory limit is pinned at once the cache
+exceeds the limit until tiles are unpinned.
+
+Example, reading patches from a huge mosaic on several threads:
+
+  thinks::TiledPnmImage image("mosaic.ppm");
+  // On any thread:
+  auto patch = std::vector<std::uint8_t>(image.RegionSize(region));
+  image.ReadRegion(region, patch.data());
+
+An std::invalid_argument is thrown on construction if:
+  - tile width or height is zero.
+
+An std::runtime_error is thrown on construction as for PnmRegionReader.
+*/
+class TiledPnmImage {
+ private:
+  struct Tile {
+    UninitializedVector<std::uint8_t> pixel_data;
+    std::size_t pin_count = 0;
+    bool loading = true;
+    std::list<std::size_t>::iterator lru_position;
+  };
+
+ public:
+  /*!
+  Pinned tile, unpinned on destruction. Pixel data holds the rows of the
+  tile one after the other, with pixels as stored in the file.
+  */
+  class TileHandle {
+   public:
+    TileHandle() = default;
+    TileHandle(TileHandle&& other) noexcept
+        : image_(other.image_),
+          index_(other.index_),
+          tile_(other.tile_),
+          region_(other.region_) {
+      other.image_ = nullptr;
+    }
+    TileHandle& operator=(TileHandle&& other) noexcept {
+      if (this != &other) {
+        Unpin();
+        image_ = other.image_;
+        index_ = other.index_;
+        tile_ = other.tile_;
+        region_ = other.region_;
+        other.image_ = nullptr;
+      }
+      return *this;
+    }
+
+    TileHandle(TileHandle const&) = delete;
+    TileHandle& operator=(TileHandle const&) = delete;
+
+    ~TileHandle() { Unpin(); }
+
+    //! Release the pin, after which the handle is empty.
+    void Unpin() {
+      if (image_ != nullptr) {
+        image_->Unpin(index_);
+        image_ = nullptr;
+      }
+    }
+
+    explicit operator bool() const { return image_ != nullptr; }
+
+    //! Pixels covered by the tile.
+    PnmRegion const& region() const { return region_; }
+
+    std::uint8_t const* pixel_data() const {
+      return tile_->pixel_data.data();
+    }
+
+   private:
+    friend class TiledPnmImage;
+
+    TileHandle(TiledPnmImage* const image, std::size_t const index,
+               Tile const* const tile, PnmRegion const& region)
+        : image_(image), index_(index), tile_(tile), region_(region) {}
+
+    TiledPnmImage* image_ = nullptr;
+    std::size_t index_ = 0;
+    Tile const* tile_ = nullptr;
+    PnmRegion region_;
+  };
+
+  explicit TiledPnmImage(
+      std::string const& filename, std::size_t const tile_width = 256,
+      std::size_t const tile_height = 256,
+      std::uint64_t const memory_limit = std::uint64_t{256} << 20)
+      : reader_(filename),
+        tile_width_(tile_width),
+        tile_height_(tile_height),
+        memory_limit_(memory_limit) {
+    if (tile_width == 0 || tile_height == 0) {
+      throw std::invalid_argument("tile width and height must be non-zero");
+    }
+    tile_columns_ = (info().width + tile_width - 1) / tile_width;
+    tile_rows_ = (info().height + tile_height - 1) / tile_height;
+  }
+
+  TiledPnmImage(TiledPnmImage const&) = delete;
+  TiledPnmImage& operator=(TiledPnmImage const&) = delete;
+
+  PnmInfo const& info() const { return reader_.info(); }
+  std::size_t pixel_size() const { return reader_.pixel_size(); }
+  std::size_t tile_width() const { return tile_width_; }
+  std::size_t tile_height() const { return tile_height_; }
+  std::size_t tile_columns() const { return tile_columns_; }
+  std::size_t tile_rows() const { return tile_rows_; }
+  std::uint64_t memory_limit() const { return memory_limit_; }
+
+  //! Bytes of pixel data in @p region.
+  std::size_t RegionSize(PnmRegion const& region) const {
+    return reader_.RegionSize(region);
+  }
+
+  /*!
+  Pin the tile in column @p tile_x and row @p tile_y of the tile grid,
+  reading it from the file unless it is cached.
+
+  An std::invalid_argument is thrown if:
+    - the tile is outside the tile grid.
+
+  An std::runtime_error is thrown if the tile cannot be read.
+  */
+  TileHandle Pin(std::size_t const tile_x, std::size_t const tile_y) {
+    if (tile_x >= tile_columns_ || tile_y >= tile_rows_) {
+      auto oss = std::ostringstream{};
+      oss << "tile (" << tile_x << ", " << tile_y << ") is outside "
+          << tile_columns_ << "x" << tile_rows_ << " tiles";
+      throw std::invalid_argument(oss.str());
+    }
+    auto const index = tile_y * tile_columns_ + tile_x;
+    auto const region = TileRegion(tile_x, tile_y);
+    auto const size = RegionSize(region);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      auto const iter = tiles_.find(index);
+      if (iter == tiles_.end()) {
+        break;
+      }
+      auto* const tile = iter->second.get();
+      if (!tile->loading) {
+        ++stats_.hits;
+        PinLocked(tile);
+        return TileHandle(this, index, tile, region);
+      }
+      // Wait for the thread loading the tile, which may fail, in which
+      // case the tile is gone and this thread tries loading it.
+      loaded_.wait(lock);
+    }
+
+    ++stats_.misses;
+    auto& entry = tiles_[index];
+    entry.reset(new Tile);
+    auto* const tile = entry.get();
+    tile->pin_count = 1;
+    ++stats_.pinned_tiles;
+    stats_.cached_bytes += size;
+    EvictLocked();
+    lock.unlock();
+
+    try {
+      tile->pixel_data.resize(size);
+      reader_.Read(region, tile->pixel_data.data());
+    } catch (...) {
+      lock.lock();
+      stats_.cached_bytes -= size;
+      --stats_.pinned_tiles;
+      tiles_.erase(index);
+      lock.unlock();
+      loaded_.notify_all();
+      throw;
+    }
+
+    lock.lock();
+    stats_.bytes_read += size;
+    tile->loading = false;
+    lru_.push_front(index);
+    tile->lru_position = lru_.begin();
+    lock.unlock();
+    loaded_.notify_all();
+    return TileHandle(this, index, tile, region);
+  }
+
+  /*!
+  Read the pixel data of @p region into @p pixel_data, which must have room
+  for RegionSize(region) bytes, through the tiles that overlap the region.
+  Rows of the region are stored one after the other.
+
+  An std::invalid_argument is thrown if:
+    - region width or height is zero.
+    - the region is not inside the image.
+
+  An std::runtime_error is thrown if a tile cannot be read.
+  */
+  void ReadRegion(PnmRegion const& region, std::uint8_t* const pixel_data) {
+    detail::ThrowIfInvalidRegion<std::invalid_argument>(region, info().width,
+                                                         info().height);
+    assert(pixel_data != nullptr && "null pixel data");
+
+    auto const region_row_size = region.width * pixel_size();
+    auto const last_x = region.x + region.width - 1;
+    auto const last_y = region.y + region.height - 1;
+    for (auto ty = region.y / tile_height_; ty <= last_y / tile_height_;
+         ++ty) {
+      for (auto tx = region.x / tile_width_; tx <= last_x / tile_width_;
+           ++tx) {
+        auto const tile = Pin(tx, ty);
+        auto const& tile_region = tile.region();
+        auto const x0 = std::max(region.x, tile_region.x);
+        auto const x1 = std::min(last_x, tile_region.x + tile_region.width - 1);
+        auto const y0 = std::max(region.y, tile_region.y);
+        auto const y1 =
+            std::min(last_y, tile_region.y + tile_region.height - 1);
+        auto const tile_row_size = tile_region.width * pixel_size();
+        auto const copy_size = (x1 - x0 + 1) * pixel_size();
+        for (auto y = y0; y <= y1; ++y) {
+          std::memcpy(pixel_data + (y - region.y) * region_row_size +
+                          (x0 - region.x) * pixel_size(),
+                      tile.pixel_data() + (y - tile_region.y) * tile_row_size +
+                          (x0 - tile_region.x) * pixel_size(),
+                      copy_size);
+        }
+      }
+    }
+  }
+
+  TileCacheStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+ private:
+  PnmRegion TileRegion(std::size_t const tile_x,
+                       std::size_t const tile_y) const {
+    auto region = PnmRegion{};
+    region.x = tile_x * tile_width_;
+    region.y = tile_y * tile_height_;
+    region.width = std::min(tile_width_, info().width - region.x);
+    region.height = std::min(tile_height_, info().height - region.y);
+    return region;
+  }
+
+  // Must be called with the mutex locked.
+  void PinLocked(Tile* const tile) {
+    if (tile->pin_count++ == 0) {
+      ++stats_.pinned_tiles;
+    }
+    lru_.splice(lru_.begin(), lru_, tile->lru_position);
+  }
+
+  void Unpin(std::size_t const index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* const tile = tiles_.at(index).get();
+    assert(tile->pin_count > 0 && "tile not pinned");
+    if (--tile->pin_count == 0) {
+      --stats_.pinned_tiles;
+      EvictLocked();
+    }
+  }
+
+  // Evict unpinned tiles, least recently used first, until the cache fits
+  // in the memory limit or only pinned tiles remain. Must be called with
+  // the mutex locked.
+  void EvictLocked() {
+    auto iter = lru_.end();
+    while (stats_.cached_bytes > memory_limit_ && iter != lru_.begin()) {
+      --iter;
+      auto const tile_iter = tiles_.find(*iter);
+      if (tile_iter->second->pin_count > 0) {
+        continue;
+      }
+      stats_.cached_bytes -= tile_iter->second->pixel_data.size();
+      ++stats_.evictions;
+      tiles_.erase(tile_iter);
+      iter = lru_.erase(iter);
+    }
+  }
+
+  PnmRegionReader const reader_;
+  std::size_t const tile_width_;
+  std::size_t const tile_height_;
+  std::uint64_t const memory_limit_;
+  std::size_t tile_columns_ = 0;
+  std::size_t tile_rows_ = 0;
+
+  mutable std::mutex mutex_;
+  std::condition_variable loaded_;
+  std::unordered_map<std::size_t, std::unique_ptr<Tile>> tiles_;
+  std::list<std::size_t> lru_;  // Loaded tiles, most recently used first.
+  TileCacheStats stats_;
+};
+
+}  // namespace thinks
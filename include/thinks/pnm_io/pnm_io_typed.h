@@ -0,0 +1,345 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_layout.h"
+#include "thinks/pnm_io/pnm_io_simd.h"
+
+namespace thinks {
+
+/*!
+Typed pixels for ReadImage and WriteImage. Samples are in native byte
+order and pixels are tightly packed, so a vector of pixels has the same
+memory layout as the interleaved samples of the other read and write
+functions.
+*/
+struct Gray8 {
+  std::uint8_t value;
+};
+
+struct Gray16 {
+  std::uint16_t value;
+};
+
+struct Rgb8 {
+  std::uint8_t r;
+  std::uint8_t g;
+  std::uint8_t b;
+};
+
+struct Rgb16 {
+  std::uint16_t r;
+  std::uint16_t g;
+  std::uint16_t b;
+};
+
+struct Rgba8 {
+  std::uint8_t r;
+  std::uint8_t g;
+  std::uint8_t b;
+  std::uint8_t a;
+};
+
+/*!
+Sample type and channel count of a typed pixel. Specialize for other
+pixel types with the same memory layout as Gray8 to Rgba8, i.e. tightly
+packed samples without padding.
+*/
+template <typename PixelT>
+struct PixelTraits;
+
+template <>
+struct PixelTraits<Gray8> {
+  using SampleType = std::uint8_t;
+  static constexpr std::size_t ChannelCount() { return 1; }
+};
+
+template <>
+struct PixelTraits<Gray16> {
+  using SampleType = std::uint16_t;
+  static constexpr std::size_t ChannelCount() { return 1; }
+};
+
+template <>
+struct PixelTraits<Rgb8> {
+  using SampleType = std::uint8_t;
+  static constexpr std::size_t ChannelCount() { return 3; }
+};
+
+template <>
+struct PixelTraits<Rgb16> {
+  using SampleType = std::uint16_t;
+  static constexpr std::size_t ChannelCount() { return 3; }
+};
+
+template <>
+struct PixelTraits<Rgba8> {
+  using SampleType = std::uint8_t;
+  static constexpr std::size_t ChannelCount() { return 4; }
+};
+
+/*!
+Magic number and channel count of a file format.
+*/
+template <PnmFormat FormatT>
+struct FormatTraits;
+
+template <>
+struct FormatTraits<PnmFormat::kPgm> {
+  static constexpr std::size_t ChannelCount() { return 1; }
+  static constexpr char MagicDigit() { return '5'; }
+};
+
+template <>
+struct FormatTraits<PnmFormat::kPpm> {
+  static constexpr std::size_t ChannelCount() { return 3; }
+  static constexpr char MagicDigit() { return '6'; }
+};
+
+namespace detail {
+
+template <typename PixelT>
+struct IsPackedPixel
+    : std::integral_constant<
+          bool, std::is_standard_layout<PixelT>::value &&
+                    sizeof(PixelT) ==
+                        PixelTraits<PixelT>::ChannelCount() *
+                            sizeof(typename PixelTraits<PixelT>::SampleType)> {
+};
+
+template <typename PixelT>
+using PixelSampleType = typename PixelTraits<PixelT>::SampleType;
+
+// Pixel layout that converts stored pixels of a format to PixelT.
+template <typename PixelT>
+constexpr PixelLayout TypedLayout() {
+  return PixelTraits<PixelT>::ChannelCount() == 1
+             ? PixelLayout::kGrey
+             : PixelTraits<PixelT>::ChannelCount() == 3 ? PixelLayout::kRgb
+                                                        : PixelLayout::kRgba;
+}
+
+template <PnmFormat FormatT, typename PixelT>
+void CheckTypedRead() {
+  static_assert(IsPackedPixel<PixelT>::value, "pixel must be tightly packed");
+  static_assert(PixelTraits<PixelT>::ChannelCount() ==
+                        FormatTraits<FormatT>::ChannelCount() ||
+                    sizeof(PixelSampleType<PixelT>) == 1,
+                "channel conversion is only supported for 8-bit pixels");
+}
+
+template <PnmFormat FormatT, typename PixelT>
+void CheckTypedWrite() {
+  static_assert(IsPackedPixel<PixelT>::value, "pixel must be tightly packed");
+  static_assert(PixelTraits<PixelT>::ChannelCount() ==
+                        FormatTraits<FormatT>::ChannelCount() ||
+                    (PixelTraits<PixelT>::ChannelCount() == 4 &&
+                     FormatTraits<FormatT>::ChannelCount() == 3 &&
+                     sizeof(PixelSampleType<PixelT>) == 1),
+                "pixel channels must match the format, or be RGBA for PPM");
+}
+
+template <PnmFormat FormatT, typename PixelT, typename AllocatorT>
+void ReadTypedImage(std::istream& is, std::size_t* const width,
+                    std::size_t* const height,
+                    std::vector<PixelT, AllocatorT>* const pixel_data,
+                    std::uint32_t* const max_value) {
+  CheckTypedRead<FormatT, PixelT>();
+  using SampleT = PixelSampleType<PixelT>;
+  constexpr auto kStoredChannels = FormatTraits<FormatT>::ChannelCount();
+  constexpr auto kChannels = PixelTraits<PixelT>::ChannelCount();
+
+  auto timer = PhaseTimer(false);
+  auto const header = ReadHeader(is);
+  if (header.magic_number.size() != 2 || header.magic_number[0] != 'P' ||
+      header.magic_number[1] != FormatTraits<FormatT>::MagicDigit()) {
+    ThrowIfInvalidMagicNumber<std::runtime_error>(header.magic_number,
+                                                  MagicNumber(FormatT));
+  }
+  if (sizeof(SampleT) == 1) {
+    ThrowIfMaxValueExceeds8Bit<std::runtime_error>(header.max_value);
+  }
+  assert(width != nullptr && "null width");
+  assert(height != nullptr && "null height");
+  *width = header.width;
+  *height = header.height;
+  if (max_value != nullptr) {
+    *max_value = header.max_value;
+  }
+  timer.Mark(IoPhase::kHeader);
+
+  assert(pixel_data != nullptr && "null pixel data");
+  auto const pixel_count = header.width * header.height;
+  pixel_data->resize(pixel_count);
+  timer.Mark(IoPhase::kAllocate, pixel_count * sizeof(PixelT));
+  auto* const samples = reinterpret_cast<SampleT*>(pixel_data->data());
+  if (kChannels != kStoredChannels) {
+    ReadPixelDataLayout(is, kStoredChannels, TypedLayout<PixelT>(),
+                        static_cast<std::uint8_t>(header.max_value),
+                        pixel_count,
+                        reinterpret_cast<std::uint8_t*>(samples));
+    timer.Mark(IoPhase::kRaster, pixel_count * kStoredChannels);
+  } else if (sizeof(SampleT) == 1) {
+    ReadPixelData(is, reinterpret_cast<std::uint8_t*>(samples),
+                  pixel_count * kChannels);
+    timer.Mark(IoPhase::kRaster, pixel_count * kChannels);
+  } else {
+    ReadSamples16(is, header.max_value, SampleScaling::kNone,
+                  reinterpret_cast<std::uint16_t*>(samples),
+                  pixel_count * kChannels, &timer);
+  }
+}
+
+template <PnmFormat FormatT, typename PixelT>
+void WriteTypedImage(std::ostream& os, std::size_t const width,
+                     std::size_t const height, PixelT const* const pixel_data,
+                     std::uint32_t const max_value) {
+  CheckTypedWrite<FormatT, PixelT>();
+  using SampleT = PixelSampleType<PixelT>;
+  constexpr auto kStoredChannels = FormatTraits<FormatT>::ChannelCount();
+  constexpr auto kChannels = PixelTraits<PixelT>::ChannelCount();
+
+  auto timer = PhaseTimer(true);
+  auto header = Header{};
+  header.magic_number = MagicNumber(FormatT);
+  header.width = width;
+  header.height = height;
+  header.max_value = max_value;
+  if (sizeof(SampleT) == 1) {
+    ThrowIfMaxValueExceeds8Bit<std::invalid_argument>(max_value);
+  }
+  WriteHeader(os, header);
+  timer.Mark(IoPhase::kHeader);
+
+  auto const pixel_count = width * height;
+  auto const* const samples = reinterpret_cast<SampleT const*>(pixel_data);
+  if (kChannels != kStoredChannels) {
+    // RGBA to RGB, dropping alpha one cache-sized block at a time.
+    std::uint8_t block[3 * kSampleBlockSize];
+    for (auto i = std::size_t{0}; i < pixel_count; i += kSampleBlockSize) {
+      auto const n = pixel_count - i < kSampleBlockSize ? pixel_count - i
+                                                        : kSampleBlockSize;
+      RgbaToRgb(reinterpret_cast<std::uint8_t const*>(samples) + 4 * i, block,
+                n);
+      WritePixelData(os, block, 3 * n);
+    }
+    timer.Mark(IoPhase::kRaster, pixel_count * kStoredChannels);
+  } else if (sizeof(SampleT) == 1) {
+    WritePixelData(os, reinterpret_cast<std::uint8_t const*>(samples),
+                   pixel_count * kChannels);
+    timer.Mark(IoPhase::kRaster, pixel_count * kChannels);
+  } else {
+    WriteSamples16(os, max_value,
+                   reinterpret_cast<std::uint16_t const*>(samples),
+                   pixel_count * kChannels);
+    timer.Mark(IoPhase::kRaster,
+               pixel_count * kChannels * BytesPerSample(max_value));
+  }
+}
+
+}  // namespace detail
+
+/*!
+Read a binary image of format @p FormatT into typed pixels, where the
+channel count, sample width and magic number are resolved at compile
+time. For instance:
+
+  auto pixels = std::vector<thinks::Rgb8>{};
+  thinks::ReadImage<thinks::PnmFormat::kPpm>("image.ppm", &width, &height,
+                                             &pixels);
+
+Pixels with the channel count of the format are read as stored. 8-bit
+pixels may also have a different channel count, in which case samples
+are converted while they are read as for PixelLayout: Gray8 from PPM
+gives luma, Rgb8 from PGM replicates samples and Rgba8 gets an alpha
+equal to the max value. Other combinations do not compile.
+
+An std::runtime_error is thrown if:
+  - the magic number does not match the format.
+  - width or height is zero.
+  - the max value is not in the range [1, 255] for 8-bit pixels, or
+    [1, 65535] for 16-bit pixels.
+  - the pixel data cannot be read.
+*/
+template <PnmFormat FormatT, typename PixelT, typename AllocatorT>
+void ReadImage(std::istream& is, std::size_t* const width,
+               std::size_t* const height,
+               std::vector<PixelT, AllocatorT>* const pixel_data,
+               std::uint32_t* const max_value = nullptr) {
+  detail::ReadTypedImage<FormatT>(is, width, height, pixel_data, max_value);
+}
+
+/*!
+See std::istream overload version.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+template <PnmFormat FormatT, typename PixelT, typename AllocatorT>
+void ReadImage(std::string const& filename, std::size_t* const width,
+               std::size_t* const height,
+               std::vector<PixelT, AllocatorT>* const pixel_data,
+               std::uint32_t* const max_value = nullptr) {
+  auto timer = detail::PhaseTimer(false);
+  auto ifs = std::ifstream{};
+  detail::OpenFileStream(&ifs, filename);
+  timer.Mark(IoPhase::kOpen);
+  ReadImage<FormatT>(ifs, width, height, pixel_data, max_value);
+  timer.Restart();
+  ifs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+/*!
+Write typed pixels as a binary image of format @p FormatT, see ReadImage.
+Pixels must have the channel count of the format, except that Rgba8
+pixels may be written as PPM, dropping alpha. The max value defaults to
+the largest sample value of the pixel type.
+
+An std::invalid_argument is thrown if:
+  - width or height is zero.
+  - the max value is not in the range [1, 255] for 8-bit pixels, or
+    [1, 65535] for 16-bit pixels.
+*/
+template <PnmFormat FormatT, typename PixelT>
+void WriteImage(std::ostream& os, std::size_t const width,
+                std::size_t const height, PixelT const* const pixel_data,
+                std::uint32_t const max_value = std::numeric_limits<
+                    typename PixelTraits<PixelT>::SampleType>::max()) {
+  detail::WriteTypedImage<FormatT>(os, width, height, pixel_data, max_value);
+}
+
+/*!
+See std::ostream overload version above.
+
+Throws an std::runtime_error if file cannot be opened.
+*/
+template <PnmFormat FormatT, typename PixelT>
+void WriteImage(std::string const& filename, std::size_t const width,
+                std::size_t const height, PixelT const* const pixel_data,
+                std::uint32_t const max_value = std::numeric_limits<
+                    typename PixelTraits<PixelT>::SampleType>::max()) {
+  auto timer = detail::PhaseTimer(true);
+  auto ofs = std::ofstream{};
+  detail::OpenFileStream(&ofs, filename);
+  timer.Mark(IoPhase::kOpen);
+  WriteImage<FormatT>(ofs, width, height, pixel_data, max_value);
+  timer.Restart();
+  ofs.close();
+  timer.Mark(IoPhase::kClose);
+}
+
+}  // namespace thinks
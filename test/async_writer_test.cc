@@ -0,0 +1,132 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_async.h"
+
+TEST_CASE("ASYNC WRITER - Zero max queued throws") {
+  REQUIRE_THROWS_MATCHES(
+      thinks::AsyncPnmWriter(0), std::invalid_argument,
+      ExceptionContentMatcher("max queued must be non-zero"));
+}
+
+TEST_CASE("ASYNC WRITER - Invalid width throws") {
+  thinks::AsyncPnmWriter writer;
+  auto const pixel_data = GradientPixelData(10, 0);
+  REQUIRE_THROWS_MATCHES(
+      writer.WritePgmImage("async_writer_test.pgm", 0, 10, pixel_data.data()),
+      std::invalid_argument, ExceptionContentMatcher("width must be non-zero"));
+}
+
+TEST_CASE("ASYNC WRITER - Pixel data size mismatch throws") {
+  thinks::AsyncPnmWriter writer;
+  REQUIRE_THROWS_MATCHES(
+      writer.WritePpmImage("async_writer_test.ppm", 4, 4,
+                           std::vector<std::uint8_t>(4 * 4)),
+      std::invalid_argument,
+      ExceptionContentMatcher("pixel data must hold 48 bytes, has 16"));
+}
+
+TEST_CASE("ASYNC WRITER - Error is reported on next call") {
+  thinks::AsyncPnmWriter writer(1);
+  auto const pixel_data = GradientPixelData(4 * 4, 0);
+  writer.WritePgmImage(std::string{}, 4, 4, pixel_data.data());
+
+  // Not checking error message since it is OS dependent.
+  REQUIRE_THROWS_AS(writer.Flush(), std::runtime_error);
+  REQUIRE_NOTHROW(writer.Flush());
+}
+
+#if defined(__linux__)
+TEST_CASE("ASYNC WRITER - Short write is reported") {
+  // Writes to /dev/full fail with ENOSPC once the stream buffer is flushed.
+  thinks::AsyncPnmWriter writer(1);
+  auto const pixel_data = GradientPixelData(1024 * 1024 * 3, 0);
+  writer.WritePpmImage("/dev/full", 1024, 1024, pixel_data.data());
+  REQUIRE_THROWS_MATCHES(
+      writer.Flush(), std::runtime_error,
+      ExceptionContentMatcher("cannot write file '/dev/full'"));
+}
+#endif
+
+TEST_CASE("ASYNC WRITER - Write images") {
+  auto constexpr width = std::size_t{21};
+  auto constexpr height = std::size_t{13};
+  auto constexpr image_count = std::size_t{10};
+  auto filenames = std::vector<std::string>{};
+  auto expected_pixels = std::vector<std::vector<std::uint8_t>>{};
+  {
+    thinks::AsyncPnmWriter writer(1);
+    for (auto i = std::size_t{0}; i < image_count; ++i) {
+      auto const is_ppm = i % 2 == 0;
+      auto filename = "async_writer_test_" + std::to_string(i) +
+                      (is_ppm ? ".ppm" : ".pgm");
+      auto pixel_data =
+          GradientPixelData(width * height * (is_ppm ? 3 : 1), i);
+      expected_pixels.push_back(pixel_data);
+      filenames.push_back(filename);
+
+      // Alternate between copying and moving pixel data, overwriting the
+      // copied buffer right away.
+      if (i % 3 == 0) {
+        if (is_ppm) {
+          writer.WritePpmImage(filename, width, height, std::move(pixel_data));
+        } else {
+          writer.WritePgmImage(filename, width, height, std::move(pixel_data));
+        }
+      } else {
+        if (is_ppm) {
+          writer.WritePpmImage(filename, width, height, pixel_data.data());
+        } else {
+          writer.WritePgmImage(filename, width, height, pixel_data.data());
+        }
+        std::fill(pixel_data.begin(), pixel_data.end(), std::uint8_t{0});
+      }
+    }
+    writer.Flush();
+  }
+
+  for (auto i = std::size_t{0}; i < image_count; ++i) {
+    auto read_width = std::size_t{0};
+    auto read_height = std::size_t{0};
+    auto read_pixels = std::vector<std::uint8_t>{};
+    if (i % 2 == 0) {
+      thinks::ReadPpmImage(filenames[i], &read_width, &read_height,
+                           &read_pixels);
+    } else {
+      thinks::ReadPgmImage(filenames[i], &read_width, &read_height,
+                           &read_pixels);
+    }
+    REQUIRE(read_width == width);
+    REQUIRE(read_height == height);
+    REQUIRE(read_pixels == expected_pixels[i]);
+    std::remove(filenames[i].c_str());
+  }
+}
+
+TEST_CASE("ASYNC WRITER - Destructor writes queued images") {
+  auto const filename = std::string{"async_writer_test_destructor.pgm"};
+  auto const pixel_data = GradientPixelData(8 * 8, 0);
+  {
+    thinks::AsyncPnmWriter writer(4);
+    writer.WritePgmImage(filename, 8, 8, pixel_data.data());
+  }
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPgmImage(filename, &width, &height, &read_pixels);
+  REQUIRE(read_pixels == pixel_data);
+  std::remove(filename.c_str());
+}
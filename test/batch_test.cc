@@ -0,0 +1,170 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_batch.h"
+
+namespace {
+
+// Writes images alternating between PGM and PPM, removed on destruction.
+class TestFiles {
+ public:
+  explicit TestFiles(std::size_t const count) {
+    for (auto i = std::size_t{0}; i < count; ++i) {
+      auto const width = 10 + i;
+      auto const height = 3 + i % 4;
+      auto const is_ppm = i % 2 == 1;
+      auto filename = "batch_test_" + std::to_string(i) +
+                      (is_ppm ? ".ppm" : ".pgm");
+      auto pixel_data = GradientPixelData(width * height * (is_ppm ? 3 : 1), i);
+      if (is_ppm) {
+        thinks::WritePpmImage(filename, width, height, pixel_data.data());
+      } else {
+        thinks::WritePgmImage(filename, width, height, pixel_data.data());
+      }
+      filenames.push_back(filename);
+      pixels.push_back(pixel_data);
+    }
+  }
+
+  ~TestFiles() {
+    for (auto const& filename : filenames) {
+      std::remove(filename.c_str());
+    }
+  }
+
+  std::vector<std::string> filenames;
+  std::vector<std::vector<std::uint8_t>> pixels;
+};
+
+std::vector<std::vector<std::uint8_t>> LoadAll(
+    std::vector<std::string> const& filenames,
+    thinks::BatchLoadOptions const& options,
+    thinks::BatchLoadReport* const report) {
+  auto loaded = std::vector<std::vector<std::uint8_t>>(filenames.size());
+  std::mutex mutex;
+  *report = thinks::LoadPnmImages(
+      filenames,
+      [&](thinks::BatchImage const& image) {
+        std::lock_guard<std::mutex> lock(mutex);
+        loaded[image.index].assign(
+            image.pixel_data, image.pixel_data + image.pixel_data_size);
+      },
+      options);
+  return loaded;
+}
+
+}  // namespace
+
+TEST_CASE("BATCH - Zero concurrency throws") {
+  auto options = thinks::BatchLoadOptions{};
+  options.concurrency = 0;
+  REQUIRE_THROWS_MATCHES(
+      thinks::LoadPnmImages(std::vector<std::string>{},
+                            [](thinks::BatchImage const&) {}, options),
+      std::invalid_argument,
+      ExceptionContentMatcher("concurrency must be non-zero"));
+}
+
+TEST_CASE("BATCH - Unsupported magic number throws") {
+  auto const filename = std::string{"batch_test.pbm"};
+  auto const pixel_data = std::vector<std::uint8_t>(4 * 4, 255);
+  thinks::WritePbmImage(filename, 4, 4, pixel_data.data());
+
+  for (auto const backend :
+       {thinks::BatchBackend::kThreadPool, thinks::BatchBackend::kIoUring}) {
+    auto options = thinks::BatchLoadOptions{};
+    options.backend = backend;
+    REQUIRE_THROWS_MATCHES(
+        thinks::LoadPnmImages(std::vector<std::string>{filename},
+                              [](thinks::BatchImage const&) {}, options),
+        std::runtime_error,
+        ExceptionContentMatcher("unsupported magic number 'P4'"));
+  }
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("BATCH - Callback exception is rethrown") {
+  TestFiles const files(8);
+  for (auto const backend :
+       {thinks::BatchBackend::kThreadPool, thinks::BatchBackend::kIoUring}) {
+    auto options = thinks::BatchLoadOptions{};
+    options.backend = backend;
+    options.concurrency = 3;
+    REQUIRE_THROWS_MATCHES(
+        thinks::LoadPnmImages(files.filenames,
+                              [](thinks::BatchImage const& image) {
+                                if (image.index == 5) {
+                                  throw std::runtime_error("callback error");
+                                }
+                              },
+                              options),
+        std::runtime_error, ExceptionContentMatcher("callback error"));
+  }
+}
+
+TEST_CASE("BATCH - Load images") {
+  TestFiles const files(23);
+  for (auto const backend :
+       {thinks::BatchBackend::kThreadPool, thinks::BatchBackend::kIoUring}) {
+    auto options = thinks::BatchLoadOptions{};
+    options.backend = backend;
+    options.concurrency = 4;
+    auto report = thinks::BatchLoadReport{};
+    auto const loaded = LoadAll(files.filenames, options, &report);
+
+    REQUIRE(loaded == files.pixels);
+    REQUIRE(report.image_count == files.filenames.size());
+    auto byte_count = std::uint64_t{0};
+    for (auto const& pixel_data : files.pixels) {
+      byte_count += pixel_data.size();
+    }
+    REQUIRE(report.byte_count == byte_count);
+    REQUIRE(report.megabytes_per_second() >= 0);
+#if defined(THINKS_PNM_IO_IO_URING)
+    REQUIRE((report.backend == backend ||
+             report.backend == thinks::BatchBackend::kThreadPool));
+#else
+    REQUIRE(report.backend == thinks::BatchBackend::kThreadPool);
+#endif
+  }
+}
+
+TEST_CASE("BATCH - Memory limit bounds images held") {
+  TestFiles const files(12);
+  for (auto const backend :
+       {thinks::BatchBackend::kThreadPool, thinks::BatchBackend::kIoUring}) {
+    auto options = thinks::BatchLoadOptions{};
+    options.backend = backend;
+    options.concurrency = 6;
+    options.memory_limit = 1;  // Smaller than any image.
+
+    std::atomic<int> held(0);
+    std::atomic<int> max_held(0);
+    std::atomic<std::size_t> loaded_count(0);
+    thinks::LoadPnmImages(
+        files.filenames,
+        [&](thinks::BatchImage const&) {
+          auto const now_held = ++held;
+          if (now_held > max_held) {
+            max_held = now_held;
+          }
+          ++loaded_count;
+          --held;
+        },
+        options);
+    REQUIRE(loaded_count == files.filenames.size());
+    REQUIRE(max_held == 1);
+  }
+}
@@ -4,9 +4,12 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "catch2/catch.hpp"
 
@@ -26,3 +29,14 @@ struct ExceptionContentMatcher : Catch::MatcherBase<std::exception> {
  private:
   std::string target_;
 };
+
+// Test pixel data where sample i is (i + offset) % 251. The period is a
+// prime, so rows and channels of most image sizes differ.
+inline std::vector<std::uint8_t> GradientPixelData(
+    std::size_t const size, std::size_t const offset = 0) {
+  auto pixel_data = std::vector<std::uint8_t>(size);
+  for (auto i = std::size_t{0}; i < pixel_data.size(); ++i) {
+    pixel_data[i] = static_cast<std::uint8_t>((i + offset) % 251);
+  }
+  return pixel_data;
+}
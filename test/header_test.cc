@@ -0,0 +1,106 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+
+TEST_CASE("HEADER - Read truncated header throws") {
+  auto iss = std::istringstream("P6\n10 10");
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPpmImage(iss, &width, &height, &pixel_data),
+      std::runtime_error, ExceptionContentMatcher("unexpected end of header"));
+}
+
+TEST_CASE("HEADER - Read invalid character throws") {
+  auto iss = std::istringstream("P5\n10 -10\n255\n");
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPgmImage(iss, &width, &height, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("unexpected character in header: '-'"));
+}
+
+TEST_CASE("HEADER - Read width overflow throws") {
+  auto iss = std::istringstream("P5\n123456789012345678901234567890 1\n255\n");
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPgmImage(iss, &width, &height, &pixel_data),
+      std::runtime_error, ExceptionContentMatcher("width is too large"));
+}
+
+TEST_CASE("HEADER - Read image size overflow throws") {
+  auto oss = std::ostringstream{};
+  auto const max_size = std::numeric_limits<std::size_t>::max();
+  oss << "P6\n" << max_size / 4 << " 2\n255\n";
+  auto iss = std::istringstream(oss.str());
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPpmImage(iss, &width, &height, &pixel_data),
+      std::runtime_error, ExceptionContentMatcher("image is too large"));
+}
+
+TEST_CASE("HEADER - Read comments") {
+  auto ss = std::stringstream{};
+  ss << "P5# Comment after the magic number.\n"
+     << "# Full line comment.\n"
+     << "3 #Between width and height.\r"
+     << "1\n"
+     << "255\n"
+     << "\x01\x02\x03";
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  thinks::ReadPgmImage(ss, &width, &height, &pixel_data);
+  REQUIRE(width == 3);
+  REQUIRE(height == 1);
+  REQUIRE(pixel_data == std::vector<std::uint8_t>{1, 2, 3});
+}
+
+TEST_CASE("HEADER - Read single whitespace before pixel data") {
+  // The first pixel values are whitespace characters, only the first
+  // whitespace character after the max value belongs to the header.
+  auto ss = std::stringstream{};
+  ss << "P5 4 1 255\t" << "\n\n \x07";
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  thinks::ReadPgmImage(ss, &width, &height, &pixel_data);
+  REQUIRE(pixel_data == std::vector<std::uint8_t>{'\n', '\n', ' ', 7});
+}
+
+TEST_CASE("HEADER - Read header from buffer") {
+  auto const header_text = std::string{"P6\n# Comment.\n640 480\n65535\n"};
+  auto const text = header_text + "\x01\x02\x03";  // Start of pixel data.
+  auto header_size = std::size_t{0};
+  auto const header =
+      thinks::detail::ReadHeader(text.data(), text.size(), &header_size);
+  REQUIRE(header.magic_number == "P6");
+  REQUIRE(header.width == 640);
+  REQUIRE(header.height == 480);
+  REQUIRE(header.max_value == 65535);
+  REQUIRE(header_size == header_text.size());
+}
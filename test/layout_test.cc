@@ -0,0 +1,177 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_layout.h"
+
+namespace {
+
+// Large enough to span several conversion blocks, with a partial block and
+// a pixel count that is not a multiple of the vector width.
+constexpr auto kWidth = std::size_t{97};
+constexpr auto kHeight = std::size_t{53};
+
+// Samples cycle through the full range [0, 255].
+std::vector<std::uint8_t> FullRangePixelData(std::size_t const size) {
+  auto pixel_data = std::vector<std::uint8_t>(size);
+  for (auto i = std::size_t{0}; i < pixel_data.size(); ++i) {
+    pixel_data[i] = static_cast<std::uint8_t>((i * 7) % 256);
+  }
+  return pixel_data;
+}
+
+template <typename T>
+std::vector<T> ReadPpm(std::string const& data,
+                       thinks::PixelLayout const layout) {
+  auto iss = std::istringstream(data);
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<T>{};
+  thinks::ReadPpmImage(iss, &width, &height, &pixel_data, layout);
+  REQUIRE(width == kWidth);
+  REQUIRE(height == kHeight);
+  return pixel_data;
+}
+
+template <typename T>
+std::vector<T> ReadPgm(std::string const& data,
+                       thinks::PixelLayout const layout) {
+  auto iss = std::istringstream(data);
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<T>{};
+  thinks::ReadPgmImage(iss, &width, &height, &pixel_data, layout);
+  REQUIRE(width == kWidth);
+  REQUIRE(height == kHeight);
+  return pixel_data;
+}
+
+}  // namespace
+
+TEST_CASE("LAYOUT - Planar PGM throws") {
+  auto const stored = FullRangePixelData(kWidth * kHeight);
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, kWidth, kHeight, stored.data());
+  REQUIRE_THROWS_MATCHES(
+      ReadPgm<std::uint8_t>(oss.str(), thinks::PixelLayout::kPlanar),
+      std::invalid_argument,
+      ExceptionContentMatcher("planar layout requires RGB pixel data"));
+}
+
+TEST_CASE("LAYOUT - PPM layouts") {
+  auto const pixel_count = kWidth * kHeight;
+  auto const stored = FullRangePixelData(pixel_count * 3);
+  auto oss = std::ostringstream{};
+  thinks::WritePpmImage(oss, kWidth, kHeight, stored.data());
+  auto const data = oss.str();
+
+  REQUIRE(ReadPpm<std::uint8_t>(data, thinks::PixelLayout::kStored) ==
+          stored);
+  REQUIRE(ReadPpm<std::uint8_t>(data, thinks::PixelLayout::kRgb) == stored);
+
+  auto planar = std::vector<std::uint8_t>(pixel_count * 3);
+  auto grey = std::vector<std::uint8_t>(pixel_count);
+  auto rgba = std::vector<std::uint8_t>(pixel_count * 4);
+  for (auto i = std::size_t{0}; i < pixel_count; ++i) {
+    auto const r = stored[3 * i];
+    auto const g = stored[3 * i + 1];
+    auto const b = stored[3 * i + 2];
+    planar[i] = r;
+    planar[pixel_count + i] = g;
+    planar[2 * pixel_count + i] = b;
+    grey[i] = static_cast<std::uint8_t>((77 * r + 150 * g + 29 * b + 128) >> 8);
+    rgba[4 * i] = r;
+    rgba[4 * i + 1] = g;
+    rgba[4 * i + 2] = b;
+    rgba[4 * i + 3] = 255;
+  }
+  REQUIRE(ReadPpm<std::uint8_t>(data, thinks::PixelLayout::kPlanar) ==
+          planar);
+  REQUIRE(ReadPpm<std::uint8_t>(data, thinks::PixelLayout::kGrey) == grey);
+  REQUIRE(ReadPpm<std::uint8_t>(data, thinks::PixelLayout::kRgba) == rgba);
+}
+
+TEST_CASE("LAYOUT - PGM layouts") {
+  auto const pixel_count = kWidth * kHeight;
+  auto const stored = FullRangePixelData(pixel_count);
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, kWidth, kHeight, stored.data());
+  auto const data = oss.str();
+
+  REQUIRE(ReadPgm<std::uint8_t>(data, thinks::PixelLayout::kGrey) == stored);
+
+  auto rgb = std::vector<std::uint8_t>(pixel_count * 3);
+  auto rgba = std::vector<std::uint8_t>(pixel_count * 4);
+  for (auto i = std::size_t{0}; i < pixel_count; ++i) {
+    for (auto c = std::size_t{0}; c < 3; ++c) {
+      rgb[3 * i + c] = stored[i];
+      rgba[4 * i + c] = stored[i];
+    }
+    rgba[4 * i + 3] = 255;
+  }
+  REQUIRE(ReadPgm<std::uint8_t>(data, thinks::PixelLayout::kRgb) == rgb);
+  REQUIRE(ReadPgm<std::uint8_t>(data, thinks::PixelLayout::kRgba) == rgba);
+}
+
+TEST_CASE("LAYOUT - Normalized float") {
+  auto const pixel_count = kWidth * kHeight;
+  auto const stored = FullRangePixelData(pixel_count * 3);
+  auto oss = std::ostringstream{};
+  thinks::WritePpmImage(oss, kWidth, kHeight, stored.data());
+  auto const data = oss.str();
+
+  auto const floats = ReadPpm<float>(data, thinks::PixelLayout::kStored);
+  REQUIRE(floats.size() == stored.size());
+  for (auto i = std::size_t{0}; i < stored.size(); ++i) {
+    REQUIRE(floats[i] == Approx(stored[i] / 255.F));
+  }
+
+  auto const planar = ReadPpm<float>(data, thinks::PixelLayout::kPlanar);
+  auto const grey = ReadPpm<float>(data, thinks::PixelLayout::kGrey);
+  auto const rgba = ReadPpm<float>(data, thinks::PixelLayout::kRgba);
+  for (auto i = std::size_t{0}; i < pixel_count; ++i) {
+    auto const r = floats[3 * i];
+    auto const g = floats[3 * i + 1];
+    auto const b = floats[3 * i + 2];
+    REQUIRE(planar[i] == r);
+    REQUIRE(planar[pixel_count + i] == g);
+    REQUIRE(planar[2 * pixel_count + i] == b);
+    REQUIRE(grey[i] == Approx(0.299F * r + 0.587F * g + 0.114F * b));
+    REQUIRE(rgba[4 * i + 2] == b);
+    REQUIRE(rgba[4 * i + 3] == 1.F);
+  }
+}
+
+TEST_CASE("LAYOUT - Normalized float 16-bit") {
+  auto const pixel_count = kWidth * kHeight;
+  auto stored = std::vector<std::uint16_t>(pixel_count);
+  for (auto i = std::size_t{0}; i < stored.size(); ++i) {
+    stored[i] = static_cast<std::uint16_t>((i * 37) % 1001);
+  }
+  auto const filename = std::string{"layout_test.pgm"};
+  thinks::WritePgmImage(filename, kWidth, kHeight, stored.data(), 1000);
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto max_value = std::uint32_t{0};
+  auto pixel_data = std::vector<float>{};
+  thinks::ReadPgmImage(filename, &width, &height, &pixel_data,
+                       thinks::PixelLayout::kRgb, &max_value);
+  REQUIRE(max_value == 1000);
+  REQUIRE(pixel_data.size() == pixel_count * 3);
+  for (auto i = std::size_t{0}; i < pixel_count; ++i) {
+    REQUIRE(pixel_data[3 * i] == Approx(stored[i] / 1000.F));
+    REQUIRE(pixel_data[3 * i + 2] == pixel_data[3 * i]);
+  }
+  std::remove(filename.c_str());
+}
@@ -0,0 +1,154 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_memory.h"
+
+namespace {
+
+std::vector<std::uint8_t> ToBytes(std::string const& s) {
+  return std::vector<std::uint8_t>(s.begin(), s.end());
+}
+
+}  // namespace
+
+TEST_CASE("MEMORY - Encode matches write") {
+  constexpr auto width = std::size_t{123};
+  constexpr auto height = std::size_t{45};
+  auto const pixel_data = GradientPixelData(width * height * 3);
+
+  auto oss = std::ostringstream{};
+  thinks::WritePpmImage(oss, width, height, pixel_data.data());
+  auto buffer = thinks::UninitializedVector<std::uint8_t>{};
+  thinks::EncodePpmImage(width, height, pixel_data.data(), &buffer);
+  REQUIRE(buffer.size() == thinks::EncodedPpmSize(width, height));
+  REQUIRE(std::vector<std::uint8_t>(buffer.begin(), buffer.end()) ==
+          ToBytes(oss.str()));
+
+  auto grey_oss = std::ostringstream{};
+  thinks::WritePgmImage(grey_oss, width, height, pixel_data.data());
+  auto grey_buffer = std::vector<std::uint8_t>{};
+  thinks::EncodePgmImage(width, height, pixel_data.data(), &grey_buffer);
+  REQUIRE(grey_buffer == ToBytes(grey_oss.str()));
+}
+
+TEST_CASE("MEMORY - Encode 16-bit matches write") {
+  constexpr auto width = std::size_t{10};
+  constexpr auto height = std::size_t{1000};
+  auto pixel_data = std::vector<std::uint16_t>(width * height * 3);
+  for (auto i = std::size_t{0}; i < pixel_data.size(); ++i) {
+    pixel_data[i] = static_cast<std::uint16_t>(i * 7 % 1000);
+  }
+
+  for (auto const max_value : {std::uint32_t{1000}, std::uint32_t{255}}) {
+    auto oss = std::ostringstream{};
+    thinks::WritePpmImage(oss, width, height, pixel_data.data(), max_value);
+    auto buffer = std::vector<std::uint8_t>{};
+    thinks::EncodePpmImage(width, height, pixel_data.data(), &buffer,
+                           max_value);
+    REQUIRE(buffer == ToBytes(oss.str()));
+  }
+}
+
+TEST_CASE("MEMORY - Encode 16-bit samples of 32768 and above saturate") {
+  // Long enough for the vectorized narrowing loops and a scalar tail.
+  constexpr auto width = std::size_t{67};
+  constexpr auto height = std::size_t{3};
+  auto pixel_data = std::vector<std::uint16_t>(width * height);
+  for (auto i = std::size_t{0}; i < pixel_data.size(); ++i) {
+    pixel_data[i] = static_cast<std::uint16_t>(i % 2 == 0 ? 65535 : 40000);
+  }
+
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, width, height, pixel_data.data(), 255);
+  auto buffer = std::vector<std::uint8_t>{};
+  thinks::EncodePgmImage(width, height, pixel_data.data(), &buffer, 255);
+  REQUIRE(buffer == ToBytes(oss.str()));
+  auto const raster_begin = buffer.end() - width * height;
+  REQUIRE(std::vector<std::uint8_t>(raster_begin, buffer.end()) ==
+          std::vector<std::uint8_t>(width * height, 255));
+}
+
+TEST_CASE("MEMORY - Encode into caller buffer") {
+  constexpr auto width = std::size_t{7};
+  constexpr auto height = std::size_t{3};
+  auto const pixel_data = GradientPixelData(width * height);
+  auto const size = thinks::EncodedPgmSize(width, height);
+  auto buffer = std::vector<std::uint8_t>(size + 5, 0xAB);
+  REQUIRE(thinks::EncodePgmImage(width, height, pixel_data.data(),
+                                 buffer.data(), buffer.size()) == size);
+  REQUIRE(buffer[size] == 0xAB);
+
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, width, height, pixel_data.data());
+  REQUIRE(std::vector<std::uint8_t>(buffer.begin(), buffer.begin() + size) ==
+          ToBytes(oss.str()));
+}
+
+TEST_CASE("MEMORY - Encode into small buffer throws") {
+  auto const pixel_data = GradientPixelData(10 * 10 * 3);
+  auto buffer = std::vector<std::uint8_t>(300);
+  REQUIRE_THROWS_MATCHES(
+      thinks::EncodePpmImage(10, 10, pixel_data.data(), buffer.data(),
+                             buffer.size()),
+      std::invalid_argument,
+      ExceptionContentMatcher(
+          "buffer capacity must be at least 313 bytes, was 300"));
+}
+
+TEST_CASE("MEMORY - Encode invalid width throws") {
+  auto const pixel_data = GradientPixelData(10);
+  auto buffer = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::EncodePgmImage(0, 10, pixel_data.data(), &buffer),
+      std::invalid_argument, ExceptionContentMatcher("width must be non-zero"));
+}
+
+TEST_CASE("MEMORY - Decode views input") {
+  constexpr auto width = std::size_t{32};
+  constexpr auto height = std::size_t{16};
+  auto const pixel_data = GradientPixelData(width * height * 3);
+  auto buffer = std::vector<std::uint8_t>{};
+  thinks::EncodePpmImage(width, height, pixel_data.data(), &buffer);
+
+  auto const image = thinks::DecodePpmImage(buffer.data(), buffer.size());
+  REQUIRE(image.width() == width);
+  REQUIRE(image.height() == height);
+  REQUIRE(image.channels() == 3);
+  REQUIRE(image.max_value() == 255);
+  REQUIRE(image.data() == buffer.data() + buffer.size() - pixel_data.size());
+  REQUIRE(std::vector<std::uint8_t>(image.data(),
+                                    image.data() + image.size()) ==
+          pixel_data);
+  REQUIRE(image.row(2)[0] == pixel_data[2 * width * 3]);
+}
+
+TEST_CASE("MEMORY - Decode invalid magic number throws") {
+  auto const pixel_data = GradientPixelData(4 * 4);
+  auto buffer = std::vector<std::uint8_t>{};
+  thinks::EncodePgmImage(4, 4, pixel_data.data(), &buffer);
+  REQUIRE_THROWS_MATCHES(
+      thinks::DecodePpmImage(buffer.data(), buffer.size()),
+      std::runtime_error,
+      ExceptionContentMatcher("magic number must be 'P6', was 'P5'"));
+}
+
+TEST_CASE("MEMORY - Decode truncated buffer throws") {
+  auto const pixel_data = GradientPixelData(10 * 10);
+  auto buffer = std::vector<std::uint8_t>{};
+  thinks::EncodePgmImage(10, 10, pixel_data.data(), &buffer);
+  REQUIRE_THROWS_MATCHES(
+      thinks::DecodePgmImage(buffer.data(), buffer.size() - 10),
+      std::runtime_error,
+      ExceptionContentMatcher("pixel data requires 100 bytes, buffer has 90"));
+}
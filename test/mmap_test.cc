@@ -0,0 +1,94 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_mmap.h"
+
+TEST_CASE("MMAP - Map invalid filename throws") {
+  // Not checking error message since it is OS dependent.
+  REQUIRE_THROWS_AS(thinks::MapPpmImage(std::string{}), std::runtime_error);
+}
+
+TEST_CASE("MMAP - Map invalid magic number throws") {
+  auto const filename = std::string{"mmap_test_magic.pgm"};
+  auto const pixel_data = GradientPixelData(10 * 10);
+  thinks::WritePgmImage(filename, 10, 10, pixel_data.data());
+
+  REQUIRE_THROWS_MATCHES(
+      thinks::MapPpmImage(filename), std::runtime_error,
+      ExceptionContentMatcher("magic number must be 'P6', was 'P5'"));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("MMAP - Map truncated file throws") {
+  auto const filename = std::string{"mmap_test_truncated.ppm"};
+  {
+    auto ofs = std::ofstream(filename, std::ios::binary);
+    ofs << "P6\n10\n10\n255\n";
+    auto const pixel_data = GradientPixelData(10 * 9 * 3);  // Invalid.
+    ofs.write(reinterpret_cast<char const*>(pixel_data.data()),
+              pixel_data.size());
+  }
+
+  REQUIRE_THROWS_MATCHES(
+      thinks::MapPpmImage(filename), std::runtime_error,
+      ExceptionContentMatcher("pixel data requires 300 bytes, file has 270"));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("MMAP - Map matches read") {
+  auto constexpr width = std::size_t{64};
+  auto constexpr height = std::size_t{96};
+  auto const filename = std::string{"mmap_test_read.ppm"};
+  auto const write_pixels = GradientPixelData(width * height * 3);
+  thinks::WritePpmImage(filename, width, height, write_pixels.data());
+
+  auto image = thinks::MapPpmImage(filename, thinks::AccessHint::kSequential);
+  REQUIRE(image.width() == width);
+  REQUIRE(image.height() == height);
+  REQUIRE(image.channels() == 3);
+  REQUIRE(image.size() == write_pixels.size());
+  REQUIRE(std::vector<std::uint8_t>(image.data(),
+                                    image.data() + image.size()) ==
+          write_pixels);
+  REQUIRE(image.row(1)[0] == write_pixels[width * 3]);
+
+  // Hints do not change the contents of the mapping.
+  image.Advise(thinks::AccessHint::kRandom, 10, 20);
+  image.Advise(thinks::AccessHint::kDontNeed);
+
+  // Moved-to views keep the mapping alive.
+  auto moved_image = std::move(image);
+  REQUIRE(std::vector<std::uint8_t>(
+              moved_image.data(), moved_image.data() + moved_image.size()) ==
+          write_pixels);
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("MMAP - Map PGM") {
+  auto constexpr width = std::size_t{33};
+  auto constexpr height = std::size_t{17};
+  auto const filename = std::string{"mmap_test_read.pgm"};
+  auto const write_pixels = GradientPixelData(width * height);
+  thinks::WritePgmImage(filename, width, height, write_pixels.data());
+
+  auto const image = thinks::MapPgmImage(filename);
+  REQUIRE(image.width() == width);
+  REQUIRE(image.height() == height);
+  REQUIRE(image.channels() == 1);
+  REQUIRE(std::vector<std::uint8_t>(image.data(),
+                                    image.data() + image.size()) ==
+          write_pixels);
+  std::remove(filename.c_str());
+}
@@ -0,0 +1,171 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_layout.h"
+
+namespace {
+
+class RecordingObserver : public thinks::IoObserver {
+ public:
+  void OnPhase(thinks::IoEvent const& event) override {
+    events.push_back(event);
+  }
+
+  std::vector<thinks::IoPhase> phases() const {
+    auto phases = std::vector<thinks::IoPhase>{};
+    for (auto const& event : events) {
+      phases.push_back(event.phase);
+    }
+    return phases;
+  }
+
+  std::uint64_t bytes(thinks::IoPhase const phase) const {
+    for (auto const& event : events) {
+      if (event.phase == phase) {
+        return event.bytes;
+      }
+    }
+    return 0;
+  }
+
+  std::vector<thinks::IoEvent> events;
+};
+
+// Installs an observer for the lifetime of the scope.
+class ScopedObserver {
+ public:
+  explicit ScopedObserver(thinks::IoObserver* const observer)
+      : previous_(thinks::SetIoObserver(observer)) {}
+  ScopedObserver(ScopedObserver const&) = delete;
+  ScopedObserver& operator=(ScopedObserver const&) = delete;
+  ~ScopedObserver() { thinks::SetIoObserver(previous_); }
+
+ private:
+  thinks::IoObserver* previous_;
+};
+
+}  // namespace
+
+TEST_CASE("OBSERVER - No observer by default") {
+  REQUIRE(thinks::GetIoObserver() == nullptr);
+
+  auto oss = std::ostringstream{};
+  auto const write_pixels = std::vector<std::uint8_t>(4 * 3, 7);
+  thinks::WritePgmImage(oss, 4, 3, write_pixels.data());
+}
+
+TEST_CASE("OBSERVER - Set returns previous observer") {
+  auto first = RecordingObserver{};
+  auto second = RecordingObserver{};
+  REQUIRE(thinks::SetIoObserver(&first) == nullptr);
+  REQUIRE(thinks::SetIoObserver(&second) == &first);
+  REQUIRE(thinks::GetIoObserver() == &second);
+  REQUIRE(thinks::SetIoObserver(nullptr) == &second);
+}
+
+TEST_CASE("OBSERVER - Stream read and write phases") {
+  using thinks::IoPhase;
+  auto observer = RecordingObserver{};
+  ScopedObserver const scoped_observer(&observer);
+  auto const write_pixels = std::vector<std::uint8_t>(5 * 4 * 3, 42);
+
+  auto oss = std::ostringstream{};
+  thinks::WritePpmImage(oss, 5, 4, write_pixels.data());
+  REQUIRE(observer.phases() ==
+          (std::vector<IoPhase>{IoPhase::kHeader, IoPhase::kRaster}));
+  REQUIRE(observer.bytes(IoPhase::kRaster) == 5 * 4 * 3);
+  for (auto const& event : observer.events) {
+    REQUIRE(event.write);
+    REQUIRE(event.duration.count() >= 0);
+  }
+
+  observer.events.clear();
+  auto iss = std::istringstream(oss.str());
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPpmImage(iss, &width, &height, &read_pixels);
+  REQUIRE(observer.phases() ==
+          (std::vector<IoPhase>{IoPhase::kHeader, IoPhase::kAllocate,
+                                IoPhase::kRaster}));
+  REQUIRE(observer.bytes(IoPhase::kAllocate) == 5 * 4 * 3);
+  REQUIRE(observer.bytes(IoPhase::kRaster) == 5 * 4 * 3);
+  for (auto const& event : observer.events) {
+    REQUIRE(!event.write);
+  }
+}
+
+TEST_CASE("OBSERVER - 16-bit read reports conversion") {
+  using thinks::IoPhase;
+  auto const write_pixels = std::vector<std::uint16_t>(6 * 2, 1000);
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, 6, 2, write_pixels.data());
+
+  auto observer = RecordingObserver{};
+  ScopedObserver const scoped_observer(&observer);
+  auto iss = std::istringstream(oss.str());
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint16_t>{};
+  thinks::ReadPgmImage(iss, &width, &height, &read_pixels);
+  REQUIRE(observer.phases() ==
+          (std::vector<IoPhase>{IoPhase::kHeader, IoPhase::kAllocate,
+                                IoPhase::kRaster, IoPhase::kConvert}));
+  REQUIRE(observer.bytes(IoPhase::kAllocate) == 6 * 2 * 2);
+  REQUIRE(observer.bytes(IoPhase::kRaster) == 6 * 2 * 2);
+  REQUIRE(observer.bytes(IoPhase::kConvert) == 6 * 2 * 2);
+  REQUIRE(read_pixels == write_pixels);
+}
+
+TEST_CASE("OBSERVER - File read and write phases") {
+  using thinks::IoPhase;
+  auto const filename = std::string{"observer_test.pgm"};
+  auto const write_pixels = std::vector<std::uint8_t>(8 * 8, 9);
+  auto observer = RecordingObserver{};
+  ScopedObserver const scoped_observer(&observer);
+
+  thinks::WritePgmImage(filename, 8, 8, write_pixels.data());
+  REQUIRE(observer.phases() ==
+          (std::vector<IoPhase>{IoPhase::kOpen, IoPhase::kHeader,
+                                IoPhase::kRaster, IoPhase::kClose}));
+
+  observer.events.clear();
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPgmImage(filename, &width, &height, &read_pixels,
+                       thinks::PixelLayout::kRgb);
+  REQUIRE(observer.phases() ==
+          (std::vector<IoPhase>{IoPhase::kOpen, IoPhase::kHeader,
+                                IoPhase::kAllocate, IoPhase::kRaster,
+                                IoPhase::kClose}));
+  REQUIRE(observer.bytes(IoPhase::kAllocate) == 8 * 8 * 3);
+  REQUIRE(observer.bytes(IoPhase::kRaster) == 8 * 8);
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("OBSERVER - Failed read reports completed phases only") {
+  using thinks::IoPhase;
+  auto observer = RecordingObserver{};
+  ScopedObserver const scoped_observer(&observer);
+  auto iss = std::istringstream("P5\n4 4\n255\nabc");
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_AS(
+      thinks::ReadPgmImage(iss, &width, &height, &read_pixels),
+      std::runtime_error);
+  REQUIRE(observer.phases() ==
+          (std::vector<IoPhase>{IoPhase::kHeader, IoPhase::kAllocate}));
+}
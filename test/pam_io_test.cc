@@ -0,0 +1,188 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+
+TEST_CASE("PAM - Write invalid depth throws") {
+  auto const pixel_data = GradientPixelData(10 * 10);
+  auto oss = std::ostringstream{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::WritePamImage(oss, 10, 10, 0, "GRAYSCALE", pixel_data.data()),
+      std::invalid_argument,
+      ExceptionContentMatcher("depth must be non-zero"));
+}
+
+TEST_CASE("PAM - Read invalid magic number throws") {
+  auto ss = std::stringstream{};
+  ss << "P6\n10\n10\n255\n";
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto depth = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPamImage(ss, &width, &height, &depth, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("magic number must be 'P7', was 'P6'"));
+}
+
+TEST_CASE("PAM - Read unknown header keyword throws") {
+  auto ss = std::stringstream{};
+  ss << "P7\nWIDTH 2\nHEIGHT 2\nCOLORS 3\nMAXVAL 255\nENDHDR\n";
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto depth = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPamImage(ss, &width, &height, &depth, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("unknown PAM header keyword 'COLORS'"));
+}
+
+TEST_CASE("PAM - Read header without ENDHDR throws") {
+  auto ss = std::stringstream{};
+  ss << "P7\nWIDTH 2\nHEIGHT 2\nDEPTH 1\nMAXVAL 255\n";
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto depth = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPamImage(ss, &width, &height, &depth, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("PAM header must end with ENDHDR"));
+}
+
+TEST_CASE("PAM - Read channel map out of range throws") {
+  auto const pixel_data = GradientPixelData(3 * 2 * 2);
+  auto ss = std::stringstream{};
+  thinks::WritePamImage(ss, 3, 2, 2, "GRAYSCALE_ALPHA", pixel_data.data());
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPamImage(ss, &width, &height, {0, 1, 2}, &read_pixels),
+      std::runtime_error,
+      ExceptionContentMatcher("channel map index 2 out of range for depth 2"));
+}
+
+TEST_CASE("PAM - Write header") {
+  auto const pixel_data = GradientPixelData(2 * 1 * 4);
+  auto oss = std::ostringstream{};
+  thinks::WritePamImage(oss, 2, 1, 4, "RGB_ALPHA", pixel_data.data());
+
+  auto expected = std::string{
+      "P7\nWIDTH 2\nHEIGHT 1\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\n"
+      "ENDHDR\n"};
+  expected.append(pixel_data.begin(), pixel_data.end());
+  REQUIRE(oss.str() == expected);
+}
+
+TEST_CASE("PAM - Read header with comments") {
+  auto ss = std::stringstream{};
+  ss << "P7\n# Written by hand.\nWIDTH 2\nHEIGHT 1\n\nDEPTH 1\nMAXVAL 9\n"
+     << "TUPLTYPE GRAYSCALE\n# Last comment.\nENDHDR\n"
+     << '\x01' << '\x09';
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto depth = std::size_t{0};
+  auto tuple_type = std::string{};
+  auto max_value = std::uint32_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  thinks::ReadPamImage(ss, &width, &height, &depth, &pixel_data, &tuple_type,
+                       &max_value);
+  REQUIRE(width == 2);
+  REQUIRE(height == 1);
+  REQUIRE(depth == 1);
+  REQUIRE(tuple_type == "GRAYSCALE");
+  REQUIRE(max_value == 9);
+  REQUIRE(pixel_data == std::vector<std::uint8_t>{1, 9});
+}
+
+TEST_CASE("PAM - Round-trip RGBA") {
+  auto constexpr width = std::size_t{23};
+  auto constexpr height = std::size_t{17};
+  auto const write_pixels = GradientPixelData(width * height * 4);
+  auto const filename = std::string{"pam_io_test.pam"};
+  thinks::WritePamImage(filename, width, height, 4, "RGB_ALPHA",
+                        write_pixels.data());
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_depth = std::size_t{0};
+  auto read_tuple_type = std::string{};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPamImage(filename, &read_width, &read_height, &read_depth,
+                       &read_pixels, &read_tuple_type);
+  REQUIRE(read_width == width);
+  REQUIRE(read_height == height);
+  REQUIRE(read_depth == 4);
+  REQUIRE(read_tuple_type == "RGB_ALPHA");
+  REQUIRE(read_pixels == write_pixels);
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("PAM - Read with channel map") {
+  auto constexpr width = std::size_t{300};
+  auto constexpr height = std::size_t{29};
+  auto const write_pixels = GradientPixelData(width * height * 2);
+  auto ss = std::stringstream{};
+  thinks::WritePamImage(ss, width, height, 2, "GRAYSCALE_ALPHA",
+                        write_pixels.data());
+
+  // Grey and alpha to RGBA, with a constant channel that is not stored.
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPamImage(ss, &read_width, &read_height, {0, 0, 0, 1, -1},
+                       &read_pixels);
+
+  auto expected = std::vector<std::uint8_t>{};
+  for (auto i = std::size_t{0}; i < width * height; ++i) {
+    auto const grey = write_pixels[2 * i];
+    auto const alpha = write_pixels[2 * i + 1];
+    expected.insert(expected.end(), {grey, grey, grey, alpha, 255});
+  }
+  REQUIRE(read_pixels == expected);
+}
+
+TEST_CASE("PAM - Round-trip 16-bit with channel map") {
+  auto constexpr width = std::size_t{31};
+  auto constexpr height = std::size_t{9};
+  auto write_pixels = std::vector<std::uint16_t>(width * height * 3);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = static_cast<std::uint16_t>((i * 97) % 4096);
+  }
+  auto ss = std::stringstream{};
+  thinks::WritePamImage(ss, width, height, 3, "RGB", write_pixels.data(),
+                        4095);
+
+  // RGB to opaque BGRA.
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_max_value = std::uint32_t{0};
+  auto read_pixels = std::vector<std::uint16_t>{};
+  thinks::ReadPamImage(ss, &read_width, &read_height, {2, 1, 0, -1},
+                       &read_pixels, nullptr, &read_max_value);
+  REQUIRE(read_max_value == 4095);
+  REQUIRE(read_pixels.size() == width * height * 4);
+  for (auto i = std::size_t{0}; i < width * height; ++i) {
+    REQUIRE(read_pixels[4 * i + 0] == write_pixels[3 * i + 2]);
+    REQUIRE(read_pixels[4 * i + 1] == write_pixels[3 * i + 1]);
+    REQUIRE(read_pixels[4 * i + 2] == write_pixels[3 * i + 0]);
+    REQUIRE(read_pixels[4 * i + 3] == 4095);
+  }
+}
@@ -0,0 +1,94 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_parallel.h"
+
+TEST_CASE("PARALLEL READ - Plain format throws") {
+  auto const filename = std::string{"parallel_read_test.ppm"};
+  {
+    auto ofs = std::ofstream(filename, std::ios::binary);
+    ofs << "P3\n1 1\n255\n1 2 3\n";
+  }
+  auto pixel_data = std::vector<std::uint8_t>(3);
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPnmRaster(filename, pixel_data.data(), pixel_data.size()),
+      std::runtime_error,
+      ExceptionContentMatcher("unsupported magic number 'P3'"));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("PARALLEL READ - Too small capacity throws") {
+  auto const filename = std::string{"parallel_read_test.pgm"};
+  auto const write_pixels = GradientPixelData(10 * 10);
+  thinks::WritePgmImage(filename, 10, 10, write_pixels.data());
+
+  auto pixel_data = std::vector<std::uint8_t>(99);
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPnmRaster(filename, pixel_data.data(), pixel_data.size()),
+      std::runtime_error,
+      ExceptionContentMatcher("pixel data requires 100 bytes, capacity is 99"));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("PARALLEL READ - Invalid magic number throws") {
+  auto const filename = std::string{"parallel_read_test.pgm"};
+  auto const write_pixels = GradientPixelData(10 * 10 * 3);
+  thinks::WritePpmImage(filename, 10, 10, write_pixels.data());
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPgmImage(filename, &width, &height, &pixel_data,
+                           thinks::ParallelReadOptions{}),
+      std::runtime_error,
+      ExceptionContentMatcher("magic number must be 'P5', was 'P6'"));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("PARALLEL READ - Read chunks") {
+  // Many small chunks, with pixel data that neither starts nor ends at a
+  // chunk boundary.
+  auto constexpr width = std::size_t{317};
+  auto constexpr height = std::size_t{129};
+  auto const filename = std::string{"parallel_read_test.ppm"};
+  auto const write_pixels = GradientPixelData(width * height * 3);
+  thinks::WritePpmImage(filename, width, height, write_pixels.data());
+
+  for (auto const direct_io : {false, true}) {
+    auto options = thinks::ParallelReadOptions{};
+    options.thread_count = 5;
+    options.chunk_size = 1000;  // Rounded up to 4096.
+    options.direct_io = direct_io;
+    options.drop_cache = true;
+
+    auto read_width = std::size_t{0};
+    auto read_height = std::size_t{0};
+    auto read_pixels = std::vector<std::uint8_t>{};
+    thinks::ReadPpmImage(filename, &read_width, &read_height, &read_pixels,
+                         options);
+    REQUIRE(read_width == width);
+    REQUIRE(read_height == height);
+    REQUIRE(read_pixels == write_pixels);
+
+    auto raster = std::vector<std::uint8_t>(write_pixels.size() + 10);
+    auto const info =
+        thinks::ReadPnmRaster(filename, raster.data(), raster.size(), options);
+    REQUIRE(info.raster_size == write_pixels.size());
+    REQUIRE(std::vector<std::uint8_t>(raster.begin(),
+                                      raster.begin() + write_pixels.size()) ==
+            write_pixels);
+  }
+  std::remove(filename.c_str());
+}
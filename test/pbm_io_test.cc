@@ -0,0 +1,175 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+
+namespace {
+
+// Pseudo-random black (0) and white (255) pixels.
+std::vector<std::uint8_t> BitmapPixelData(std::size_t const width,
+                                          std::size_t const height) {
+  auto pixel_data = std::vector<std::uint8_t>(width * height);
+  auto state = std::uint32_t{12345};
+  for (auto& pixel : pixel_data) {
+    state = state * 1664525u + 1013904223u;
+    pixel = (state >> 31) != 0 ? 255 : 0;
+  }
+  return pixel_data;
+}
+
+// Reference packing, one bit at a time.
+std::vector<std::uint8_t> PackedPixelData(
+    std::size_t const width, std::size_t const height,
+    std::vector<std::uint8_t> const& pixel_data) {
+  auto const row_size = (width + 7) / 8;
+  auto packed = std::vector<std::uint8_t>(row_size * height);
+  for (auto y = std::size_t{0}; y < height; ++y) {
+    for (auto x = std::size_t{0}; x < width; ++x) {
+      if (pixel_data[y * width + x] == 0) {
+        packed[y * row_size + x / 8] |=
+            static_cast<std::uint8_t>(0x80u >> (x % 8));
+      }
+    }
+  }
+  return packed;
+}
+
+}  // namespace
+
+TEST_CASE("PBM - Write invalid width throws") {
+  auto const pixel_data = BitmapPixelData(10, 10);
+  auto oss = std::ostringstream{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::WritePbmImage(oss, 0, 10, pixel_data.data()),
+      std::invalid_argument,
+      ExceptionContentMatcher("width must be non-zero"));
+}
+
+TEST_CASE("PBM - Read invalid magic number throws") {
+  auto ss = std::stringstream{};
+  ss << "P5\n10\n10\n255\n";
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPbmImage(ss, &width, &height, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("magic number must be 'P4', was 'P5'"));
+}
+
+TEST_CASE("PBM - Read truncated pixel data throws") {
+  auto ss = std::stringstream{};
+  ss << "P4\n10\n10\n" << std::string(2 * 9, '\0');  // Invalid.
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPbmImage(ss, &width, &height, &pixel_data),
+      std::runtime_error, ExceptionContentMatcher("failed reading 20 bytes"));
+}
+
+TEST_CASE("PBM - Write packs rows") {
+  auto constexpr width = std::size_t{77};
+  auto constexpr height = std::size_t{13};
+  auto const pixel_data = BitmapPixelData(width, height);
+  auto const packed = PackedPixelData(width, height, pixel_data);
+
+  auto oss = std::ostringstream{};
+  thinks::WritePbmImage(oss, width, height, pixel_data.data());
+
+  auto expected = std::string{"P4\n77\n13\n"};
+  expected.append(packed.begin(), packed.end());
+  REQUIRE(oss.str() == expected);
+}
+
+TEST_CASE("PBM - Round-trip") {
+  auto constexpr width = std::size_t{101};
+  auto constexpr height = std::size_t{67};
+  auto const write_pixels = BitmapPixelData(width, height);
+  auto const filename = std::string{"pbm_io_test.pbm"};
+  thinks::WritePbmImage(filename, width, height, write_pixels.data());
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPbmImage(filename, &read_width, &read_height, &read_pixels);
+  REQUIRE(read_width == width);
+  REQUIRE(read_height == height);
+  REQUIRE(read_pixels == write_pixels);
+
+  auto packed_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPbmImage(filename, &read_width, &read_height, &packed_pixels,
+                       thinks::PbmLayout::kPacked);
+  REQUIRE(packed_pixels == PackedPixelData(width, height, write_pixels));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("PBM - Round-trip packed") {
+  auto constexpr width = std::size_t{40};
+  auto constexpr height = std::size_t{3};
+  auto const write_pixels =
+      PackedPixelData(width, height, BitmapPixelData(width, height));
+
+  auto ss = std::stringstream{};
+  thinks::WritePbmImage(ss, width, height, write_pixels.data(),
+                        thinks::PbmLayout::kPacked);
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPbmImage(ss, &read_width, &read_height, &read_pixels,
+                       thinks::PbmLayout::kPacked);
+  REQUIRE(read_pixels == write_pixels);
+}
+
+TEST_CASE("PBM - Read plain invalid character throws") {
+  auto ss = std::stringstream{};
+  ss << "P1\n2 2\n0 1\n1 2\n";
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPlainPbmImage(ss, &width, &height, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("invalid character in pixel data: '2'"));
+}
+
+TEST_CASE("PBM - Read plain") {
+  auto constexpr width = std::size_t{21};
+  auto constexpr height = std::size_t{5};
+  auto const expected = BitmapPixelData(width, height);
+  auto ss = std::stringstream{};
+  ss << "P1\n" << width << " " << height << "\n";
+  for (auto i = std::size_t{0}; i < expected.size(); ++i) {
+    // Whitespace between pixels is optional.
+    ss << (expected[i] == 0 ? '1' : '0') << (i % 3 == 0 ? " " : "");
+  }
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  auto const text = ss.str();
+  auto iss = std::istringstream(text);
+  thinks::ReadPlainPbmImage(iss, &read_width, &read_height, &read_pixels);
+  REQUIRE(read_width == width);
+  REQUIRE(read_height == height);
+  REQUIRE(read_pixels == expected);
+
+  auto packed_iss = std::istringstream(text);
+  thinks::ReadPlainPbmImage(packed_iss, &read_width, &read_height,
+                            &read_pixels, thinks::PbmLayout::kPacked);
+  REQUIRE(read_pixels == PackedPixelData(width, height, expected));
+}
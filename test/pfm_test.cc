@@ -0,0 +1,217 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_pfm.h"
+
+namespace {
+
+std::vector<float> GradientFloatPixelData(std::size_t const size) {
+  auto pixel_data = std::vector<float>(size);
+  for (auto i = std::size_t{0}; i < pixel_data.size(); ++i) {
+    pixel_data[i] = static_cast<float>(i % 257) / 256.F;
+  }
+  return pixel_data;
+}
+
+void AppendFloat(float const value, bool const big_endian,
+                 std::string* const bytes) {
+  unsigned char b[4];
+  std::memcpy(b, &value, 4);
+  auto const native_big_endian = !thinks::detail::IsLittleEndian();
+  for (auto i = 0; i < 4; ++i) {
+    bytes->push_back(static_cast<char>(
+        big_endian == native_big_endian ? b[i] : b[3 - i]));
+  }
+}
+
+float ExpectedSrgb(float const v) {
+  return v <= 0.0031308F ? 12.92F * v
+                         : 1.055F * std::pow(v, 1.F / 2.4F) - 0.055F;
+}
+
+}  // namespace
+
+TEST_CASE("PFM - Round-trip") {
+  constexpr auto width = std::size_t{13};
+  constexpr auto height = std::size_t{7};
+  for (auto const channels : {std::size_t{1}, std::size_t{3}}) {
+    auto const write_pixels = GradientFloatPixelData(width * height * channels);
+    auto oss = std::ostringstream{};
+    thinks::WritePfmImage(oss, width, height, channels, write_pixels.data(),
+                          2.F);
+    REQUIRE(oss.str().substr(0, 2) == (channels == 3 ? "PF" : "Pf"));
+
+    auto iss = std::istringstream(oss.str());
+    auto read_width = std::size_t{0};
+    auto read_height = std::size_t{0};
+    auto read_channels = std::size_t{0};
+    auto scale = 0.F;
+    auto read_pixels = std::vector<float>{};
+    thinks::ReadPfmImage(iss, &read_width, &read_height, &read_channels,
+                         &read_pixels, &scale);
+    REQUIRE(read_width == width);
+    REQUIRE(read_height == height);
+    REQUIRE(read_channels == channels);
+    REQUIRE(scale == 2.F);
+    REQUIRE(read_pixels == write_pixels);
+  }
+}
+
+TEST_CASE("PFM - Scale round-trips exactly") {
+  auto const pixel_data = GradientFloatPixelData(2 * 2);
+  for (auto const write_scale : {1e-7F, 1.2345678F, 3.0e20F}) {
+    auto oss = std::ostringstream{};
+    thinks::WritePfmImage(oss, 2, 2, 1, pixel_data.data(), write_scale);
+
+    auto iss = std::istringstream(oss.str());
+    auto width = std::size_t{0};
+    auto height = std::size_t{0};
+    auto channels = std::size_t{0};
+    auto read_scale = 0.F;
+    auto read_pixels = std::vector<float>{};
+    thinks::ReadPfmImage(iss, &width, &height, &channels, &read_pixels,
+                         &read_scale);
+    REQUIRE(read_scale == write_scale);
+  }
+}
+
+TEST_CASE("PFM - Read bottom-up rows in either byte order") {
+  // 1x2 greyscale image, the bottom row (0.25) is stored first.
+  for (auto const big_endian : {false, true}) {
+    auto bytes = std::string{big_endian ? "Pf\n1 2\n1.0\n" : "Pf\n1 2\n-1.0\n"};
+    AppendFloat(0.25F, big_endian, &bytes);
+    AppendFloat(0.75F, big_endian, &bytes);
+
+    auto iss = std::istringstream(bytes);
+    auto width = std::size_t{0};
+    auto height = std::size_t{0};
+    auto channels = std::size_t{0};
+    auto pixel_data = std::vector<float>{};
+    thinks::ReadPfmImage(iss, &width, &height, &channels, &pixel_data);
+    REQUIRE(channels == 1);
+    REQUIRE(pixel_data == (std::vector<float>{0.75F, 0.25F}));
+  }
+}
+
+TEST_CASE("PFM - Read invalid scale throws") {
+  auto iss = std::istringstream("PF\n1 1\n0.0\n");
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto channels = std::size_t{0};
+  auto pixel_data = std::vector<float>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPfmImage(iss, &width, &height, &channels, &pixel_data),
+      std::runtime_error, ExceptionContentMatcher("invalid scale '0.0'"));
+}
+
+TEST_CASE("PFM - Read invalid magic number throws") {
+  auto iss = std::istringstream("P6\n1 1\n255\n");
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto channels = std::size_t{0};
+  auto pixel_data = std::vector<float>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPfmImage(iss, &width, &height, &channels, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("magic number must be 'PF' or 'Pf', was 'P6'"));
+}
+
+TEST_CASE("PFM - Write invalid channels throws") {
+  auto const pixel_data = GradientFloatPixelData(4);
+  auto oss = std::ostringstream{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::WritePfmImage(oss, 2, 1, 2, pixel_data.data()),
+      std::invalid_argument,
+      ExceptionContentMatcher("channel count must be 1 or 3, was 2"));
+}
+
+TEST_CASE("PFM - Quantized write rounds and clamps") {
+  // Long enough for vector and scalar paths.
+  constexpr auto width = std::size_t{53};
+  constexpr auto height = std::size_t{3};
+  auto pixel_data = GradientFloatPixelData(width * height * 3);
+  pixel_data[0] = -1.F;
+  pixel_data[1] = 2.F;
+  pixel_data[2] = std::numeric_limits<float>::quiet_NaN();
+
+  auto oss = std::ostringstream{};
+  thinks::WritePpmImage(oss, width, height, pixel_data.data());
+  auto expected = std::vector<std::uint8_t>(pixel_data.size());
+  for (auto i = std::size_t{3}; i < expected.size(); ++i) {
+    expected[i] = static_cast<std::uint8_t>(pixel_data[i] * 255.F + 0.5F);
+  }
+  expected[1] = 255;
+
+  auto iss = std::istringstream(oss.str());
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPpmImage(iss, &read_width, &read_height, &read_pixels);
+  REQUIRE(read_width == width);
+  REQUIRE(read_pixels == expected);
+}
+
+TEST_CASE("PFM - Quantized write sRGB encodes") {
+  constexpr auto width = std::size_t{1000};
+  auto pixel_data = std::vector<float>(width);
+  for (auto i = std::size_t{0}; i < width; ++i) {
+    pixel_data[i] = static_cast<float>(i) / (width - 1);
+  }
+  auto options = thinks::QuantizeOptions{};
+  options.srgb = true;
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, width, 1, pixel_data.data(), options);
+
+  auto iss = std::istringstream(oss.str());
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPgmImage(iss, &read_width, &read_height, &read_pixels);
+  for (auto i = std::size_t{0}; i < width; ++i) {
+    auto const exact = ExpectedSrgb(pixel_data[i]) * 255.F;
+    REQUIRE(std::fabs(read_pixels[i] - exact) <= 1.F);
+  }
+  REQUIRE(read_pixels.front() == 0);
+  REQUIRE(read_pixels.back() == 255);
+}
+
+TEST_CASE("PFM - Quantized write dithers flat areas") {
+  // A level between two 8-bit values is dithered to a mix of both, with
+  // the mean preserved over each 4x4 tile.
+  constexpr auto width = std::size_t{40};
+  constexpr auto height = std::size_t{8};
+  auto const level = 100.25F / 255.F;
+  auto const pixel_data = std::vector<float>(width * height, level);
+  auto options = thinks::QuantizeOptions{};
+  options.dither = true;
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, width, height, pixel_data.data(), options);
+
+  auto iss = std::istringstream(oss.str());
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPgmImage(iss, &read_width, &read_height, &read_pixels);
+  auto sum = 0;
+  for (auto const p : read_pixels) {
+    REQUIRE((p == 100 || p == 101));
+    sum += p;
+  }
+  REQUIRE(sum == 100 * static_cast<int>(width * height) +
+                     static_cast<int>(width * height) / 4);
+}
@@ -130,7 +130,7 @@ TEST_CASE("PGM - Read invalid height throws") {
 TEST_CASE("PGM - Read invalid max value throws") {
   auto ss = std::stringstream{};
   WriteInvalidPgmImage(ss, "P5",
-                       254,  // Invalid.
+                       0,  // Invalid.
                        10, 10, ValidPixelData(10, 10));
 
   auto width = std::size_t{0};
@@ -139,7 +139,23 @@ TEST_CASE("PGM - Read invalid max value throws") {
   REQUIRE_THROWS_MATCHES(
       thinks::ReadPgmImage(ss, &width, &height, &pixel_data),
       std::runtime_error,
-      ExceptionContentMatcher("max value must be 255, was 254"));
+      ExceptionContentMatcher("max value must be in range [1, 65535], was 0"));
+}
+
+TEST_CASE("PGM - Read 16-bit max value into 8-bit pixel data throws") {
+  auto ss = std::stringstream{};
+  WriteInvalidPgmImage(ss, "P5",
+                       1023,  // Invalid for 8-bit pixel data.
+                       10, 10, ValidPixelData(10, 10 * 2));
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPgmImage(ss, &width, &height, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher(
+          "max value must be at most 255 for 8-bit pixel data, was 1023"));
 }
 
 TEST_CASE("PGM - Read invalid file size throws") {
@@ -180,3 +196,142 @@ TEST_CASE("PGM - Round-trip") {
   REQUIRE(read_height == write_height);
   REQUIRE(read_pixels == write_pixels);
 }
+
+TEST_CASE("PGM - Write invalid 16-bit max value throws") {
+  auto constexpr width = std::size_t{10};
+  auto constexpr height = std::size_t{10};
+  auto const pixel_data = std::vector<std::uint16_t>(width * height);
+  auto oss = std::ostringstream{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::WritePgmImage(oss, width, height, pixel_data.data(), 70000),
+      std::invalid_argument,
+      ExceptionContentMatcher(
+          "max value must be in range [1, 65535], was 70000"));
+}
+
+TEST_CASE("PGM - Round-trip 16-bit") {
+  // Odd sizes exercise both vectorized and scalar conversion paths.
+  auto constexpr write_width = std::size_t{37};
+  auto constexpr write_height = std::size_t{23};
+  auto constexpr write_max_value = std::uint32_t{4095};
+  auto write_pixels = std::vector<std::uint16_t>(write_width * write_height);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = static_cast<std::uint16_t>((i * 97) % 4096);
+  }
+
+  auto ss = std::stringstream{};
+  thinks::WritePgmImage(ss, write_width, write_height, write_pixels.data(),
+                        write_max_value);
+
+  // Samples are stored big-endian.
+  auto const encoded = ss.str();
+  auto const raster = encoded.substr(encoded.size() - write_pixels.size() * 2);
+  REQUIRE(static_cast<std::uint8_t>(raster[2]) == (write_pixels[1] >> 8));
+  REQUIRE(static_cast<std::uint8_t>(raster[3]) == (write_pixels[1] & 0xff));
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_max_value = std::uint32_t{0};
+  auto read_pixels = std::vector<std::uint16_t>{};
+  thinks::ReadPgmImage(ss, &read_width, &read_height, &read_pixels,
+                       &read_max_value);
+
+  REQUIRE(read_width == write_width);
+  REQUIRE(read_height == write_height);
+  REQUIRE(read_max_value == write_max_value);
+  REQUIRE(read_pixels == write_pixels);
+}
+
+TEST_CASE("PGM - Write 16-bit samples above 8-bit max value saturate") {
+  // 37 samples, not a multiple of the vector width, so that samples above
+  // the max value reach both vectorized and scalar conversion paths.
+  auto constexpr width = std::size_t{37};
+  auto constexpr height = std::size_t{1};
+  auto write_pixels = std::vector<std::uint16_t>(width * height);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = static_cast<std::uint16_t>(i % 2 == 0 ? i : 256 + i);
+  }
+
+  auto ss = std::stringstream{};
+  thinks::WritePgmImage(ss, width, height, write_pixels.data(), 255);
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPgmImage(ss, &read_width, &read_height, &read_pixels);
+  REQUIRE(read_pixels.size() == write_pixels.size());
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    REQUIRE(read_pixels[i] == (i % 2 == 0 ? i : 255));
+  }
+}
+
+TEST_CASE("PGM - Write 16-bit samples of 32768 and above saturate") {
+  // Signed packing would turn these into zero. 67 samples cover a 32-sample
+  // block, a 16-sample block and a scalar tail.
+  auto constexpr width = std::size_t{67};
+  auto constexpr height = std::size_t{1};
+  auto const values = std::vector<std::uint16_t>{256,   32767, 32768,
+                                                 40000, 65534, 65535};
+  auto write_pixels = std::vector<std::uint16_t>(width * height);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = values[i % values.size()];
+  }
+
+  auto ss = std::stringstream{};
+  thinks::WritePgmImage(ss, width, height, write_pixels.data(), 255);
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPgmImage(ss, &read_width, &read_height, &read_pixels);
+  REQUIRE(read_pixels == std::vector<std::uint8_t>(width * height, 255));
+}
+
+TEST_CASE("PGM - Read 8-bit image into 16-bit pixel data") {
+  auto constexpr width = std::size_t{29};
+  auto constexpr height = std::size_t{13};
+  auto write_pixels = std::vector<std::uint8_t>(width * height);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = static_cast<std::uint8_t>(i % 100);
+  }
+  auto ss = std::stringstream{};
+  WriteInvalidPgmImage(ss, "P5", 99, width, height, write_pixels);
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_max_value = std::uint32_t{0};
+  auto read_pixels = std::vector<std::uint16_t>{};
+  thinks::ReadPgmImage(ss, &read_width, &read_height, &read_pixels,
+                       &read_max_value, thinks::SampleScaling::kFullRange);
+
+  REQUIRE(read_max_value == 99);
+  REQUIRE(read_pixels.size() == write_pixels.size());
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    auto const expected = (write_pixels[i] * 65535u + 49u) / 99u;
+    REQUIRE(read_pixels[i] == expected);
+  }
+}
+
+TEST_CASE("PGM - Read 16-bit into caller buffer") {
+  auto constexpr write_width = std::size_t{21};
+  auto constexpr write_height = std::size_t{11};
+  auto write_pixels = std::vector<std::uint16_t>(write_width * write_height);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = static_cast<std::uint16_t>(i * 131);
+  }
+  auto ss = std::stringstream{};
+  thinks::WritePgmImage(ss, write_width, write_height, write_pixels.data());
+
+  // Only the start of the buffer is written.
+  auto buffer = std::vector<std::uint16_t>(write_pixels.size() + 5, 7);
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  thinks::ReadPgmImage(ss, &read_width, &read_height, buffer.data(),
+                       buffer.size());
+  REQUIRE(read_width == write_width);
+  REQUIRE(read_height == write_height);
+  REQUIRE(std::vector<std::uint16_t>(buffer.begin(),
+                                     buffer.begin() + write_pixels.size()) ==
+          write_pixels);
+  REQUIRE(buffer.back() == 7);
+}
@@ -0,0 +1,148 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+
+namespace {
+
+template <typename SampleT>
+void WritePlainImage(std::ostream& os, std::string const& magic_number,
+                     std::uint32_t const max_value, std::size_t const width,
+                     std::size_t const height,
+                     std::vector<SampleT> const& pixel_data) {
+  os << magic_number << "\n"
+     << width << " " << height << "\n"
+     << max_value << "\n";
+
+  // Vary the separators to exercise whitespace handling.
+  auto const separators = std::string{" \n\t  \r\n"};
+  for (auto i = std::size_t{0}; i < pixel_data.size(); ++i) {
+    os << static_cast<std::uint32_t>(pixel_data[i])
+       << separators[i % separators.size()];
+  }
+}
+
+}  // namespace
+
+TEST_CASE("PLAIN - Read invalid magic number throws") {
+  auto ss = std::stringstream{};
+  WritePlainImage(ss, "P2", 255, 2, 2, std::vector<std::uint8_t>(2 * 2 * 3));
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPlainPpmImage(ss, &width, &height, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("magic number must be 'P3', was 'P2'"));
+}
+
+TEST_CASE("PLAIN - Read invalid character throws") {
+  auto ss = std::stringstream{};
+  ss << "P2\n2 2\n255\n1 2\n3 x\n";
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPlainPgmImage(ss, &width, &height, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("invalid character in pixel data: 'x'"));
+}
+
+TEST_CASE("PLAIN - Read sample larger than max value throws") {
+  auto ss = std::stringstream{};
+  ss << "P2\n2 2\n100\n1 2\n3 1234567\n";
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPlainPgmImage(ss, &width, &height, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("sample value 1234567 exceeds max value 100"));
+}
+
+TEST_CASE("PLAIN - Read wrong sample count throws") {
+  auto ss = std::stringstream{};
+  ss << "P3\n2 2\n255\n1 2 3 4 5 6 7 8 9 10 11\n";
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPlainPpmImage(ss, &width, &height, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("expected 12 samples, found 11"));
+}
+
+TEST_CASE("PLAIN - Read PGM") {
+  auto constexpr write_width = std::size_t{67};
+  auto constexpr write_height = std::size_t{41};
+  auto write_pixels = std::vector<std::uint8_t>(write_width * write_height);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = static_cast<std::uint8_t>((i * 7) % 256);
+  }
+  auto ss = std::stringstream{};
+  WritePlainImage(ss, "P2", 255, write_width, write_height, write_pixels);
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_max_value = std::uint32_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPlainPgmImage(ss, &read_width, &read_height, &read_pixels,
+                            &read_max_value);
+
+  REQUIRE(read_width == write_width);
+  REQUIRE(read_height == write_height);
+  REQUIRE(read_max_value == 255);
+  REQUIRE(read_pixels == write_pixels);
+}
+
+TEST_CASE("PLAIN - Read 16-bit PPM") {
+  auto constexpr write_width = std::size_t{53};
+  auto constexpr write_height = std::size_t{19};
+  auto write_pixels =
+      std::vector<std::uint16_t>(write_width * write_height * 3);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = static_cast<std::uint16_t>((i * 997) % 65536);
+  }
+  auto ss = std::stringstream{};
+  WritePlainImage(ss, "P3", 65535, write_width, write_height, write_pixels);
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint16_t>{};
+  thinks::ReadPlainPpmImage(ss, &read_width, &read_height, &read_pixels);
+
+  REQUIRE(read_width == write_width);
+  REQUIRE(read_height == write_height);
+  REQUIRE(read_pixels == write_pixels);
+}
+
+TEST_CASE("PLAIN - Chunked parsing matches serial parsing") {
+  auto samples = std::vector<std::uint16_t>(100000);
+  auto oss = std::ostringstream{};
+  for (auto i = std::size_t{0}; i < samples.size(); ++i) {
+    samples[i] = static_cast<std::uint16_t>((i * 31) % 1000);
+    oss << samples[i] << (i % 13 == 0 ? "\n" : "   ");
+  }
+  auto const str = oss.str();
+  auto const text = std::vector<char>(str.begin(), str.end());
+
+  // Force many small chunks, each split at whitespace.
+  auto parsed = std::vector<std::uint16_t>(samples.size());
+  thinks::detail::ReadPlainSamples(text, 999, parsed.data(), parsed.size(),
+                                   /* thread_count */ 7,
+                                   /* min_chunk_size */ 1024);
+  REQUIRE(parsed == samples);
+}
@@ -0,0 +1,265 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+
+namespace {
+
+// Stream buffer over data that arrives in chunks, as from a pipe. Reading
+// beyond the data made available so far throws where a pipe would block.
+class ChunkedStreamBuf : public std::streambuf {
+ public:
+  explicit ChunkedStreamBuf(std::string data) : data_(std::move(data)) {}
+
+  void set_available(std::size_t const available) { available_ = available; }
+
+ protected:
+  std::streamsize showmanyc() override {
+    return static_cast<std::streamsize>(available_ - pos_);
+  }
+
+  int_type underflow() override {
+    if (pos_ == data_.size()) {
+      return traits_type::eof();
+    }
+    ThrowIfUnavailable(1);
+    return traits_type::to_int_type(data_[pos_]);
+  }
+
+  int_type uflow() override {
+    auto const c = underflow();
+    if (c != traits_type::eof()) {
+      ++pos_;
+    }
+    return c;
+  }
+
+  std::streamsize xsgetn(char* const s, std::streamsize const n) override {
+    auto size = static_cast<std::size_t>(n);
+    size = size < data_.size() - pos_ ? size : data_.size() - pos_;
+    ThrowIfUnavailable(size);
+    std::memcpy(s, data_.data() + pos_, size);
+    pos_ += size;
+    return static_cast<std::streamsize>(size);
+  }
+
+ private:
+  void ThrowIfUnavailable(std::size_t const size) const {
+    if (pos_ + size > available_) {
+      throw std::logic_error("read would block");
+    }
+  }
+
+  std::string data_;
+  std::size_t available_ = 0;
+  std::size_t pos_ = 0;
+};
+
+}  // namespace
+
+TEST_CASE("PNM READER - Invalid magic number throws") {
+  auto ss = std::stringstream{};
+  ss << "P4\n10\n10\n255\n";
+
+  REQUIRE_THROWS_MATCHES(
+      thinks::PnmReader(ss), std::runtime_error,
+      ExceptionContentMatcher("unsupported magic number 'P4'"));
+}
+
+TEST_CASE("PNM READER - Zero strip rows throws") {
+  auto ss = std::stringstream{};
+  auto const pixel_data = GradientPixelData(10 * 10);
+  thinks::WritePgmImage(ss, 10, 10, pixel_data.data());
+
+  auto reader = thinks::PnmReader(ss);
+  REQUIRE_THROWS_MATCHES(
+      reader.ForEachStrip(0, [](std::size_t, std::size_t,
+                                std::uint8_t const*) {}),
+      std::invalid_argument,
+      ExceptionContentMatcher("strip rows must be non-zero"));
+}
+
+TEST_CASE("PNM READER - Truncated pixel data throws") {
+  auto ss = std::stringstream{};
+  ss << "P6\n10\n10\n255\n";
+  auto const pixel_data = GradientPixelData(10 * 9 * 3);  // Invalid.
+  ss.write(reinterpret_cast<char const*>(pixel_data.data()),
+           pixel_data.size());
+
+  auto reader = thinks::PnmReader(ss);
+  auto rows = std::vector<std::uint8_t>(reader.row_size() * 8);
+  REQUIRE(reader.ReadRows(rows.data(), 8) == 8);
+  REQUIRE_THROWS_MATCHES(reader.ReadRows(rows.data(), 8), std::runtime_error,
+                         ExceptionContentMatcher("failed reading 60 bytes"));
+}
+
+TEST_CASE("PNM READER - Read rows") {
+  auto constexpr width = std::size_t{7};
+  auto constexpr height = std::size_t{5};
+  auto const write_pixels = GradientPixelData(width * height * 3);
+  auto ss = std::stringstream{};
+  thinks::WritePpmImage(ss, width, height, write_pixels.data());
+
+  auto reader = thinks::PnmReader(ss);
+  REQUIRE(reader.format() == thinks::PnmFormat::kPpm);
+  REQUIRE(reader.width() == width);
+  REQUIRE(reader.height() == height);
+  REQUIRE(reader.channels() == 3);
+  REQUIRE(reader.row_size() == width * 3);
+
+  auto read_pixels = std::vector<std::uint8_t>(write_pixels.size());
+  REQUIRE(reader.ReadRows(read_pixels.data(), 3) == 3);
+  REQUIRE(reader.rows_read() == 3);
+  REQUIRE(reader.rows_remaining() == 2);
+
+  // Asking for more rows than remain reads only the remaining rows.
+  REQUIRE(reader.ReadRows(read_pixels.data() + 3 * reader.row_size(), 10) ==
+          2);
+  REQUIRE(reader.ReadRows(read_pixels.data(), 1) == 0);
+  REQUIRE(read_pixels == write_pixels);
+}
+
+TEST_CASE("PNM READER - Strips cover image") {
+  auto constexpr width = std::size_t{31};
+  auto constexpr height = std::size_t{17};
+  auto const write_pixels = GradientPixelData(width * height);
+  auto ss = std::stringstream{};
+  thinks::WritePgmImage(ss, width, height, write_pixels.data());
+
+  auto reader = thinks::PnmReader(ss);
+  REQUIRE(reader.format() == thinks::PnmFormat::kPgm);
+
+  auto read_pixels = std::vector<std::uint8_t>{};
+  auto strip_count = std::size_t{0};
+  reader.ForEachStrip(
+      4, [&](std::size_t const first_row, std::size_t const row_count,
+             std::uint8_t const* const pixel_data) {
+        REQUIRE(first_row == strip_count * 4);
+        REQUIRE(row_count == (first_row + 4 <= height ? 4 : height % 4));
+        read_pixels.insert(read_pixels.end(), pixel_data,
+                           pixel_data + row_count * width);
+        ++strip_count;
+      });
+
+  REQUIRE(strip_count == 5);
+  REQUIRE(reader.rows_remaining() == 0);
+  REQUIRE(read_pixels == write_pixels);
+}
+
+TEST_CASE("PNM FRAME READER - Zero buffer size throws") {
+  auto ss = std::stringstream{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::PnmFrameReader(ss, 0), std::invalid_argument,
+      ExceptionContentMatcher("buffer size must be non-zero"));
+}
+
+TEST_CASE("PNM FRAME READER - Plain frame throws") {
+  auto ss = std::stringstream{};
+  ss << "P2\n2 1\n255\n1 2\n";
+
+  auto reader = thinks::PnmFrameReader(ss);
+  REQUIRE_THROWS_MATCHES(
+      reader.Next(), std::runtime_error,
+      ExceptionContentMatcher("unsupported magic number 'P2'"));
+}
+
+TEST_CASE("PNM FRAME READER - Truncated frame throws") {
+  auto ss = std::stringstream{};
+  auto const pixel_data = GradientPixelData(10 * 10);
+  thinks::WritePgmImage(ss, 10, 10, pixel_data.data());
+  ss << "P5\n10 10\n255\n" << std::string(99, 'x');
+
+  auto reader = thinks::PnmFrameReader(ss);
+  REQUIRE(reader.Next());
+  REQUIRE_THROWS_MATCHES(reader.Next(), std::runtime_error,
+                         ExceptionContentMatcher("failed reading 100 bytes"));
+}
+
+TEST_CASE("PNM FRAME READER - Does not read beyond the current frame") {
+  // Small frames, each shorter than a typical read-ahead.
+  auto const pixel_data = GradientPixelData(3 * 2);
+  auto ss = std::stringstream{};
+  thinks::WritePgmImage(ss, 3, 2, pixel_data.data());
+  auto const frame = ss.str();
+  ss << "\n";
+  thinks::WritePgmImage(ss, 3, 2, pixel_data.data());
+
+  ChunkedStreamBuf buf(ss.str());
+  std::istream is(&buf);
+  auto reader = thinks::PnmFrameReader(is);
+  buf.set_available(frame.size());
+  REQUIRE(reader.Next());
+  REQUIRE(std::vector<std::uint8_t>(reader.pixel_data(),
+                                    reader.pixel_data() +
+                                        reader.frame_size()) == pixel_data);
+
+  buf.set_available(ss.str().size());
+  REQUIRE(reader.Next());
+  REQUIRE(reader.frames_read() == 2);
+  REQUIRE(!reader.Next());
+}
+
+TEST_CASE("PNM FRAME READER - Read frames") {
+  auto const ppm_pixels = GradientPixelData(13 * 7 * 3);
+  auto const pgm_pixels = GradientPixelData(5 * 3 * 2);
+  auto ss = std::stringstream{};
+  for (auto i = 0; i < 3; ++i) {
+    thinks::WritePpmImage(ss, 13, 7, ppm_pixels.data());
+  }
+  ss << "\n";  // Whitespace between frames is skipped.
+  auto pgm16 = std::vector<std::uint16_t>(5 * 3);
+  for (auto i = std::size_t{0}; i < pgm16.size(); ++i) {
+    pgm16[i] = static_cast<std::uint16_t>(
+        (pgm_pixels[2 * i] << 8) | pgm_pixels[2 * i + 1]);
+  }
+  thinks::WritePgmImage(ss, 5, 3, pgm16.data());
+  thinks::WritePamImage(ss, 2, 2, 4, "RGB_ALPHA", ppm_pixels.data());
+
+  // A small buffer size exercises frames spanning several buffer fills.
+  for (auto const buffer_size : {std::size_t{7}, std::size_t{1} << 20}) {
+    auto is = std::stringstream(ss.str());
+    auto reader = thinks::PnmFrameReader(is, buffer_size);
+    for (auto i = std::size_t{0}; i < 3; ++i) {
+      REQUIRE(reader.Next());
+      REQUIRE(reader.frames_read() == i + 1);
+      REQUIRE(reader.magic_number() == "P6");
+      REQUIRE(reader.width() == 13);
+      REQUIRE(reader.height() == 7);
+      REQUIRE(reader.depth() == 3);
+      REQUIRE(std::vector<std::uint8_t>(
+                  reader.pixel_data(),
+                  reader.pixel_data() + reader.frame_size()) == ppm_pixels);
+      REQUIRE(reader.frame_latency().count() >= 0);
+    }
+
+    REQUIRE(reader.Next());
+    REQUIRE(reader.magic_number() == "P5");
+    REQUIRE(reader.max_value() == 65535);
+    REQUIRE(std::vector<std::uint8_t>(
+                reader.pixel_data(),
+                reader.pixel_data() + reader.frame_size()) == pgm_pixels);
+
+    REQUIRE(reader.Next());
+    REQUIRE(reader.magic_number() == "P7");
+    REQUIRE(reader.depth() == 4);
+    REQUIRE(reader.tuple_type() == "RGB_ALPHA");
+    REQUIRE(reader.frame_size() == 2 * 2 * 4);
+
+    REQUIRE(!reader.Next());
+    REQUIRE(reader.frames_read() == 5);
+  }
+}
@@ -0,0 +1,118 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+
+TEST_CASE("PNM WRITER - Invalid width throws") {
+  auto oss = std::ostringstream{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::PnmWriter(oss, thinks::PnmFormat::kPpm, 0, 10),
+      std::invalid_argument,
+      ExceptionContentMatcher("width must be non-zero"));
+}
+
+TEST_CASE("PNM WRITER - Invalid filename throws") {
+  // Not checking error message since it is OS dependent.
+  REQUIRE_THROWS_AS(
+      thinks::PnmWriter(std::string{}, thinks::PnmFormat::kPpm, 10, 10),
+      std::runtime_error);
+}
+
+TEST_CASE("PNM WRITER - Too many rows throws") {
+  auto const pixel_data = GradientPixelData(10 * 10);
+  auto oss = std::ostringstream{};
+  auto writer = thinks::PnmWriter(oss, thinks::PnmFormat::kPgm, 10, 10);
+  writer.WriteRows(pixel_data.data(), 8);
+  REQUIRE_THROWS_MATCHES(
+      writer.WriteRows(pixel_data.data(), 3), std::invalid_argument,
+      ExceptionContentMatcher("cannot write 3 rows, 2 rows remaining"));
+}
+
+TEST_CASE("PNM WRITER - Close incomplete image throws") {
+  auto const pixel_data = GradientPixelData(10 * 3);
+  auto oss = std::ostringstream{};
+  auto writer = thinks::PnmWriter(oss, thinks::PnmFormat::kPpm, 10, 10);
+  writer.WriteRow(pixel_data.data());
+  REQUIRE_THROWS_MATCHES(
+      writer.Close(), std::runtime_error,
+      ExceptionContentMatcher("image incomplete, wrote 1 of 10 rows"));
+}
+
+TEST_CASE("PNM WRITER - Strips match whole image write") {
+  auto constexpr width = std::size_t{13};
+  auto constexpr height = std::size_t{11};
+  auto const pixel_data = GradientPixelData(width * height * 3);
+
+  auto expected = std::ostringstream{};
+  thinks::WritePpmImage(expected, width, height, pixel_data.data());
+
+  auto oss = std::ostringstream{};
+  auto writer = thinks::PnmWriter(oss, thinks::PnmFormat::kPpm, width, height);
+  REQUIRE(writer.row_size() == width * 3);
+  for (auto row = std::size_t{0}; row < height; row += 4) {
+    auto const row_count = height - row < 4 ? height - row : 4;
+    writer.WriteRows(pixel_data.data() + row * writer.row_size(), row_count);
+  }
+  REQUIRE(writer.rows_written() == height);
+  writer.Close();
+
+  REQUIRE(oss.str() == expected.str());
+}
+
+TEST_CASE("PNM WRITER - Round-trip file") {
+  auto constexpr width = std::size_t{9};
+  auto constexpr height = std::size_t{6};
+  auto const filename = std::string{"pnm_writer_test.pgm"};
+  auto const write_pixels = GradientPixelData(width * height);
+
+  auto writer =
+      thinks::PnmWriter(filename, thinks::PnmFormat::kPgm, width, height);
+  for (auto row = std::size_t{0}; row < height; ++row) {
+    writer.WriteRow(write_pixels.data() + row * width);
+  }
+  writer.Close();
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = std::vector<std::uint8_t>{};
+  thinks::ReadPgmImage(filename, &read_width, &read_height, &read_pixels);
+  REQUIRE(read_width == width);
+  REQUIRE(read_height == height);
+  REQUIRE(read_pixels == write_pixels);
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("PNM WRITER - Round-trip 16-bit rows") {
+  auto constexpr width = std::size_t{19};
+  auto constexpr height = std::size_t{7};
+  auto write_pixels = std::vector<std::uint16_t>(width * height * 3);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = static_cast<std::uint16_t>(i * 131);
+  }
+
+  auto ss = std::stringstream{};
+  auto writer = thinks::PnmWriter(ss, thinks::PnmFormat::kPpm, width, height,
+                                  65535);
+  REQUIRE(writer.bytes_per_sample() == 2);
+  REQUIRE(writer.row_size() == width * 3 * 2);
+  for (auto row = std::size_t{0}; row < height; ++row) {
+    writer.WriteRows(write_pixels.data() + row * width * 3, 1);
+  }
+  writer.Close();
+
+  auto reader = thinks::PnmReader(ss);
+  REQUIRE(reader.max_value() == 65535);
+  auto read_pixels = std::vector<std::uint16_t>(write_pixels.size());
+  REQUIRE(reader.ReadRows(read_pixels.data(), height) == height);
+  REQUIRE(read_pixels == write_pixels);
+}
@@ -2,6 +2,7 @@
 // This file is subject to the license terms in the LICENSE file
 // found in the top-level directory of this distribution.
 
+#include <algorithm>
 #include <cstdint>
 #include <exception>
 #include <iostream>
@@ -130,7 +131,7 @@ TEST_CASE("PPM - Read invalid height throws") {
 TEST_CASE("PPM - Read invalid max value throws") {
   auto ss = std::stringstream{};
   WriteInvalidPpmImage(ss, "P6",
-                       254,  // Invalid.
+                       0,  // Invalid.
                        10, 10, ValidPixelData(10, 10));
 
   auto width = std::size_t{0};
@@ -139,7 +140,23 @@ TEST_CASE("PPM - Read invalid max value throws") {
   REQUIRE_THROWS_MATCHES(
       thinks::ReadPpmImage(ss, &width, &height, &pixel_data),
       std::runtime_error,
-      ExceptionContentMatcher("max value must be 255, was 254"));
+      ExceptionContentMatcher("max value must be in range [1, 65535], was 0"));
+}
+
+TEST_CASE("PPM - Read 16-bit max value into 8-bit pixel data throws") {
+  auto ss = std::stringstream{};
+  WriteInvalidPpmImage(ss, "P6",
+                       1023,  // Invalid for 8-bit pixel data.
+                       10, 10, ValidPixelData(10, 10 * 2));
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPpmImage(ss, &width, &height, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher(
+          "max value must be at most 255 for 8-bit pixel data, was 1023"));
 }
 
 TEST_CASE("PPM - Read invalid file size throws") {
@@ -185,3 +202,137 @@ TEST_CASE("PPM - Round-trip") {
   REQUIRE(read_height == write_height);
   REQUIRE(read_pixels == write_pixels);
 }
+
+TEST_CASE("PPM - Write invalid 16-bit max value throws") {
+  auto constexpr width = std::size_t{10};
+  auto constexpr height = std::size_t{10};
+  auto const pixel_data = std::vector<std::uint16_t>(width * height * 3);
+  auto oss = std::ostringstream{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::WritePpmImage(oss, width, height, pixel_data.data(), 70000),
+      std::invalid_argument,
+      ExceptionContentMatcher(
+          "max value must be in range [1, 65535], was 70000"));
+}
+
+TEST_CASE("PPM - Round-trip 16-bit") {
+  // Odd sizes exercise both vectorized and scalar conversion paths.
+  auto constexpr write_width = std::size_t{37};
+  auto constexpr write_height = std::size_t{23};
+  auto constexpr write_max_value = std::uint32_t{4095};
+  auto write_pixels =
+      std::vector<std::uint16_t>(write_width * write_height * 3);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = static_cast<std::uint16_t>((i * 97) % 4096);
+  }
+
+  auto ss = std::stringstream{};
+  thinks::WritePpmImage(ss, write_width, write_height, write_pixels.data(),
+                        write_max_value);
+
+  // Samples are stored big-endian.
+  auto const encoded = ss.str();
+  auto const raster = encoded.substr(encoded.size() - write_pixels.size() * 2);
+  REQUIRE(static_cast<std::uint8_t>(raster[2]) == (write_pixels[1] >> 8));
+  REQUIRE(static_cast<std::uint8_t>(raster[3]) == (write_pixels[1] & 0xff));
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_max_value = std::uint32_t{0};
+  auto read_pixels = std::vector<std::uint16_t>{};
+  thinks::ReadPpmImage(ss, &read_width, &read_height, &read_pixels,
+                       &read_max_value);
+
+  REQUIRE(read_width == write_width);
+  REQUIRE(read_height == write_height);
+  REQUIRE(read_max_value == write_max_value);
+  REQUIRE(read_pixels == write_pixels);
+}
+
+TEST_CASE("PPM - Read 8-bit image into 16-bit pixel data") {
+  auto constexpr width = std::size_t{29};
+  auto constexpr height = std::size_t{13};
+  auto write_pixels = std::vector<std::uint8_t>(width * height * 3);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = static_cast<std::uint8_t>(i % 100);
+  }
+  auto ss = std::stringstream{};
+  WriteInvalidPpmImage(ss, "P6", 99, width, height, write_pixels);
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_max_value = std::uint32_t{0};
+  auto read_pixels = std::vector<std::uint16_t>{};
+  thinks::ReadPpmImage(ss, &read_width, &read_height, &read_pixels,
+                       &read_max_value, thinks::SampleScaling::kFullRange);
+
+  REQUIRE(read_max_value == 99);
+  REQUIRE(read_pixels.size() == write_pixels.size());
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    auto const expected = (write_pixels[i] * 65535u + 49u) / 99u;
+    REQUIRE(read_pixels[i] == expected);
+  }
+}
+
+TEST_CASE("PPM - Read into too small buffer throws") {
+  auto constexpr width = std::size_t{10};
+  auto constexpr height = std::size_t{10};
+  auto ss = std::stringstream{};
+  thinks::WritePpmImage(ss, width, height,
+                        ValidPixelData(width, height).data());
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto buffer = std::vector<std::uint8_t>(width * height * 3 - 1);  // Invalid.
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPpmImage(ss, &read_width, &read_height, buffer.data(),
+                           buffer.size()),
+      std::runtime_error,
+      ExceptionContentMatcher(
+          "pixel data requires 300 samples, capacity is 299"));
+  REQUIRE(read_width == width);
+  REQUIRE(read_height == height);
+}
+
+TEST_CASE("PPM - Read into reused buffer") {
+  // A single buffer, large enough for all images.
+  auto buffer = std::vector<std::uint8_t>(64 * 64 * 3);
+  for (auto size = std::size_t{8}; size <= 64; size *= 2) {
+    auto write_pixels = ValidPixelData(size, size / 2);
+    for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+      write_pixels[i] = static_cast<std::uint8_t>(i + size);
+    }
+    auto ss = std::stringstream{};
+    thinks::WritePpmImage(ss, size, size / 2, write_pixels.data());
+
+    auto read_width = std::size_t{0};
+    auto read_height = std::size_t{0};
+    thinks::ReadPpmImage(ss, &read_width, &read_height, buffer.data(),
+                         buffer.size());
+    REQUIRE(read_width == size);
+    REQUIRE(read_height == size / 2);
+    REQUIRE(std::equal(write_pixels.begin(), write_pixels.end(),
+                       buffer.begin()));
+  }
+}
+
+TEST_CASE("PPM - Read into uninitialized vector") {
+  auto constexpr write_width = std::size_t{33};
+  auto constexpr write_height = std::size_t{7};
+  auto write_pixels =
+      std::vector<std::uint16_t>(write_width * write_height * 3);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i] = static_cast<std::uint16_t>(i * 257);
+  }
+  auto ss = std::stringstream{};
+  thinks::WritePpmImage(ss, write_width, write_height, write_pixels.data());
+
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  auto read_pixels = thinks::UninitializedVector<std::uint16_t>{};
+  thinks::ReadPpmImage(ss, &read_width, &read_height, &read_pixels);
+  REQUIRE(read_width == write_width);
+  REQUIRE(read_height == write_height);
+  REQUIRE(std::vector<std::uint16_t>(read_pixels.begin(), read_pixels.end()) ==
+          write_pixels);
+}
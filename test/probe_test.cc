@@ -0,0 +1,169 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_probe.h"
+
+namespace {
+
+void WriteText(std::string const& filename, std::string const& text) {
+  auto ofs = std::ofstream(filename, std::ios::binary);
+  ofs << text;
+}
+
+void MakeDirectory(std::string const& directory) {
+#if defined(_WIN32)
+  _mkdir(directory.c_str());
+#else
+  mkdir(directory.c_str(), 0755);
+#endif
+}
+
+void RemoveDirectory(std::string const& directory) {
+#if defined(_WIN32)
+  _rmdir(directory.c_str());
+#else
+  rmdir(directory.c_str());
+#endif
+}
+
+}  // namespace
+
+TEST_CASE("PROBE - Invalid filename throws") {
+  // Not checking error message since it is OS dependent.
+  REQUIRE_THROWS_AS(thinks::ProbePnm(std::string{}), std::runtime_error);
+}
+
+TEST_CASE("PROBE - Invalid magic number throws") {
+  auto const filename = std::string{"probe_test_magic.pgm"};
+  WriteText(filename, "GIF89a");
+  REQUIRE_THROWS_MATCHES(
+      thinks::ProbePnm(filename), std::runtime_error,
+      ExceptionContentMatcher("unsupported magic number 'GI'"));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("PROBE - Truncated pixel data throws") {
+  auto const filename = std::string{"probe_test_truncated.ppm"};
+  auto const pixel_data = GradientPixelData(10 * 9 * 3);
+  WriteText(filename,
+            "P6\n10 10\n255\n" +
+                std::string(pixel_data.begin(), pixel_data.end()));
+  REQUIRE_THROWS_MATCHES(
+      thinks::ProbePnm(filename), std::runtime_error,
+      ExceptionContentMatcher("pixel data requires 300 bytes, file has 270"));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("PROBE - Probe PPM") {
+  auto constexpr width = std::size_t{17};
+  auto constexpr height = std::size_t{5};
+  auto const filename = std::string{"probe_test.ppm"};
+  auto const pixel_data = GradientPixelData(width * height * 3);
+  thinks::WritePpmImage(filename, width, height, pixel_data.data());
+
+  auto const info = thinks::ProbePnm(filename);
+  REQUIRE(info.magic_number == "P6");
+  REQUIRE(info.width == width);
+  REQUIRE(info.height == height);
+  REQUIRE(info.depth == 3);
+  REQUIRE(info.max_value == 255);
+  REQUIRE(info.raster_offset == std::string("P6\n17\n5\n255\n").size());
+  REQUIRE(info.raster_size == pixel_data.size());
+  REQUIRE(info.file_size == info.raster_offset + info.raster_size);
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("PROBE - Probe header with long comment") {
+  // Header larger than the probe read buffer.
+  auto const filename = std::string{"probe_test_comment.pgm"};
+  auto const header =
+      "P5\n#" + std::string(3000, 'x') + "\n4 2\n65535\n";
+  WriteText(filename, header + std::string(4 * 2 * 2, '\0'));
+
+  auto const info = thinks::ProbePnm(filename);
+  REQUIRE(info.magic_number == "P5");
+  REQUIRE(info.depth == 1);
+  REQUIRE(info.max_value == 65535);
+  REQUIRE(info.raster_offset == header.size());
+  REQUIRE(info.raster_size == 16);
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("PROBE - Probe PBM and PAM") {
+  auto const pbm_filename = std::string{"probe_test.pbm"};
+  WriteText(pbm_filename, "P4\n10 3\n" + std::string(2 * 3, '\0'));
+  auto const pbm_info = thinks::ProbePnm(pbm_filename);
+  REQUIRE(pbm_info.depth == 1);
+  REQUIRE(pbm_info.max_value == 1);
+  REQUIRE(pbm_info.raster_size == 6);
+  std::remove(pbm_filename.c_str());
+
+  auto const pam_filename = std::string{"probe_test.pam"};
+  auto const pixel_data = GradientPixelData(3 * 2 * 4);
+  thinks::WritePamImage(pam_filename, 3, 2, 4, "RGB_ALPHA",
+                        pixel_data.data());
+  auto const pam_info = thinks::ProbePnm(pam_filename);
+  REQUIRE(pam_info.depth == 4);
+  REQUIRE(pam_info.tuple_type == "RGB_ALPHA");
+  REQUIRE(pam_info.raster_size == pixel_data.size());
+  std::remove(pam_filename.c_str());
+}
+
+TEST_CASE("PROBE - Index directory") {
+  auto const directory = std::string{"probe_test_dir"};
+  MakeDirectory(directory);
+  auto const pixel_data = GradientPixelData(4 * 3 * 3);
+  thinks::WritePgmImage(directory + "/b.pgm", 4, 3, pixel_data.data());
+  thinks::WritePpmImage(directory + "/a.PPM", 4, 3, pixel_data.data());
+  WriteText(directory + "/c.pnm", "P6\n4 3\n255\n");
+  WriteText(directory + "/notes.txt", "P5\n4 3\n255\n");
+  MakeDirectory(directory + "/d.pgm");  // Not a regular file.
+
+  auto const entries = thinks::IndexPnmDirectory(directory, 2);
+  REQUIRE(entries.size() == 3);
+  REQUIRE(entries[0].filename == directory + "/a.PPM");
+  REQUIRE(entries[0].error.empty());
+  REQUIRE(entries[0].info.depth == 3);
+  REQUIRE(entries[1].filename == directory + "/b.pgm");
+  REQUIRE(entries[1].info.raster_size == 4 * 3);
+  REQUIRE(entries[2].filename == directory + "/c.pnm");
+  REQUIRE(entries[2].error == "pixel data requires 36 bytes, file has 0");
+
+  auto oss = std::ostringstream{};
+  thinks::WritePnmIndex(oss, entries);
+  auto const index = oss.str();
+  REQUIRE(index.find(directory + "/b.pgm\tP5\t4\t3\t1\t255\t") !=
+          std::string::npos);
+  REQUIRE(index.find(directory + "/c.pnm\t\t\t\t\t\t\t\tpixel data") !=
+          std::string::npos);
+
+  for (auto const name : {"a.PPM", "b.pgm", "c.pnm", "notes.txt"}) {
+    std::remove((directory + "/" + name).c_str());
+  }
+  RemoveDirectory(directory + "/d.pgm");
+  RemoveDirectory(directory);
+}
+
+TEST_CASE("PROBE - Index invalid directory throws") {
+  // Not checking error message since it is OS dependent.
+  REQUIRE_THROWS_AS(thinks::IndexPnmDirectory("probe_test_missing_dir"),
+                    std::runtime_error);
+}
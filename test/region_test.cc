@@ -0,0 +1,131 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_region.h"
+
+namespace {
+
+// Crop a region from whole image pixel data.
+std::vector<std::uint8_t> Crop(std::vector<std::uint8_t> const& pixel_data,
+                               std::size_t const image_width,
+                               std::size_t const pixel_size,
+                               thinks::PnmRegion const& region) {
+  auto region_data = std::vector<std::uint8_t>{};
+  for (auto row = region.y; row < region.y + region.height; ++row) {
+    auto const begin =
+        pixel_data.begin() + (row * image_width + region.x) * pixel_size;
+    region_data.insert(region_data.end(), begin,
+                       begin + region.width * pixel_size);
+  }
+  return region_data;
+}
+
+thinks::PnmRegion MakeRegion(std::size_t const x, std::size_t const y,
+                             std::size_t const width,
+                             std::size_t const height) {
+  auto region = thinks::PnmRegion{};
+  region.x = x;
+  region.y = y;
+  region.width = width;
+  region.height = height;
+  return region;
+}
+
+}  // namespace
+
+TEST_CASE("REGION - Outside image throws") {
+  auto const filename = std::string{"region_test.pgm"};
+  auto const write_pixels = GradientPixelData(10 * 10);
+  thinks::WritePgmImage(filename, 10, 10, write_pixels.data());
+
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPgmRegion(filename, 5, 2, 6, 2, &pixel_data),
+      std::invalid_argument,
+      ExceptionContentMatcher("region 6x2 at (5, 2) is outside 10x10 image"));
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPgmRegion(filename, 0, 0, 0, 2, &pixel_data),
+      std::invalid_argument,
+      ExceptionContentMatcher("region width and height must be non-zero"));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("REGION - Bitmap throws") {
+  auto const filename = std::string{"region_test.pbm"};
+  {
+    auto ofs = std::ofstream(filename, std::ios::binary);
+    ofs << "P4\n8 1\n" << '\xff';
+  }
+  REQUIRE_THROWS_MATCHES(
+      thinks::PnmRegionReader(filename), std::runtime_error,
+      ExceptionContentMatcher("unsupported magic number 'P4'"));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("REGION - Invalid magic number throws") {
+  auto const filename = std::string{"region_test.ppm"};
+  auto const write_pixels = GradientPixelData(10 * 10);
+  thinks::WritePgmImage(filename, 10, 10, write_pixels.data());
+
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPpmRegion(filename, 0, 0, 2, 2, &pixel_data),
+      std::runtime_error,
+      ExceptionContentMatcher("magic number must be 'P6', was 'P5'"));
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("REGION - Read PPM regions") {
+  // Narrow enough for bands of rows, wide enough to skip gaps between rows.
+  for (auto const width : {std::size_t{61}, std::size_t{2011}}) {
+    auto constexpr height = std::size_t{37};
+    auto const filename = std::string{"region_test.ppm"};
+    auto const write_pixels = GradientPixelData(width * height * 3);
+    thinks::WritePpmImage(filename, width, height, write_pixels.data());
+
+    auto const regions = std::vector<thinks::PnmRegion>{
+        MakeRegion(3, 20, 17, 11), MakeRegion(0, 0, width, 2),
+        MakeRegion(width - 1, height - 1, 1, 1), MakeRegion(5, 4, 40, 30)};
+    auto regions_data = std::vector<std::vector<std::uint8_t>>{};
+    auto max_value = std::uint32_t{0};
+    thinks::ReadPpmRegions(filename, regions, &regions_data, &max_value);
+    REQUIRE(max_value == 255);
+    REQUIRE(regions_data.size() == regions.size());
+    for (auto i = std::size_t{0}; i < regions.size(); ++i) {
+      REQUIRE(regions_data[i] == Crop(write_pixels, width, 3, regions[i]));
+    }
+
+    auto pixel_data = std::vector<std::uint8_t>{};
+    thinks::ReadPpmRegion(filename, 5, 4, 40, 30, &pixel_data);
+    REQUIRE(pixel_data == regions_data[3]);
+    std::remove(filename.c_str());
+  }
+}
+
+TEST_CASE("REGION - Read PAM region") {
+  auto constexpr width = std::size_t{23};
+  auto constexpr height = std::size_t{19};
+  auto const filename = std::string{"region_test.pam"};
+  auto const write_pixels = GradientPixelData(width * height * 4);
+  thinks::WritePamImage(filename, width, height, 4, "RGB_ALPHA",
+                        write_pixels.data());
+
+  auto const reader = thinks::PnmRegionReader(filename);
+  REQUIRE(reader.pixel_size() == 4);
+  auto const region = MakeRegion(7, 3, 9, 12);
+  auto pixel_data = std::vector<std::uint8_t>(reader.RegionSize(region));
+  reader.Read(region, pixel_data.data());
+  REQUIRE(pixel_data == Crop(write_pixels, width, 4, region));
+  std::remove(filename.c_str());
+}
@@ -0,0 +1,186 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_strided.h"
+
+namespace {
+
+// Copy a sub-rectangle out of a framebuffer with @p stride bytes per row.
+std::vector<std::uint8_t> PackRows(std::uint8_t const* const data,
+                                   std::size_t const row_size,
+                                   std::size_t const stride,
+                                   std::size_t const height) {
+  auto packed = std::vector<std::uint8_t>{};
+  for (auto row = std::size_t{0}; row < height; ++row) {
+    packed.insert(packed.end(), data + row * stride,
+                  data + row * stride + row_size);
+  }
+  return packed;
+}
+
+std::string ReadFileBytes(std::string const& filename) {
+  auto ifs = std::ifstream(filename, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(ifs),
+                     std::istreambuf_iterator<char>());
+}
+
+}  // namespace
+
+TEST_CASE("STRIDED - Write sub-rectangle matches packed write") {
+  // A 20x10 region at (5, 3) of a 64x32 RGB framebuffer.
+  constexpr auto fb_width = std::size_t{64};
+  constexpr auto width = std::size_t{20};
+  constexpr auto height = std::size_t{10};
+  auto const framebuffer = GradientPixelData(fb_width * 32 * 3);
+  auto const* const origin = framebuffer.data() + (3 * fb_width + 5) * 3;
+  auto rows = thinks::RowLayout{};
+  rows.stride = fb_width * 3;
+  auto const packed = PackRows(origin, width * 3, rows.stride, height);
+
+  auto expected_oss = std::ostringstream{};
+  thinks::WritePpmImage(expected_oss, width, height, packed.data());
+  auto oss = std::ostringstream{};
+  thinks::WritePpmImage(oss, width, height, origin, rows);
+  REQUIRE(oss.str() == expected_oss.str());
+
+  auto const filename = std::string{"strided_test_write.ppm"};
+  thinks::WritePpmImage(filename, width, height, origin, rows);
+  REQUIRE(ReadFileBytes(filename) == expected_oss.str());
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("STRIDED - Write more rows than IOV_MAX") {
+  constexpr auto width = std::size_t{3};
+  constexpr auto height = std::size_t{5000};
+  constexpr auto stride = std::size_t{8};
+  auto const pixel_data = GradientPixelData(height * stride);
+  auto rows = thinks::RowLayout{};
+  rows.stride = stride;
+
+  auto expected_oss = std::ostringstream{};
+  thinks::WritePgmImage(
+      expected_oss, width, height,
+      PackRows(pixel_data.data(), width, stride, height).data());
+  auto const filename = std::string{"strided_test_many_rows.pgm"};
+  thinks::WritePgmImage(filename, width, height, pixel_data.data(), rows);
+  REQUIRE(ReadFileBytes(filename) == expected_oss.str());
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("STRIDED - Write stride less than row size throws") {
+  auto const pixel_data = GradientPixelData(10 * 10 * 3);
+  auto rows = thinks::RowLayout{};
+  rows.stride = 29;
+  auto oss = std::ostringstream{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::WritePpmImage(oss, 10, 10, pixel_data.data(), rows),
+      std::invalid_argument,
+      ExceptionContentMatcher("row stride must be at least 30 bytes, was 29"));
+  REQUIRE(oss.str().empty());
+}
+
+TEST_CASE("STRIDED - Read into pitched buffer") {
+  constexpr auto width = std::size_t{21};
+  constexpr auto height = std::size_t{13};
+  auto const write_pixels = GradientPixelData(width * height * 3);
+  auto oss = std::ostringstream{};
+  thinks::WritePpmImage(oss, width, height, write_pixels.data());
+
+  // Rows aligned to 64 bytes, padding must be left untouched.
+  auto rows = thinks::RowLayout{};
+  rows.stride = 64;
+  auto buffer = std::vector<std::uint8_t>(rows.stride * height, 0xAB);
+  auto iss = std::istringstream(oss.str());
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  thinks::ReadPpmImage(iss, &read_width, &read_height, buffer.data(),
+                       buffer.size(), rows);
+  REQUIRE(read_width == width);
+  REQUIRE(read_height == height);
+  REQUIRE(PackRows(buffer.data(), width * 3, rows.stride, height) ==
+          write_pixels);
+  REQUIRE(buffer[width * 3] == 0xAB);
+  REQUIRE(buffer.back() == 0xAB);
+}
+
+TEST_CASE("STRIDED - Write bottom-up matches flipped write") {
+  constexpr auto width = std::size_t{17};
+  constexpr auto height = std::size_t{9};
+  auto const bottom_up = GradientPixelData(width * height * 3);
+  auto top_down = std::vector<std::uint8_t>{};
+  for (auto row = height; row > 0; --row) {
+    auto const* const src = bottom_up.data() + (row - 1) * width * 3;
+    top_down.insert(top_down.end(), src, src + width * 3);
+  }
+  auto expected_oss = std::ostringstream{};
+  thinks::WritePpmImage(expected_oss, width, height, top_down.data());
+
+  auto rows = thinks::RowLayout{};
+  rows.order = thinks::RowOrder::kBottomUp;
+  auto oss = std::ostringstream{};
+  thinks::WritePpmImage(oss, width, height, bottom_up.data(), rows);
+  REQUIRE(oss.str() == expected_oss.str());
+
+  auto const filename = std::string{"strided_test_bottom_up.ppm"};
+  thinks::WritePpmImage(filename, width, height, bottom_up.data(), rows);
+  REQUIRE(ReadFileBytes(filename) == expected_oss.str());
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("STRIDED - Read bottom-up round-trip") {
+  constexpr auto width = std::size_t{11};
+  constexpr auto height = std::size_t{7};
+  auto rows = thinks::RowLayout{};
+  rows.stride = 16;
+  rows.order = thinks::RowOrder::kBottomUp;
+  auto const write_pixels = GradientPixelData(rows.stride * height);
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, width, height, write_pixels.data(), rows);
+
+  // The top row of the file is the last row of the bottom-up buffer.
+  auto const file_pixels = oss.str().substr(oss.str().size() - width * height);
+  REQUIRE(static_cast<std::uint8_t>(file_pixels[0]) ==
+          write_pixels[(height - 1) * rows.stride]);
+
+  auto buffer = std::vector<std::uint8_t>(write_pixels.size());
+  auto iss = std::istringstream(oss.str());
+  auto read_width = std::size_t{0};
+  auto read_height = std::size_t{0};
+  thinks::ReadPgmImage(iss, &read_width, &read_height, buffer.data(),
+                       buffer.size(), rows);
+  REQUIRE(PackRows(buffer.data(), width, rows.stride, height) ==
+          PackRows(write_pixels.data(), width, rows.stride, height));
+}
+
+TEST_CASE("STRIDED - Read small capacity throws") {
+  auto const write_pixels = GradientPixelData(10 * 10);
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, 10, 10, write_pixels.data());
+
+  auto rows = thinks::RowLayout{};
+  rows.stride = 16;
+  auto buffer = std::vector<std::uint8_t>(16 * 9 + 9);
+  auto iss = std::istringstream(oss.str());
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPgmImage(iss, &width, &height, buffer.data(), buffer.size(),
+                           rows),
+      std::runtime_error,
+      ExceptionContentMatcher(
+          "pixel data requires 154 bytes, capacity is 153"));
+}
@@ -0,0 +1,130 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_thumbnail.h"
+
+namespace {
+
+std::vector<std::uint8_t> NoisePixelData(std::size_t const size) {
+  auto pixel_data = std::vector<std::uint8_t>(size);
+  auto state = std::uint32_t{12345};
+  for (auto& sample : pixel_data) {
+    state = state * 1103515245u + 12345u;
+    sample = static_cast<std::uint8_t>(state >> 24);
+  }
+  return pixel_data;
+}
+
+// Straightforward downscale of whole image pixel data.
+std::vector<std::uint8_t> Downscale(std::vector<std::uint8_t> const& src,
+                                    std::size_t const width,
+                                    std::size_t const height,
+                                    std::size_t const channel_count,
+                                    std::size_t const factor,
+                                    thinks::DownscaleFilter const filter) {
+  auto const out_width = (width + factor - 1) / factor;
+  auto const out_height = (height + factor - 1) / factor;
+  auto dst = std::vector<std::uint8_t>{};
+  for (auto y = std::size_t{0}; y < out_height; ++y) {
+    for (auto x = std::size_t{0}; x < out_width; ++x) {
+      auto const x_end = std::min(width, (x + 1) * factor);
+      auto const y_end = std::min(height, (y + 1) * factor);
+      for (auto c = std::size_t{0}; c < channel_count; ++c) {
+        if (filter == thinks::DownscaleFilter::kNearest) {
+          auto const src_x = std::min(x * factor + factor / 2, x_end - 1);
+          auto const src_y = std::min(y * factor + factor / 2, y_end - 1);
+          dst.push_back(src[(src_y * width + src_x) * channel_count + c]);
+          continue;
+        }
+        auto sum = std::uint32_t{0};
+        auto count = std::uint32_t{0};
+        for (auto src_y = y * factor; src_y < y_end; ++src_y) {
+          for (auto src_x = x * factor; src_x < x_end; ++src_x) {
+            sum += src[(src_y * width + src_x) * channel_count + c];
+            ++count;
+          }
+        }
+        dst.push_back(static_cast<std::uint8_t>((sum + count / 2) / count));
+      }
+    }
+  }
+  return dst;
+}
+
+}  // namespace
+
+TEST_CASE("THUMBNAIL - Invalid factor throws") {
+  auto const write_pixels = NoisePixelData(10 * 10);
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, 10, 10, write_pixels.data());
+
+  auto iss = std::istringstream(oss.str());
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto pixel_data = std::vector<std::uint8_t>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadPgmThumbnail(iss, 0, &width, &height, &pixel_data),
+      std::invalid_argument,
+      ExceptionContentMatcher(
+          "downscale factor must be in the range [1, 256], was 0"));
+}
+
+TEST_CASE("THUMBNAIL - Stream matches reference") {
+  auto constexpr width = std::size_t{101};
+  auto constexpr height = std::size_t{67};
+  auto const write_pixels = NoisePixelData(width * height * 3);
+  auto oss = std::ostringstream{};
+  thinks::WritePpmImage(oss, width, height, write_pixels.data());
+
+  for (auto const filter :
+       {thinks::DownscaleFilter::kBox, thinks::DownscaleFilter::kNearest}) {
+    for (auto const factor : {std::size_t{1}, std::size_t{2}, std::size_t{5},
+                              std::size_t{16}, std::size_t{200}}) {
+      auto iss = std::istringstream(oss.str());
+      auto read_width = std::size_t{0};
+      auto read_height = std::size_t{0};
+      auto read_pixels = std::vector<std::uint8_t>{};
+      thinks::ReadPpmThumbnail(iss, factor, &read_width, &read_height,
+                               &read_pixels, filter);
+      REQUIRE(read_width == (width + factor - 1) / factor);
+      REQUIRE(read_height == (height + factor - 1) / factor);
+      REQUIRE(read_pixels ==
+              Downscale(write_pixels, width, height, 3, factor, filter));
+    }
+  }
+}
+
+TEST_CASE("THUMBNAIL - File matches reference") {
+  auto constexpr width = std::size_t{257};
+  auto constexpr height = std::size_t{131};
+  auto const filename = std::string{"thumbnail_test.pgm"};
+  auto const write_pixels = NoisePixelData(width * height);
+  thinks::WritePgmImage(filename, width, height, write_pixels.data());
+
+  for (auto const filter :
+       {thinks::DownscaleFilter::kBox, thinks::DownscaleFilter::kNearest}) {
+    for (auto const thread_count : {std::size_t{1}, std::size_t{4}}) {
+      auto read_width = std::size_t{0};
+      auto read_height = std::size_t{0};
+      auto read_pixels = std::vector<std::uint8_t>{};
+      thinks::ReadPgmThumbnail(filename, 4, &read_width, &read_height,
+                               &read_pixels, filter, thread_count);
+      REQUIRE(read_width == 65);
+      REQUIRE(read_height == 33);
+      REQUIRE(read_pixels ==
+              Downscale(write_pixels, width, height, 1, 4, filter));
+    }
+  }
+  std::remove(filename.c_str());
+}
@@ -0,0 +1,145 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_tiled.h"
+
+namespace {
+
+constexpr auto kWidth = std::size_t{100};
+constexpr auto kHeight = std::size_t{70};
+
+std::vector<std::uint8_t> Crop(std::vector<std::uint8_t> const& pixel_data,
+                               thinks::PnmRegion const& region) {
+  auto region_data = std::vector<std::uint8_t>{};
+  for (auto row = region.y; row < region.y + region.height; ++row) {
+    auto const begin = pixel_data.begin() + (row * kWidth + region.x) * 3;
+    region_data.insert(region_data.end(), begin, begin + region.width * 3);
+  }
+  return region_data;
+}
+
+thinks::PnmRegion MakeRegion(std::size_t const x, std::size_t const y,
+                             std::size_t const width,
+                             std::size_t const height) {
+  auto region = thinks::PnmRegion{};
+  region.x = x;
+  region.y = y;
+  region.width = width;
+  region.height = height;
+  return region;
+}
+
+class TestFile {
+ public:
+  TestFile() : pixel_data_(GradientPixelData(kWidth * kHeight * 3)) {
+    thinks::WritePpmImage(filename(), kWidth, kHeight, pixel_data_.data());
+  }
+  ~TestFile() { std::remove(filename().c_str()); }
+
+  std::string filename() const { return "tiled_test.ppm"; }
+  std::vector<std::uint8_t> const& pixel_data() const { return pixel_data_; }
+
+ private:
+  std::vector<std::uint8_t> pixel_data_;
+};
+
+}  // namespace
+
+TEST_CASE("TILED - Tile outside grid throws") {
+  TestFile const file;
+  thinks::TiledPnmImage image(file.filename(), 16, 16);
+  REQUIRE(image.tile_columns() == 7);
+  REQUIRE(image.tile_rows() == 5);
+  REQUIRE_THROWS_MATCHES(
+      image.Pin(7, 0), std::invalid_argument,
+      ExceptionContentMatcher("tile (7, 0) is outside 7x5 tiles"));
+}
+
+TEST_CASE("TILED - Read regions") {
+  TestFile const file;
+  thinks::TiledPnmImage image(file.filename(), 16, 8);
+  auto const regions = std::vector<thinks::PnmRegion>{
+      MakeRegion(0, 0, kWidth, kHeight), MakeRegion(15, 7, 2, 2),
+      MakeRegion(90, 60, 10, 10), MakeRegion(33, 5, 40, 41)};
+  for (auto const& region : regions) {
+    auto pixel_data = std::vector<std::uint8_t>(image.RegionSize(region));
+    image.ReadRegion(region, pixel_data.data());
+    REQUIRE(pixel_data == Crop(file.pixel_data(), region));
+  }
+
+  // The first region loaded every tile, the others were all hits.
+  auto const stats = image.stats();
+  REQUIRE(stats.misses == 7 * 9);
+  REQUIRE(stats.bytes_read == kWidth * kHeight * 3);
+  REQUIRE(stats.cached_bytes == kWidth * kHeight * 3);
+  REQUIRE(stats.evictions == 0);
+  REQUIRE(stats.pinned_tiles == 0);
+  REQUIRE(stats.hits == 4 + 4 + 3 * 6);
+}
+
+TEST_CASE("TILED - Pinned tiles are not evicted") {
+  TestFile const file;
+  auto constexpr tile_size = std::size_t{10 * 10 * 3};
+  thinks::TiledPnmImage image(file.filename(), 10, 10, 2 * tile_size);
+
+  auto const pinned = image.Pin(3, 4);
+  REQUIRE(pinned.region().x == 30);
+  REQUIRE(pinned.region().y == 40);
+  for (auto ty = std::size_t{0}; ty < image.tile_rows(); ++ty) {
+    for (auto tx = std::size_t{0}; tx < image.tile_columns(); ++tx) {
+      auto tile = image.Pin(tx, ty);
+      REQUIRE(std::vector<std::uint8_t>(tile.pixel_data(),
+                                        tile.pixel_data() + tile_size) ==
+              Crop(file.pixel_data(), tile.region()));
+      tile.Unpin();
+      REQUIRE(!tile);
+      REQUIRE(image.stats().cached_bytes <= 2 * tile_size);
+    }
+  }
+  REQUIRE(image.stats().pinned_tiles == 1);
+  REQUIRE(std::vector<std::uint8_t>(pinned.pixel_data(),
+                                    pinned.pixel_data() + tile_size) ==
+          Crop(file.pixel_data(), pinned.region()));
+  REQUIRE(image.stats().evictions > 0);
+}
+
+TEST_CASE("TILED - Concurrent readers") {
+  TestFile const file;
+  thinks::TiledPnmImage image(file.filename(), 8, 8);
+  auto threads = std::vector<std::thread>{};
+  auto failures = std::vector<int>(8, 0);
+  for (auto t = std::size_t{0}; t < failures.size(); ++t) {
+    threads.emplace_back([&, t]() {
+      for (auto i = std::size_t{0}; i < 50; ++i) {
+        auto const x = (t * 13 + i * 7) % (kWidth - 20);
+        auto const y = (t * 5 + i * 11) % (kHeight - 20);
+        auto const region = MakeRegion(x, y, 20, 20);
+        auto pixel_data = std::vector<std::uint8_t>(image.RegionSize(region));
+        image.ReadRegion(region, pixel_data.data());
+        if (pixel_data != Crop(file.pixel_data(), region)) {
+          ++failures[t];
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  REQUIRE(failures == std::vector<int>(8, 0));
+
+  // No tile was read twice.
+  auto const stats = image.stats();
+  REQUIRE(stats.evictions == 0);
+  REQUIRE(stats.bytes_read == stats.cached_bytes);
+}
@@ -0,0 +1,192 @@
+// Copyright(C) 2018 Tommy Hinks <tommy.hinks@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "catch_utils.h"
+#include "thinks/pnm_io/pnm_io.h"
+#include "thinks/pnm_io/pnm_io_typed.h"
+
+namespace {
+
+// Spans several conversion blocks and is not a multiple of the vector
+// width.
+constexpr auto kWidth = std::size_t{61};
+constexpr auto kHeight = std::size_t{37};
+
+// Samples cycle through the full range [0, 255].
+std::vector<std::uint8_t> FullRangePixelData(std::size_t const size) {
+  auto pixel_data = std::vector<std::uint8_t>(size);
+  for (auto i = std::size_t{0}; i < pixel_data.size(); ++i) {
+    pixel_data[i] = static_cast<std::uint8_t>((i * 11) % 256);
+  }
+  return pixel_data;
+}
+
+}  // namespace
+
+TEST_CASE("TYPED - Round-trip Rgb8") {
+  auto write_pixels = std::vector<thinks::Rgb8>(kWidth * kHeight);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i].r = static_cast<std::uint8_t>(i);
+    write_pixels[i].g = static_cast<std::uint8_t>(i * 3);
+    write_pixels[i].b = static_cast<std::uint8_t>(i * 7);
+  }
+  auto oss = std::ostringstream{};
+  thinks::WriteImage<thinks::PnmFormat::kPpm>(oss, kWidth, kHeight,
+                                              write_pixels.data());
+
+  // Same bytes as the untyped writer.
+  auto untyped_oss = std::ostringstream{};
+  thinks::WritePpmImage(
+      untyped_oss, kWidth, kHeight,
+      reinterpret_cast<std::uint8_t const*>(write_pixels.data()));
+  REQUIRE(oss.str() == untyped_oss.str());
+
+  auto iss = std::istringstream(oss.str());
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto read_pixels = std::vector<thinks::Rgb8>{};
+  thinks::ReadImage<thinks::PnmFormat::kPpm>(iss, &width, &height,
+                                             &read_pixels);
+  REQUIRE(width == kWidth);
+  REQUIRE(height == kHeight);
+  REQUIRE(read_pixels.size() == write_pixels.size());
+  for (auto i = std::size_t{0}; i < read_pixels.size(); ++i) {
+    REQUIRE(read_pixels[i].r == write_pixels[i].r);
+    REQUIRE(read_pixels[i].g == write_pixels[i].g);
+    REQUIRE(read_pixels[i].b == write_pixels[i].b);
+  }
+}
+
+TEST_CASE("TYPED - Round-trip Gray16") {
+  auto write_pixels = std::vector<thinks::Gray16>(kWidth * kHeight);
+  for (auto i = std::size_t{0}; i < write_pixels.size(); ++i) {
+    write_pixels[i].value = static_cast<std::uint16_t>(i * 29);
+  }
+  auto oss = std::ostringstream{};
+  thinks::WriteImage<thinks::PnmFormat::kPgm>(oss, kWidth, kHeight,
+                                              write_pixels.data());
+
+  auto iss = std::istringstream(oss.str());
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto max_value = std::uint32_t{0};
+  auto read_pixels = std::vector<thinks::Gray16>{};
+  thinks::ReadImage<thinks::PnmFormat::kPgm>(iss, &width, &height,
+                                             &read_pixels, &max_value);
+  REQUIRE(max_value == 65535);
+  REQUIRE(read_pixels.size() == write_pixels.size());
+  for (auto i = std::size_t{0}; i < read_pixels.size(); ++i) {
+    REQUIRE(read_pixels[i].value == write_pixels[i].value);
+  }
+}
+
+TEST_CASE("TYPED - Rgba8 from PPM has opaque alpha") {
+  auto const rgb = FullRangePixelData(kWidth * kHeight * 3);
+  auto oss = std::ostringstream{};
+  thinks::WritePpmImage(oss, kWidth, kHeight, rgb.data());
+
+  auto iss = std::istringstream(oss.str());
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto read_pixels = std::vector<thinks::Rgba8>{};
+  thinks::ReadImage<thinks::PnmFormat::kPpm>(iss, &width, &height,
+                                             &read_pixels);
+  REQUIRE(read_pixels.size() == kWidth * kHeight);
+  for (auto i = std::size_t{0}; i < read_pixels.size(); ++i) {
+    REQUIRE(read_pixels[i].r == rgb[3 * i]);
+    REQUIRE(read_pixels[i].g == rgb[3 * i + 1]);
+    REQUIRE(read_pixels[i].b == rgb[3 * i + 2]);
+    REQUIRE(read_pixels[i].a == 255);
+  }
+
+  // Writing RGBA as PPM drops alpha.
+  auto rgba_oss = std::ostringstream{};
+  thinks::WriteImage<thinks::PnmFormat::kPpm>(rgba_oss, kWidth, kHeight,
+                                              read_pixels.data());
+  REQUIRE(rgba_oss.str() == oss.str());
+}
+
+TEST_CASE("TYPED - Channel conversion on read") {
+  auto const grey = FullRangePixelData(kWidth * kHeight);
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, kWidth, kHeight, grey.data());
+
+  auto iss = std::istringstream(oss.str());
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto rgb = std::vector<thinks::Rgb8>{};
+  thinks::ReadImage<thinks::PnmFormat::kPgm>(iss, &width, &height, &rgb);
+  for (auto i = std::size_t{0}; i < rgb.size(); ++i) {
+    REQUIRE(rgb[i].r == grey[i]);
+    REQUIRE(rgb[i].g == grey[i]);
+    REQUIRE(rgb[i].b == grey[i]);
+  }
+
+  auto ppm_oss = std::ostringstream{};
+  thinks::WriteImage<thinks::PnmFormat::kPpm>(ppm_oss, kWidth, kHeight,
+                                              rgb.data());
+  auto ppm_iss = std::istringstream(ppm_oss.str());
+  auto luma = std::vector<thinks::Gray8>{};
+  thinks::ReadImage<thinks::PnmFormat::kPpm>(ppm_iss, &width, &height,
+                                             &luma);
+  for (auto i = std::size_t{0}; i < luma.size(); ++i) {
+    REQUIRE(luma[i].value == grey[i]);
+  }
+}
+
+TEST_CASE("TYPED - File round-trip") {
+  auto const filename = std::string{"typed_test.pgm"};
+  auto const write_pixels =
+      std::vector<thinks::Gray8>(kWidth * kHeight, thinks::Gray8{17});
+  thinks::WriteImage<thinks::PnmFormat::kPgm>(filename, kWidth, kHeight,
+                                              write_pixels.data(), 100);
+
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto max_value = std::uint32_t{0};
+  auto read_pixels = std::vector<thinks::Gray8>{};
+  thinks::ReadImage<thinks::PnmFormat::kPgm>(filename, &width, &height,
+                                             &read_pixels, &max_value);
+  REQUIRE(max_value == 100);
+  REQUIRE(read_pixels.size() == write_pixels.size());
+  REQUIRE(read_pixels.front().value == 17);
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("TYPED - Invalid magic number throws") {
+  auto const grey = FullRangePixelData(4 * 4);
+  auto oss = std::ostringstream{};
+  thinks::WritePgmImage(oss, 4, 4, grey.data());
+
+  auto iss = std::istringstream(oss.str());
+  auto width = std::size_t{0};
+  auto height = std::size_t{0};
+  auto read_pixels = std::vector<thinks::Rgb8>{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::ReadImage<thinks::PnmFormat::kPpm>(iss, &width, &height,
+                                                 &read_pixels),
+      std::runtime_error,
+      ExceptionContentMatcher("magic number must be 'P6', was 'P5'"));
+}
+
+TEST_CASE("TYPED - 8-bit max value exceeded throws") {
+  auto const write_pixels = std::vector<thinks::Gray8>(4 * 4);
+  auto oss = std::ostringstream{};
+  REQUIRE_THROWS_MATCHES(
+      thinks::WriteImage<thinks::PnmFormat::kPgm>(oss, 4, 4,
+                                                  write_pixels.data(), 256),
+      std::invalid_argument,
+      ExceptionContentMatcher(
+          "max value must be at most 255 for 8-bit pixel data, was 256"));
+  REQUIRE(oss.str().empty());
+}